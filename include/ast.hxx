@@ -1,6 +1,8 @@
 #ifndef Bassoon_include_ast_HXX
 #define Bassoon_include_ast_HXX
 
+#include <map>
+#include <set>
 #include "llvm/IR/BasicBlock.h"
 #include "source_loc.hxx"
 #include "types.hxx"
@@ -12,18 +14,28 @@ namespace bassoon
 class BoolExprAST;
 class IntExprAST;
 class DoubleExprAST;
+class LongExprAST;
+class FloatExprAST;
+class UnsignedExprAST;
 class VariableExprAST;
 class CallExprAST;
 class UnaryExprAST;
 class BinaryExprAST;
+class ArrayExprAST;
+class IndexExprAST;
+class SliceExprAST;
+class VectorExprAST;
+class ArrayLiteralExprAST;
 class IfStatementAST;
 class ForStatementAST;
 class WhileStatementAST;
+class MatchStatementAST;
 class ReturnStatementAST;
 class BlockStatementAST;
 class CallStatementAST;
 class AssignStatementAST;
 class InitStatementAST;
+class IndexAssignStatementAST;
 class PrototypeAST;
 class FunctionAST;
 class TopLevels;
@@ -36,19 +48,29 @@ public:
     virtual void boolExprAction(BoolExprAST * bool_node) = 0;
     virtual void intExprAction(IntExprAST * int_node) = 0;
     virtual void doubleExprAction(DoubleExprAST * double_node) = 0;
+    virtual void longExprAction(LongExprAST * long_node) = 0;
+    virtual void floatExprAction(FloatExprAST * float_node) = 0;
+    virtual void unsignedExprAction(UnsignedExprAST * unsigned_node) = 0;
     virtual void variableExprAction(VariableExprAST * variable_node) = 0;
     virtual void callExprAction(CallExprAST * call_node) = 0;
     virtual void unaryExprAction(UnaryExprAST * unary_node) = 0;
     virtual void binaryExprAction(BinaryExprAST * binary_node) = 0;
+    virtual void arrayExprAction(ArrayExprAST * array_node) = 0;
+    virtual void indexExprAction(IndexExprAST * index_node) = 0;
+    virtual void sliceExprAction(SliceExprAST * slice_node) = 0;
+    virtual void vectorExprAction(VectorExprAST * vector_node) = 0;
+    virtual void arrayLiteralExprAction(ArrayLiteralExprAST * literal_node) = 0;
     
     virtual void ifStAction(IfStatementAST * if_node) = 0;
     virtual void forStAction(ForStatementAST * for_node) = 0;
     virtual void whileStAction(WhileStatementAST * while_node) = 0;
+    virtual void matchStAction(MatchStatementAST * match_node) = 0;
     virtual void returnStAction(ReturnStatementAST * return_node) = 0;
     virtual void blockStAction(BlockStatementAST * block_node) = 0;
     virtual void callStAction(CallStatementAST * call_node) = 0;
     virtual void assignStAction(AssignStatementAST * assign_node) = 0;
     virtual void initStAction(InitStatementAST * init_node) = 0;
+    virtual void indexAssignStAction(IndexAssignStatementAST * index_assign_node) = 0;
 
     virtual void prototypeAction(PrototypeAST * proto_node) = 0;
     virtual void functionAction(FunctionAST * func_node) = 0;
@@ -139,6 +161,34 @@ public:
     double getValue() const {return value_;}
 };
 
+class LongExprAST : public ValueExprAST{
+    int64_t value_;
+public:
+    LongExprAST(SourceLoc loc, int64_t value) 
+        : ValueExprAST(loc, type_long), value_(value) {};
+    void accept(ASTVisitor * v) override {v->longExprAction(this);}
+    int64_t getValue() const {return value_;}
+};
+
+class FloatExprAST : public ValueExprAST{
+    float value_;
+public:
+    FloatExprAST(SourceLoc loc, float value) 
+        : ValueExprAST(loc, type_float), value_(value) {};
+    void accept(ASTVisitor * v) override {v->floatExprAction(this);}
+    float getValue() const {return value_;}
+};
+
+// a uint (10u) or ulong (10uL), the value truncated to a uint's 32 bits for a uint
+class UnsignedExprAST : public ValueExprAST{
+    uint64_t value_;
+public:
+    UnsignedExprAST(SourceLoc loc, BType type, uint64_t value)
+        : ValueExprAST(loc, type), value_(type == type_uint? (uint32_t) value : value) {};
+    void accept(ASTVisitor * v) override {v->unsignedExprAction(this);}
+    uint64_t getValue() const {return value_;}
+};
+
 //-----------------------
 // Identifier Expressions
 //-----------------------
@@ -158,6 +208,8 @@ class CallExprAST : public ExprAST {
     std::vector<std::unique_ptr<ExprAST>> args_;
     int arg_index_ = 0;
     BFType callee_type_;
+    bool folded_ = false;
+    BValue folded_value_;
 public:
     CallExprAST(SourceLoc loc, const std::string &callee, std::vector<std::unique_ptr<ExprAST>> args) 
         : ExprAST(loc), callee_(callee), args_(std::move(args)) {};
@@ -166,23 +218,35 @@ public:
     void resetArgIndex(){arg_index_ = 0;}
     bool anotherArg() const {return arg_index_ < args_.size();}
     const ExprAST & getOneArg(){return *args_[arg_index_++];}
+    const ExprAST & getArg(int index) const {return *args_[index];}
     void argAcceptOne(ASTVisitor * v){args_[arg_index_++]->accept(v);}
     void setCalleeType(BFType f_type){callee_type_ = f_type;}
     BFType getCalleeType(){return callee_type_;};
+    // for visitors that recurse back into the same call, e.g. an evaluator
+    int countArgs() const {return args_.size();}
+    void argAcceptAt(ASTVisitor * v, int index){args_[index]->accept(v);}
+    // set when the call was evaluated at compile time, codegen emits the value instead
+    bool isFolded() const {return folded_;}
+    const BValue & getFoldedValue() const {return folded_value_;}
+    void setFoldedValue(BValue value){folded_value_ = value; folded_ = true;}
 };
 
 //-----------------------
 // Operation expressions
 //-----------------------
 
+// word operators (not, and, or, xor, nor) share their symbol's opcode but are only
+// logical, on ints the symbols are bitwise
 class UnaryExprAST : public ExprAST {
     char opcode_;
     std::unique_ptr<ExprAST> operand_;
+    bool word_;
 public:
-    UnaryExprAST(SourceLoc loc, char opcode, std::unique_ptr<ExprAST> operand) 
-        : ExprAST(loc), opcode_(opcode), operand_(std::move(operand)) {};
+    UnaryExprAST(SourceLoc loc, char opcode, std::unique_ptr<ExprAST> operand, bool word = false) 
+        : ExprAST(loc), opcode_(opcode), operand_(std::move(operand)), word_(word) {};
     void accept(ASTVisitor * v) override {v->unaryExprAction(this);};
-    char getOpCode(){return  opcode_;}
+    char getOpCode() const {return  opcode_;}
+    bool isWordOperator() const {return word_;}
     const ExprAST & getOperand() const {return *operand_;}
     void operandAccept(ASTVisitor * v) {operand_->accept(v);}
 };
@@ -190,16 +254,113 @@ public:
 class BinaryExprAST : public ExprAST {
     char opcode_;
     std::unique_ptr<ExprAST> lhs_, rhs_;
+    bool word_;
 public:
-    BinaryExprAST(SourceLoc loc, char opcode, std::unique_ptr<ExprAST> lhs, std::unique_ptr<ExprAST> rhs)
-        : ExprAST(loc), opcode_(opcode), lhs_(std::move(lhs)), rhs_(std::move(rhs)) {};
+    BinaryExprAST(SourceLoc loc, char opcode, std::unique_ptr<ExprAST> lhs, std::unique_ptr<ExprAST> rhs, bool word = false)
+        : ExprAST(loc), opcode_(opcode), lhs_(std::move(lhs)), rhs_(std::move(rhs)), word_(word) {};
     void accept(ASTVisitor * v) override {v->binaryExprAction(this);};
     const char getOpCode() const {return opcode_;};
+    bool isWordOperator() const {return word_;}
     const ExprAST & getLHS() const {return *lhs_;}
     const ExprAST & getRHS() const {return *rhs_;}
     void lhsAccept(ASTVisitor * v) {lhs_->accept(v);}
     void rhsAccept(ASTVisitor * v) {rhs_->accept(v);}
 };
+
+//-----------------------
+// Array expressions
+//-----------------------
+
+// a new array of zeroes, double[n], only as an array variable's initialisation
+class ArrayExprAST : public ExprAST {
+    BType element_type_;
+    std::unique_ptr<ExprAST> length_;
+public:
+    ArrayExprAST(SourceLoc loc, BType element_type, std::unique_ptr<ExprAST> length)
+        : ExprAST(loc), element_type_(element_type), length_(std::move(length)) {};
+    void accept(ASTVisitor * v) override {v->arrayExprAction(this);};
+    BType getElementType() const {return element_type_;}
+    const ExprAST & getLength() const {return *length_;}
+    void lengthAccept(ASTVisitor * v) {length_->accept(v);}
+};
+
+// vec4 of double(a, b, c, d), or one lane value splat across them all
+class VectorExprAST : public ExprAST {
+    BType vector_type_;
+    std::vector<std::unique_ptr<ExprAST>> lanes_;
+public:
+    VectorExprAST(SourceLoc loc, BType vector_type, std::vector<std::unique_ptr<ExprAST>> lanes)
+        : ExprAST(loc), vector_type_(vector_type), lanes_(std::move(lanes)) {};
+    void accept(ASTVisitor * v) override {v->vectorExprAction(this);};
+    BType getVectorType() const {return vector_type_;}
+    int countLanes() const {return lanes_.size();}
+    const ExprAST & getLane(int index) const {return *lanes_[index];}
+    void laneAcceptAt(ASTVisitor * v, int index){lanes_[index]->accept(v);}
+};
+
+// [32, 46, 58], the elements of a const array kept in read-only data: a lookup table
+class ArrayLiteralExprAST : public ExprAST {
+    std::vector<std::unique_ptr<ExprAST>> elements_;
+    // the elements' values as the element type, set by the const folder
+    std::vector<BValue> folded_elements_;
+public:
+    ArrayLiteralExprAST(SourceLoc loc, std::vector<std::unique_ptr<ExprAST>> elements)
+        : ExprAST(loc), elements_(std::move(elements)) {};
+    void accept(ASTVisitor * v) override {v->arrayLiteralExprAction(this);};
+    int countElements() const {return elements_.size();}
+    const ExprAST & getElement(int index) const {return *elements_[index];}
+    void elementAcceptAt(ASTVisitor * v, int index){elements_[index]->accept(v);}
+    const std::vector<BValue> & getFoldedElements() const {return folded_elements_;}
+    void setFoldedElements(std::vector<BValue> values){folded_elements_ = std::move(values);}
+};
+
+// an element of an array or a lane of a vector, xs[i]
+class IndexExprAST : public ExprAST {
+    std::string array_;
+    std::unique_ptr<ExprAST> index_;
+    // cleared by the typechecker when the index is known to be in bounds
+    bool checked_ = true;
+    // set by the typechecker when the name is a vector's, whose lanes are values not memory
+    bool lane_ = false;
+    // xs[i].field of an array of records
+    std::string field_;
+public:
+    IndexExprAST(SourceLoc loc, const std::string & array, std::unique_ptr<ExprAST> index, const std::string & field = "")
+        : ExprAST(loc), array_(array), index_(std::move(index)), field_(field) {};
+    void accept(ASTVisitor * v) override {v->indexExprAction(this);};
+    const std::string getArrayName() const {return array_;}
+    const ExprAST & getIndex() const {return *index_;}
+    void indexAccept(ASTVisitor * v) {index_->accept(v);}
+    bool isChecked() const {return checked_;}
+    void setChecked(bool checked) {checked_ = checked;}
+    bool isLane() const {return lane_;}
+    void setLane() {lane_ = true;}
+    const std::string & getField() const {return field_;}
+};
+
+// a view of elements of an array or slice, xs[start:end] or xs[start:end:stride]
+// from start up to but not including end. Left out, start is 0 and end the length.
+class SliceExprAST : public ExprAST {
+    std::string array_;
+    std::unique_ptr<ExprAST> start_;
+    std::unique_ptr<ExprAST> end_;
+    std::unique_ptr<ExprAST> stride_;
+public:
+    SliceExprAST(SourceLoc loc, const std::string & array, std::unique_ptr<ExprAST> start,
+        std::unique_ptr<ExprAST> end, std::unique_ptr<ExprAST> stride)
+        : ExprAST(loc), array_(array), start_(std::move(start)), end_(std::move(end)), stride_(std::move(stride)) {};
+    void accept(ASTVisitor * v) override {v->sliceExprAction(this);};
+    const std::string getArrayName() const {return array_;}
+    bool hasStart() const {return start_ != nullptr;}
+    bool hasEnd() const {return end_ != nullptr;}
+    bool hasStride() const {return stride_ != nullptr;}
+    const ExprAST & getStart() const {return *start_;}
+    const ExprAST & getEnd() const {return *end_;}
+    const ExprAST & getStride() const {return *stride_;}
+    void startAccept(ASTVisitor * v) {start_->accept(v);}
+    void endAccept(ASTVisitor * v) {end_->accept(v);}
+    void strideAccept(ASTVisitor * v) {stride_->accept(v);}
+};
 // -------------------------
 // Statements
 // -------------------------
@@ -233,6 +394,43 @@ public:
     bool getHasElse(){return has_else_;}
 };
 
+// the values an arm of a match is taken for, low to high inclusive. A bound left out,
+// case to 5 or case 5 to, is the least or greatest value of the subject's type.
+struct MatchRange{
+    int64_t low = INT64_MIN;
+    int64_t high = INT64_MAX;
+};
+
+// match (x) { case 1, 3 to 5 { ... } case 9 to { ... } else { ... } }
+class MatchStatementAST : public StatementAST {
+    std::unique_ptr<ExprAST> subject_;
+    std::vector<std::vector<MatchRange>> arm_ranges_;
+    std::vector<std::unique_ptr<StatementAST>> arms_;
+    std::unique_ptr<StatementAST> else_;
+    // set by the typechecker: every value of the subject's type from each start up to
+    // the next takes the arm, with countArms() for else, in order from the least value
+    std::vector<std::pair<int64_t, int>> segments_;
+    // set by the const folder when every arm only returns a value known at compile time
+    std::vector<BValue> returned_values_;
+public:
+    MatchStatementAST(SourceLoc loc, std::unique_ptr<ExprAST> subject, std::vector<std::vector<MatchRange>> arm_ranges,
+        std::vector<std::unique_ptr<StatementAST>> arms, std::unique_ptr<StatementAST> elsewise)
+        : StatementAST(loc), subject_(std::move(subject)), arm_ranges_(std::move(arm_ranges)), arms_(std::move(arms)), else_(std::move(elsewise)) {};
+    void accept(ASTVisitor * v) override {v->matchStAction(this);};
+    const ExprAST & getSubject() const {return *subject_;}
+    void subjectAccept(ASTVisitor * v){subject_->accept(v);}
+    int countArms() const {return arms_.size();}
+    const std::vector<MatchRange> & getArmRanges(int index) const {return arm_ranges_[index];}
+    // arm index countArms() is the else arm
+    const StatementAST & getArm(int index) const {return index == countArms()? *else_ : *arms_[index];}
+    void armAcceptAt(ASTVisitor * v, int index){(index == countArms()? else_ : arms_[index])->accept(v);}
+    bool hasElse() const {return else_ != nullptr;}
+    const std::vector<std::pair<int64_t, int>> & getSegments() const {return segments_;}
+    void setSegments(std::vector<std::pair<int64_t, int>> segments){segments_ = std::move(segments);}
+    const std::vector<BValue> & getReturnedValues() const {return returned_values_;}
+    void setReturnedValues(std::vector<BValue> values){returned_values_ = std::move(values);}
+};
+
 class ForStatementAST : public StatementAST {
     //std::vector<std::string> ind_var_names;
     //std::string ind_var_name_; takes argument const std::string &ind_var_name;
@@ -270,6 +468,8 @@ public:
 class ReturnStatementAST : public StatementAST {
     std::unique_ptr<ExprAST> return_expr_;
     BType return_type_;
+    // set by the typechecker when a call's value is returned as is
+    bool tail_call_ = false;
 public:
     ReturnStatementAST(SourceLoc loc, std::unique_ptr<ExprAST> return_expr)
         : StatementAST(loc), return_expr_(std::move(return_expr)) {};
@@ -278,6 +478,9 @@ public:
     void returnExprAccept(ASTVisitor * v) {return_expr_->accept(v);}
     BType getReturnType() const {return return_type_;}
     void setReturnType(BType ret_type) {return_type_ = ret_type;}
+    CallExprAST * getCallExpr() {return dynamic_cast<CallExprAST *>(return_expr_.get());}
+    bool isTailCall() const {return tail_call_;}
+    void setTailCall(bool tail_call) {tail_call_ = tail_call;}
 };
 
 // ------------------------
@@ -303,6 +506,9 @@ public:
     //         statementAcceptOne(v);
     //     }
     // }
+    int countStatements() const {return statements_.size();}
+    const StatementAST & getStatementAt(int index) const {return *statements_[index];}
+    void statementAcceptAt(ASTVisitor * v, int index){statements_[index]->accept(v);}
     bool hasReturn() const {return has_return_;}
     BType getReturnType() const {return return_type_;}
 };
@@ -336,37 +542,82 @@ class InitStatementAST : public StatementAST{
     std::string identifier_;
     BType var_type_;
     std::unique_ptr<AssignStatementAST> assignment_;
+    // set by the typechecker: initialisations at the top level declare globals,
+    // a global never assigned after its initialisation can be a constant.
+    bool global_ = false;
+    bool reassigned_ = false;
+    // declared const: a global that can't be assigned, evaluated at compile time if it can be
+    bool const_;
 public:
-    InitStatementAST(SourceLoc loc, std::string identifier, BType var_type, std::unique_ptr<AssignStatementAST> assignment)
-        : StatementAST(loc), identifier_(identifier), var_type_(var_type), assignment_(std::move(assignment)) {};
+    InitStatementAST(SourceLoc loc, std::string identifier, BType var_type, std::unique_ptr<AssignStatementAST> assignment, bool is_const = false)
+        : StatementAST(loc), identifier_(identifier), var_type_(var_type), assignment_(std::move(assignment)), const_(is_const) {};
     void accept(ASTVisitor * v) override {v->initStAction(this);};
     const std::string getIdentifier() const {return identifier_;}
     const BType getType() const {return var_type_;}
     const AssignStatementAST &getAssignment() const {return *assignment_;}
     void assignmentAccept(ASTVisitor * v) {assignment_->accept(v);}
+    void valueAccept(ASTVisitor * v) {assignment_->valueAccept(v);}
+    bool isGlobal() const {return global_;}
+    void setGlobal() {global_ = true;}
+    bool isReassigned() const {return reassigned_;}
+    void setReassigned() {reassigned_ = true;}
+    bool isConst() const {return const_;}
+};
+
+// xs[i] = value;
+class IndexAssignStatementAST : public StatementAST {
+    std::unique_ptr<IndexExprAST> element_;
+    std::unique_ptr<ExprAST> value_;
+public:
+    IndexAssignStatementAST(SourceLoc loc, std::unique_ptr<IndexExprAST> element, std::unique_ptr<ExprAST> value)
+        : StatementAST(loc), element_(std::move(element)), value_(std::move(value)) {};
+    void accept(ASTVisitor * v) override {v->indexAssignStAction(this);};
+    const IndexExprAST & getElement() const {return *element_;}
+    IndexExprAST * getElementExpr() {return element_.get();}
+    const ExprAST & getValue() const {return *value_;}
+    void elementAccept(ASTVisitor * v) {element_->accept(v);}
+    void valueAccept(ASTVisitor * v) {value_->accept(v);}
 };
 
 //-------------------------
 // Function Expressions
 //-------------------------
 
+// what the typechecker proved about how a function uses a slice argument's elements
+struct SliceAccess{
+    bool readonly = false; // they're never written through the slice or any view of it
+    bool nocapture = false; // no global is left viewing them
+    bool noalias = false; // nothing else the function reads or writes overlaps them
+};
+
 class PrototypeAST : public SrcNodeAST{
     std::string name_;
     std::vector<std::pair<std::string,BType>> args_;
     BFType func_type_;
+    std::set<FuncAnnotation> annotations_;
+    std::map<int, SliceAccess> slice_access_; // by argument index
 public:
-    PrototypeAST(SourceLoc loc, std::string name, std::vector<std::pair<std::string,BType>> args, BFType func_type)
-        : SrcNodeAST(loc), name_(name), args_(args), func_type_(func_type) {};
+    PrototypeAST(SourceLoc loc, std::string name, std::vector<std::pair<std::string,BType>> args, BFType func_type, std::set<FuncAnnotation> annotations = {})
+        : SrcNodeAST(loc), name_(name), args_(args), func_type_(func_type), annotations_(annotations) {};
     const std::string &getName() const {return name_;};
     void accept(ASTVisitor * v) override {v->prototypeAction(this);};
-    const std::vector<std::pair<std::string,BType>> & getArgs(){return args_;};
+    const std::vector<std::pair<std::string,BType>> & getArgs() const {return args_;};
     const BType & getRetType(){return func_type_.getReturnType();}
     const BFType & getType(){return func_type_;}
+    const std::set<FuncAnnotation> & getAnnotations() const {return annotations_;}
+    bool hasAnnotation(FuncAnnotation annotation) const {return annotations_.count(annotation) > 0;}
+    SliceAccess getSliceAccess(int arg) const {
+        auto access = slice_access_.find(arg);
+        return access == slice_access_.end()? SliceAccess() : access->second;
+    }
+    void setSliceAccess(int arg, SliceAccess access) {slice_access_[arg] = access;}
 };
 
 class FunctionAST : public SrcNodeAST{
     std::unique_ptr<PrototypeAST> proto_;
     std::unique_ptr<StatementAST> body_;
+    // set by the typechecker: no input, output, non-const globals or array elements, directly or through calls
+    bool pure_ = false;
 public:
     FunctionAST(SourceLoc loc, std::unique_ptr<PrototypeAST> proto, std::unique_ptr<StatementAST> body)
         : SrcNodeAST(loc), proto_(std::move(proto)), body_(std::move(body)) {};
@@ -376,6 +627,9 @@ public:
     const BFType & getType() const {return proto_->getType();}
     void protoAccept(ASTVisitor * v){proto_->accept(v);}
     void bodyAccept(ASTVisitor * v){body_->accept(v);}
+    bool isPure() const {return pure_;}
+    void setPure(bool pure) {pure_ = pure;}
+    void setSliceAccess(int arg, SliceAccess access) {proto_->setSliceAccess(arg, access);}
 };
 
 // ---------------
@@ -425,6 +679,14 @@ public:
         }
         statement_index_=0;
     }
+    // only the initialisations, which declare the program's globals
+    void globalsAllAccept(ASTVisitor * v) {
+        for(auto & statement_AST : statement_ASTs_){
+            if(InitStatementAST * init_AST = dynamic_cast<InitStatementAST *>(statement_AST.get())){
+                init_AST->accept(v);
+            }
+        }
+    }
     int countStatements() const {return statement_ASTs_.size();}
 };
 
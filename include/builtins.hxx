@@ -0,0 +1,111 @@
+#ifndef Bassoon_include_builtins_HXX
+#define Bassoon_include_builtins_HXX
+
+#include <string>
+#include <vector>
+
+#include "types.hxx"
+
+namespace bassoon
+{
+
+// A function provided by the runtime library (src/runtime), called by name
+// in Bassoon and linked against its bsn_ prefixed symbol. Symbols starting
+// llvm. are intrinsics instead, overloaded on double, which the optimiser can
+// fold, vectorise and lower to instructions or libm calls. Pure builtins
+// have no effects, so calls of them can be evaluated at compile time.
+struct Builtin{
+    std::string name;
+    std::string symbol;
+    BFType type;
+    bool pure;
+};
+
+// static: included by both the typechecker and codegen
+static const std::vector<Builtin> builtin_functions =
+{
+    // buffered output, flushed when full, by flush() and at exit
+    {"putchar", "bsn_putchar", BFType(std::vector<BType>({type_int}), type_int), false},
+    {"printInt", "bsn_print_int", BFType(std::vector<BType>({type_int}), type_void), false},
+    {"printLong", "bsn_print_long", BFType(std::vector<BType>({type_long}), type_void), false},
+    {"printUInt", "bsn_print_uint", BFType(std::vector<BType>({type_uint}), type_void), false},
+    {"printULong", "bsn_print_ulong", BFType(std::vector<BType>({type_ulong}), type_void), false},
+    {"printDouble", "bsn_print_double", BFType(std::vector<BType>({type_double}), type_void), false},
+    {"flush", "bsn_flush", BFType(std::vector<BType>(), type_void), false},
+    // buffered input, getchar gives -1 at the end of input
+    {"getchar", "bsn_getchar", BFType(std::vector<BType>(), type_int), false},
+    {"readInt", "bsn_read_int", BFType(std::vector<BType>(), type_int), false},
+    {"readDouble", "bsn_read_double", BFType(std::vector<BType>(), type_double), false},
+    // maths
+    {"sqrt", "llvm.sqrt", BFType(std::vector<BType>({type_double}), type_double), true},
+    {"fabs", "llvm.fabs", BFType(std::vector<BType>({type_double}), type_double), true},
+    {"floor", "llvm.floor", BFType(std::vector<BType>({type_double}), type_double), true},
+    {"exp", "llvm.exp", BFType(std::vector<BType>({type_double}), type_double), true},
+    {"log", "llvm.log", BFType(std::vector<BType>({type_double}), type_double), true},
+    {"sin", "llvm.sin", BFType(std::vector<BType>({type_double}), type_double), true},
+    {"cos", "llvm.cos", BFType(std::vector<BType>({type_double}), type_double), true},
+    {"pow", "llvm.pow", BFType(std::vector<BType>({type_double, type_double}), type_double), true},
+    {"min", "llvm.minnum", BFType(std::vector<BType>({type_double, type_double}), type_double), true},
+    {"max", "llvm.maxnum", BFType(std::vector<BType>({type_double, type_double}), type_double), true},
+    {"fma", "llvm.fma", BFType(std::vector<BType>({type_double, type_double, type_double}), type_double), true},
+};
+
+// len(xs) gives an array's length, for arrays of any element type
+static const std::string array_length_builtin = "len";
+
+// builtins on bits, lowered inline to llvm.ctpop and llvm.cttz on their words:
+// popcount(b) counts the set flags, nextSet(b, i) gives the first set flag from i on,
+// len(b) if there's none, and firstSet(b) is nextSet(b, 0)
+static const std::string bits_count_builtin = "popcount";
+static const std::string bits_first_builtin = "firstSet";
+static const std::string bits_next_builtin = "nextSet";
+
+static bool isBitsBuiltin(const std::string & name){
+    return name == bits_count_builtin || name == bits_first_builtin || name == bits_next_builtin;
+}
+
+// rotl(x, n) and rotr(x, n) rotate the bits of an int x of any type by n modulo its
+// width, typed by their arguments and lowered to llvm.fshl and llvm.fshr
+static const std::string rotate_left_builtin = "rotl";
+static const std::string rotate_right_builtin = "rotr";
+
+static bool isRotateBuiltin(const std::string & name){
+    return name == rotate_left_builtin || name == rotate_right_builtin;
+}
+
+// builtins on vectors, typed by their arguments: sum(v), min(v) and max(v) reduce the
+// lanes, any(m) and all(m) a mask, and select(m, a, b) takes a's lanes where m is true
+// and b's elsewhere (m can also be a bool choosing between two scalars)
+static const std::string vector_sum_builtin = "sum";
+static const std::string vector_any_builtin = "any";
+static const std::string vector_all_builtin = "all";
+static const std::string select_builtin = "select";
+
+// min and max of two doubles are in builtin_functions, of one vector they are reductions
+static bool isVectorBuiltin(const std::string & name, int arg_count){
+    return name == vector_sum_builtin || name == vector_any_builtin || name == vector_all_builtin
+        || name == select_builtin || ((name == "min" || name == "max") && arg_count == 1);
+}
+
+// complex numbers, lowered inline to their two doubles: complex(re, im) makes one, real(z)
+// and imag(z) give its parts, abs2(z) is re*re + im*im and conj(z) has its imaginary part negated
+static const std::string complex_builtin = "complex";
+static const std::vector<Builtin> complex_builtins =
+{
+    {complex_builtin, "", BFType(std::vector<BType>({type_double, type_double}), type_complex), true},
+    {"real", "", BFType(std::vector<BType>({type_complex}), type_double), true},
+    {"imag", "", BFType(std::vector<BType>({type_complex}), type_double), true},
+    {"abs2", "", BFType(std::vector<BType>({type_complex}), type_double), true},
+    {"conj", "", BFType(std::vector<BType>({type_complex}), type_complex), true},
+};
+
+static bool isComplexBuiltin(const std::string & name){
+    for(const Builtin & builtin : complex_builtins){
+        if(builtin.name == name) return true;
+    }
+    return false;
+}
+
+} // namespace bassoon
+
+#endif // Bassoon_include_builtins_HXX
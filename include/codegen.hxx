@@ -2,6 +2,7 @@
 #define Bassoon_include_codegen_HXX
 
 #include <map>
+#include <set>
 #include "ast.hxx"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/IRBuilder.h"
@@ -9,17 +10,37 @@
 #include "llvm/IR/PassManager.h"
 #include "llvm/Analysis/LoopAnalysisManager.h"
 #include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Transforms/Utils/Mem2Reg.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Transforms/Scalar/GVN.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Program.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/GlobalIFunc.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/MC/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/Host.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/MC/MCSubtargetInfo.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/FileSystem.h"
 
@@ -30,13 +51,119 @@
 namespace bassoon{
 namespace codegen{
 
+// Optimisation pipelines selectable with -O
+enum OptLevel {
+    opt_O0 = 0,
+    opt_O1 = 1,
+    opt_O2 = 2,
+    opt_O3 = 3,
+    opt_Os = 4,
+    opt_Oz = 5,
+    opt_jit = 6, // mem2reg, instcombine, simplifycfg and gvn only: fast to compile
+};
+
+// Numeric semantics, selectable for the compilation and per function
+enum NumericMode {
+    num_strict = 0, // IEEE floating point, wrapping integers
+    num_contract = 1, // floating point multiply-adds may be fused
+    num_fast = 2, // all fast-math flags, integer arithmetic does not overflow (nsw)
+};
+
+// How match statements are lowered, selectable with -match-lowering
+enum MatchLowering {
+    match_auto = 0, // by the density of the arms' values, see createMatch
+    match_table = 1, // a lookup table when every arm returns a constant
+    match_switch = 2, // an LLVM switch of every value between the outermost arms
+    match_search = 3, // a binary search over the starts of the arms' ranges
+};
+
+// Which part of the optimisation pipeline to build. A partitioned compile runs
+// the interprocedural (prelink) part on the whole module so inlining sees every
+// function, then the function level (partition) part on each partition.
+enum PipelineStage {
+    stage_whole = 0,
+    stage_prelink = 1,
+    stage_partition = 2,
+};
+
 class CodeGenerator : public ASTVisitor {
     std::unique_ptr<llvm::LLVMContext> context_;
     std::unique_ptr<llvm::Module> module_;
     std::unique_ptr<llvm::IRBuilder<>> builder_;
     std::map<std::string, llvm::AllocaInst *> named_values_;
+    // Top level initialisations, visible to every function unless shadowed by a
+    // local. Those never reassigned with a constant initialiser become constants.
+    std::map<std::string, llvm::GlobalVariable *> globals_;
 
-    llvm::TargetMachine * target_machine_;
+    // Direct SSA construction (Braun et al. 2013) used instead of named_values_
+    // allocas when ssa_ is set: the current definition of each variable is
+    // tracked per block and phis are placed as blocks are sealed, i.e. once
+    // all of their predecessors are known.
+    bool ssa_ = false;
+    std::map<llvm::BasicBlock *, std::map<std::string, llvm::WeakTrackingVH>> current_defs_;
+    std::map<llvm::BasicBlock *, std::map<std::string, llvm::PHINode *>> incomplete_phis_;
+    std::set<llvm::BasicBlock *> sealed_blocks_;
+    std::map<std::string, llvm::Type *> variable_types_;
+    // the variable each name in scope refers to, a shadowing declaration gets a new one
+    std::map<std::string, std::string> ssa_variables_;
+
+    // Top of the current function's body, self tail calls branch back here and rebind its arguments.
+    llvm::BasicBlock * tail_recursion_block_ = nullptr;
+    // each argument's own alloca or SSA variable, which a self tail call rebinds
+    // even where a local shadows the argument
+    std::vector<llvm::AllocaInst *> argument_allocas_;
+    std::vector<std::string> argument_variables_;
+    // Set while prototypes are declared ahead of the function bodies.
+    bool declaring_ = false;
+
+    llvm::TargetMachine * target_machine_ = nullptr;
+    std::string target_triple_ = "";
+    // cpu and feature string every function is tuned for, recorded
+    // on each function as "target-cpu" and "target-features".
+    std::string target_cpu_ = "generic";
+    std::string target_features_ = "";
+    // ISA levels that multiversion functions get a body for.
+    std::vector<std::string> multiversion_levels_ = {"baseline", "avx2", "avx512"};
+
+    OptLevel opt_level_ = opt_O2;
+    // textual pipeline (as for opt -passes=), replaces the opt level's pipeline when set
+    std::string pass_pipeline_ = "";
+    bool print_ir_ = false;
+    NumericMode numeric_mode_ = num_strict;
+    // whether int add, sub and mul get nsw, following the current function's mode
+    bool no_signed_wrap_ = false;
+    // number of modules optimisation and object emission are split across
+    unsigned partitions_ = 1;
+    // vector maths library that calls in vectorised loops are mapped to
+    llvm::TargetLibraryInfoImpl::VectorLibrary vector_library_ = llvm::TargetLibraryInfoImpl::NoLibrary;
+    // entries in each memo function's cache: the int domain of a direct-mapped
+    // table, otherwise the slots (rounded up to a power of two) of a hash table
+    unsigned memo_size_ = 4096;
+    MatchLowering match_lowering_ = match_auto;
+    // builtin name -> its declaration (runtime function or intrinsic)
+    std::map<std::string, llvm::Function *> builtin_callees_;
+
+    // Arrays are {element pointer, i32 length}. Fixed lengths up to stack_array_bytes
+    // live in the entry block's frame, others are heap allocated by the runtime, and
+    // all are aligned to array_alignment bytes (a cache line, and any vector width).
+    static const unsigned array_alignment = 64;
+    static const unsigned stack_array_bytes = 4096;
+    // Arrays of records are laid out as their type says: aos arrays point to records
+    // (structs of the fields largest first), aosoa(N) arrays to blocks holding an array
+    // of N of each field, and soa arrays are {field pointer..., i32 length} with the
+    // fields' arrays one after another in a single buffer.
+    // Slices are arrays that don't own their elements, strided ones {element pointer,
+    // i32 stride, i32 length}, and are passed to functions as their members so the
+    // element pointer can take the attributes the typechecker proved.
+    // array_types_ holds the arrays whose LLVM type doesn't tell their BType.
+    std::map<llvm::Type *, BType> array_types_;
+    llvm::StructType * namedStruct(const std::string & name, std::vector<llvm::Type *> members);
+    llvm::StructType * aosoaBlockType(BType record_type, int records_per_block);
+    llvm::Value * arrayLength(llvm::Value * array);
+    // heap arrays allocated in each enclosing block, freed as it ends or on return
+    std::vector<std::vector<llvm::Value *>> array_scopes_;
+    // whether the current function has made an array, whose frame its calls mustn't reuse
+    bool arrays_declared_ = false;
 
     std::vector<llvm::Value *> llvm_value_stack_;
     std::vector<llvm::Function *> llvm_proto_stack_;
@@ -48,48 +175,137 @@ class CodeGenerator : public ASTVisitor {
     llvm::Type * convertBType(BType btype);
     BType convertLlvmType(llvm::Type * type);
 
-    llvm::AllocaInst * createEntryBlockAlloca(llvm::Function *function, llvm::Argument * arg);
+    void resetVariables();
+    void declareVariable(std::string name, llvm::Type * type);
+    bool isLocalVariable(std::string name);
+    void writeVariable(std::string name, llvm::BasicBlock * block, llvm::Value * value);
+    llvm::Value * readVariable(std::string name, llvm::BasicBlock * block);
+    void writeDefinition(std::string variable, llvm::BasicBlock * block, llvm::Value * value);
+    llvm::Value * readDefinition(std::string variable, llvm::BasicBlock * block);
+    llvm::Value * readVariableRecursive(std::string name, llvm::BasicBlock * block);
+    llvm::Value * addPhiOperands(std::string name, llvm::PHINode * phi);
+    llvm::Value * tryRemoveTrivialPhi(llvm::PHINode * phi);
+    void sealBlock(llvm::BasicBlock * block);
+    void addTargetAttributes(llvm::Function * function);
+    void applyNumericMode(NumericMode mode, llvm::Function * function);
+    void multiversionFunction(llvm::Function * function);
+    llvm::Function * memoiseFunction(llvm::Function * function);
+    llvm::FunctionCallee getCallee(std::string name);
+    std::vector<llvm::Value *> createCallArgs(CallExprAST * call_node);
+    llvm::Function * getRuntimeFunction(std::string symbol, llvm::Type * ret_type, std::vector<llvm::Type *> arg_types);
+    // stops the program, calling the runtime's error, unless in_bounds
+    void createRuntimeCheck(llvm::Value * in_bounds, const std::string & error, std::vector<llvm::Value *> args);
+    // stops the program with an index error unless 0 <= index < length
+    void createBoundsCheck(llvm::Value * index, llvm::Value * length);
+    llvm::Value * createElementPointer(IndexExprAST * index_node);
+    // bits are {word pointer, i32 length} with 64 flags to an i64 word, and the flags
+    // past the length in the last word always clear. A flag is a bit of the word pointed
+    // to, selected by mask.
+    llvm::Value * createFlagPointer(IndexExprAST * index_node, llvm::Value *& mask);
+    // sets every word of the assigned bits, combining the operands' words in one loop
+    void createBitsAssignment(AssignStatementAST * assign_node);
+    llvm::Value * createBitsWord(const ExprAST & operation, std::map<std::string, llvm::Value *> & operand_words,
+        llvm::Value * word_index, bool & sets_tail);
+    // popcount and nextSet are loops over the words, defined once in the module
+    llvm::Value * createBitsBuiltin(CallExprAST * call_node);
+    llvm::Function * getBitsFunction(const std::string & builtin);
+    void freeArrays(unsigned from_scope);
+    llvm::Value * createVectorBuiltin(CallExprAST * call_node);
+    // complex numbers are a {double, double} pair of their real and imaginary parts
+    llvm::Value * createComplex(llvm::Value * re, llvm::Value * im);
+    llvm::Value * createComplexArithmetic(char op_code, BType lhs_type, llvm::Value * lhs_val, BType rhs_type, llvm::Value * rhs_val);
+    llvm::Value * createComplexBuiltin(CallExprAST * call_node);
+    // A match's segments are the runs of values taking one arm, and its span the values
+    // from the start of the second to that of the last, between the runs reaching the
+    // least and greatest values. Dense arms, with at most match_table_density entries a
+    // segment, are a lookup table in read-only data when every arm returns a constant,
+    // with at most match_switch_density a switch (which LLVM makes a jump table), and
+    // sparser ones a binary search over the segments' starts.
+    static const unsigned match_table_density = 64;
+    static const unsigned match_switch_density = 8;
+    static const uint64_t match_table_entries = 4096;
+    static const uint64_t match_switch_values = 1024;
+    bool createMatchTable(MatchStatementAST * match_node, llvm::Value * subject);
+    void createMatchSwitch(llvm::Value * subject, const std::vector<std::pair<int64_t, int>> & segments,
+        const std::vector<llvm::BasicBlock *> & arm_blocks);
+    void createMatchSearch(llvm::Value * subject, const std::vector<std::pair<int64_t, int>> & segments,
+        int first, int last, const std::vector<llvm::BasicBlock *> & arm_blocks);
+
+    std::unique_ptr<llvm::TargetMachine> createTargetMachine();
+    llvm::CodeGenOpt::Level codeGenOptLevel();
+    llvm::TargetLibraryInfoImpl createLibraryInfo(const llvm::Module & module);
+    void runPipeline(llvm::Module & module, llvm::TargetMachine * target_machine, PipelineStage stage);
+    bool emitObject(llvm::Module & module, llvm::TargetMachine * target_machine, std::string object_filename);
+    void compilePartitions();
 
     llvm::Value * createAdd(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val);
     llvm::Value * createSub(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val);
     llvm::Value * createMul(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val);
     llvm::Value * createDiv(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val);
-    llvm::Value * createAnd(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val);
-    llvm::Value * createOr(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val);
-    llvm::Value * createLessThan(BType lhs_type, BType rhs_type, llvm::Value * lhs_val, llvm::Value * rhs_val);
-    llvm::Value * createGreaterThan(BType lhs_type, BType rhs_type, llvm::Value * lhs_val, llvm::Value * rhs_val);
-
-    llvm::Value * createCast(llvm::Value * val, BType dest_type);
-    llvm::Value * createIntToDoubleCast(llvm::Value * int_val);
-    llvm::Value * createDoubleToIntCast(llvm::Value * double_val);
-    llvm::Value * tryIntToDoubleCast(llvm::Value * maybe_int_val);
-    llvm::Value * tryDoubleToIntCast(llvm::Value * maybe_double_val);
+    llvm::Value * createRem(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val);
+    // << and >> (op_code 'l' and 'r') of an int or vector of them by any int amount
+    llvm::Value * createShift(char op_code, BType res_type, llvm::Value * lhs_val, BType amount_type, llvm::Value * amount_val);
+    llvm::Value * createRotate(CallExprAST * call_node);
+    // and (&) and or (|) only evaluate their rhs if the lhs doesn't decide the result
+    llvm::Value * createShortCircuit(BinaryExprAST * binary_node);
+    // operands of comparisons are both of operand_type, converted by createCast beforehand
+    llvm::Value * createLessThan(BType operand_type, llvm::Value * lhs_val, llvm::Value * rhs_val);
+    llvm::Value * createGreaterThan(BType operand_type, llvm::Value * lhs_val, llvm::Value * rhs_val);
+
+    // converts between the numeric types, val is returned if it already has dest_type.
+    // Ints are extended and converted to floats by the signedness of src_type.
+    llvm::Value * createCast(llvm::Value * val, BType src_type, BType dest_type);
+
+    // a value evaluated at compile time
+    llvm::Constant * createConstant(BValue value);
 public:
     CodeGenerator();
     void printIR();
 
-    void definePutChar();
+    // declare the runtime library's functions (include/builtins.hxx)
+    void defineBuiltins();
     void generate(std::shared_ptr<BProgram> program);
+    // link the embedded runtime's definitions of the builtins the program calls
+    void linkRuntime();
     void optimize();
-    void setTarget();
+    void setTarget(std::string cpu = "generic", std::string features = "");
+    void setMultiversionLevels(std::vector<std::string> levels);
+    void setOptimization(OptLevel level, std::string pipeline = "");
+    void setPrintIR(bool print_ir){print_ir_ = print_ir;}
+    void setPartitions(unsigned partitions);
+    void setDirectSSA(bool ssa){ssa_ = ssa;}
+    void setNumericMode(NumericMode mode){numeric_mode_ = mode;}
+    void setVectorLibrary(llvm::TargetLibraryInfoImpl::VectorLibrary library){vector_library_ = library;}
+    void setMemoSize(unsigned size);
+    void setMatchLowering(MatchLowering lowering){match_lowering_ = lowering;}
     void compile();
 
     void boolExprAction(BoolExprAST * bool_node) override;
     void intExprAction(IntExprAST * int_node) override;
     void doubleExprAction(DoubleExprAST * double_node) override;
+    void longExprAction(LongExprAST * long_node) override;
+    void floatExprAction(FloatExprAST * float_node) override;
+    void unsignedExprAction(UnsignedExprAST * unsigned_node) override;
     void variableExprAction(VariableExprAST * variable_node) override;
     void callExprAction(CallExprAST * call_node) override;
     void unaryExprAction(UnaryExprAST * unary_node) override;
     void binaryExprAction(BinaryExprAST * binary_node) override;
+    void arrayExprAction(ArrayExprAST * array_node) override;
+    void indexExprAction(IndexExprAST * index_node) override;
+    void sliceExprAction(SliceExprAST * slice_node) override;
+    void vectorExprAction(VectorExprAST * vector_node) override;
+    void arrayLiteralExprAction(ArrayLiteralExprAST * literal_node) override;
     
     void ifStAction(IfStatementAST * if_node) override;
     void forStAction(ForStatementAST * for_node) override;
     void whileStAction(WhileStatementAST * while_node) override;
+    void matchStAction(MatchStatementAST * match_node) override;
     void returnStAction(ReturnStatementAST * return_node) override;
     void blockStAction(BlockStatementAST * block_node) override;
     void callStAction(CallStatementAST * call_node) override;
     void assignStAction(AssignStatementAST * assign_node) override;
     void initStAction(InitStatementAST * init_node) override;
+    void indexAssignStAction(IndexAssignStatementAST * index_assign_node) override;
 
     void prototypeAction(PrototypeAST * proto_node) override;
     void functionAction(FunctionAST * func_node) override;
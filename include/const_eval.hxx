@@ -0,0 +1,163 @@
+#ifndef Bassoon_include_const_eval_HXX
+#define Bassoon_include_const_eval_HXX
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "ast.hxx"
+#include "spdlog/spdlog.h"
+
+namespace bassoon{
+namespace ctfe{
+
+// Interprets pure functions on the typechecked AST, so a call whose arguments
+// are known at compile time can be replaced by its value. Evaluation gives up,
+// leaving the call to run time, on an impure call, a variable only known at
+// run time, division by zero or running out of steps or call depth.
+class ConstEvaluator : public ASTVisitor{
+    // the variables of a call, one map per scope with the innermost last
+    typedef std::vector<std::map<std::string, BValue>> Frame;
+    std::vector<Frame> frames_;
+
+    std::map<std::string, FunctionAST *> functions_; // the pure user functions
+    std::map<std::string, BValue> constants_; // const globals evaluated so far
+    std::map<std::string, std::vector<BValue>> tables_; // and the elements of const arrays
+    // locals where the expression being evaluated is, hiding constants of the same name
+    std::set<std::string> hidden_;
+    // results of calls by function and argument bits, pure functions always give the same
+    std::map<std::pair<std::string, std::vector<uint64_t>>, BValue> results_;
+
+    unsigned max_steps_;
+    unsigned max_depth_;
+    unsigned steps_ = 0;
+    unsigned step_limit_ = 0; // of the evaluation in progress
+    std::string failure_;
+
+    // the value of the last expression evaluated, or being returned
+    BValue value_;
+    bool returning_ = false;
+
+    void step();
+    BValue lookup(const std::string & name);
+    const std::vector<BValue> & lookupTable(const std::string & name);
+    void assign(const std::string & name, BValue value);
+    void define(const std::string & name, BValue value);
+    BValue call(const std::string & name, const std::vector<BValue> & args);
+    BValue callBuiltin(const std::string & name, const std::vector<BValue> & args);
+public:
+    ConstEvaluator(unsigned max_steps, unsigned max_depth)
+        : max_steps_(max_steps), max_depth_(max_depth) {};
+    void addFunction(FunctionAST * func_node);
+    void addConstant(const std::string & name, BValue value){constants_[name] = value;}
+    void addTable(const std::string & name, std::vector<BValue> elements){tables_[name] = std::move(elements);}
+    void setHidden(std::set<std::string> hidden){hidden_ = hidden;}
+    bool isPure(const std::string & func_name);
+    // evaluates the expression accept visits the evaluator with, giving false
+    // (and the reason in getFailure) if it can't be done at compile time, in at
+    // least min_steps steps whatever the evaluator's own limit
+    bool evaluate(std::function<void(ASTVisitor *)> accept, BValue & result, unsigned min_steps = 0);
+    // evaluates a statement outside of any call, in a frame of its own, to the value it returns
+    bool evaluateReturn(std::function<void(ASTVisitor *)> accept, BValue & result);
+    const std::string & getFailure() const {return failure_;}
+
+    void boolExprAction(BoolExprAST * bool_node) override;
+    void intExprAction(IntExprAST * int_node) override;
+    void doubleExprAction(DoubleExprAST * double_node) override;
+    void longExprAction(LongExprAST * long_node) override;
+    void floatExprAction(FloatExprAST * float_node) override;
+    void unsignedExprAction(UnsignedExprAST * unsigned_node) override;
+    void variableExprAction(VariableExprAST * variable_node) override;
+    void callExprAction(CallExprAST * call_node) override;
+    void unaryExprAction(UnaryExprAST * unary_node) override;
+    void binaryExprAction(BinaryExprAST * binary_node) override;
+    void arrayExprAction(ArrayExprAST * array_node) override;
+    void indexExprAction(IndexExprAST * index_node) override;
+    void sliceExprAction(SliceExprAST * slice_node) override;
+    void vectorExprAction(VectorExprAST * vector_node) override;
+    void arrayLiteralExprAction(ArrayLiteralExprAST * literal_node) override;
+
+    void ifStAction(IfStatementAST * if_node) override;
+    void forStAction(ForStatementAST * for_node) override;
+    void whileStAction(WhileStatementAST * while_node) override;
+    void matchStAction(MatchStatementAST * match_node) override;
+    void returnStAction(ReturnStatementAST * return_node) override;
+    void blockStAction(BlockStatementAST * block_node) override;
+    void callStAction(CallStatementAST * call_node) override;
+    void assignStAction(AssignStatementAST * assign_node) override;
+    void initStAction(InitStatementAST * init_node) override;
+    void indexAssignStAction(IndexAssignStatementAST * index_assign_node) override;
+
+    void prototypeAction(PrototypeAST * proto_node) override;
+    void functionAction(FunctionAST * func_node) override;
+
+    void topLevelsAction(TopLevels * top_levels_node) override;
+    void funcDefsAction(FuncDefs * func_defs_node) override;
+    void programAction(BProgram * program_node) override;
+};
+
+enum folding_phase {
+    fp_functions = 0,
+    fp_constants = 1,
+    fp_bodies = 2,
+    fp_top_levels = 3,
+};
+
+// The elements of a const array can't be left to run time, so they're evaluated in
+// at least this many steps even when -ctfe-steps is lower.
+const unsigned table_element_steps = 1000000;
+
+// Evaluates the const globals in order, then marks every call of a pure
+// function whose arguments are known at compile time with its value.
+class ConstFolder : public ASTVisitor{
+    folding_phase phase_;
+    ConstEvaluator evaluator_;
+    // names defined in each scope around the code being folded
+    std::vector<std::vector<std::string>> scopes_;
+    std::set<std::string> localNames();
+public:
+    ConstFolder(unsigned max_steps, unsigned max_depth)
+        : evaluator_(max_steps, max_depth) {};
+    void fold(std::shared_ptr<BProgram> program);
+
+    void boolExprAction(BoolExprAST * bool_node) override;
+    void intExprAction(IntExprAST * int_node) override;
+    void doubleExprAction(DoubleExprAST * double_node) override;
+    void longExprAction(LongExprAST * long_node) override;
+    void floatExprAction(FloatExprAST * float_node) override;
+    void unsignedExprAction(UnsignedExprAST * unsigned_node) override;
+    void variableExprAction(VariableExprAST * variable_node) override;
+    void callExprAction(CallExprAST * call_node) override;
+    void unaryExprAction(UnaryExprAST * unary_node) override;
+    void binaryExprAction(BinaryExprAST * binary_node) override;
+    void arrayExprAction(ArrayExprAST * array_node) override;
+    void indexExprAction(IndexExprAST * index_node) override;
+    void sliceExprAction(SliceExprAST * slice_node) override;
+    void vectorExprAction(VectorExprAST * vector_node) override;
+    void arrayLiteralExprAction(ArrayLiteralExprAST * literal_node) override;
+
+    void ifStAction(IfStatementAST * if_node) override;
+    void forStAction(ForStatementAST * for_node) override;
+    void whileStAction(WhileStatementAST * while_node) override;
+    void matchStAction(MatchStatementAST * match_node) override;
+    void returnStAction(ReturnStatementAST * return_node) override;
+    void blockStAction(BlockStatementAST * block_node) override;
+    void callStAction(CallStatementAST * call_node) override;
+    void assignStAction(AssignStatementAST * assign_node) override;
+    void initStAction(InitStatementAST * init_node) override;
+    void indexAssignStAction(IndexAssignStatementAST * index_assign_node) override;
+
+    void prototypeAction(PrototypeAST * proto_node) override;
+    void functionAction(FunctionAST * func_node) override;
+
+    void topLevelsAction(TopLevels * top_levels_node) override;
+    void funcDefsAction(FuncDefs * func_defs_node) override;
+    void programAction(BProgram * program_node) override;
+};
+
+} // namespace ctfe
+} // namespace bassoon
+
+#endif // Bassoon_include_const_eval_HXX
@@ -33,6 +33,12 @@ public:
     FuncContextError(): InternalBError("Func Context Error"){};
 };
 
+// An expression that can't be evaluated at compile time, it's left to run time
+class EvaluationAborted : public InternalBError{
+public:
+    EvaluationAborted(std::string reason): InternalBError(reason){};
+};
+
 class TypingError : public BError {
 public:
     TypingError();
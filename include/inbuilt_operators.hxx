@@ -6,81 +6,140 @@
 namespace bassoon
 {
 
-std::map<char, std::vector<BFType>> unary_operators = 
-{   {'-', 
-        {
-            {BFType(std::vector<BType>({type_int}), type_int)},
-            {BFType(std::vector<BType>({type_double}),type_double)}
-        }
-    },
-    {'!',
-        {
-            {BFType((std::vector<BType>{type_bool}),type_bool)}
+// each numeric type with itself, then the promotions in types.hxx in both orders
+static std::vector<BFType> numericOperator(bool comparison){
+    std::vector<BFType> overloads;
+    for(BType type : {type_int, type_double, type_long, type_float, type_uint, type_ulong}){
+        overloads.push_back(BFType(std::vector<BType>({type, type}), comparison? type_bool : type));
+    }
+    for(auto promotion : numeric_promotions){
+        BType result = comparison? type_bool : promotion.second;
+        overloads.push_back(BFType(std::vector<BType>({promotion.first, promotion.second}), result));
+        overloads.push_back(BFType(std::vector<BType>({promotion.second, promotion.first}), result));
+    }
+    // element-wise on vectors, with a scalar of the lane type on either side.
+    // Comparisons give a vector of bools, a mask.
+    for(BType lane : {type_int, type_double, type_long, type_float}){
+        for(int lanes : vector_lane_counts){
+            BType vector = vectorOf(lane, lanes);
+            BType result = comparison? vectorOf(type_bool, lanes) : vector;
+            overloads.push_back(BFType(std::vector<BType>({vector, vector}), result));
+            overloads.push_back(BFType(std::vector<BType>({vector, lane}), result));
+            overloads.push_back(BFType(std::vector<BType>({lane, vector}), result));
         }
     }
-};
-
+    return overloads;
+}
 
-
-std::map<char, std::vector<BFType>> binary_operators = 
-{   {'-', 
-        {
-            {BFType(std::vector<BType>({type_int,type_int}), type_int)},
-            {BFType(std::vector<BType>({type_double,type_double}),type_double)},
-            {BFType(std::vector<BType>({type_int,type_double}),type_double)},
-            {BFType(std::vector<BType>({type_double,type_int}),type_double)},
+// on the bits of ints: %, &, | and ^ with the numeric promotions between ints, and
+// element-wise on vectors of int and long. A shift's amount is any int, taken modulo
+// the width of the shifted int, and a vector can be shifted by a vector or one amount.
+static std::vector<BFType> integerOperator(bool shift){
+    const std::vector<BType> integers = {type_int, type_long, type_uint, type_ulong};
+    std::vector<BFType> overloads;
+    for(BType type : integers){
+        if(!shift){
+            overloads.push_back(BFType(std::vector<BType>({type, type}), type));
+            continue;
         }
-    },
-    {'+', 
-        {
-            {BFType(std::vector<BType>({type_int,type_int}), type_int)},
-            {BFType(std::vector<BType>({type_double,type_double}),type_double)},
-            {BFType(std::vector<BType>({type_int,type_double}),type_double)},
-            {BFType(std::vector<BType>({type_double,type_int}),type_double)},
+        for(BType amount : integers){
+            overloads.push_back(BFType(std::vector<BType>({type, amount}), type));
         }
-    },
-    {'*', 
-        {
-            {BFType(std::vector<BType>({type_int,type_int}), type_int)},
-            {BFType(std::vector<BType>({type_double,type_double}),type_double)},
-            {BFType(std::vector<BType>({type_int,type_double}),type_double)},
-            {BFType(std::vector<BType>({type_double,type_int}),type_double)},
-        }
-    },
-    {'/', 
-        {
-            {BFType(std::vector<BType>({type_int,type_int}), type_int)},
-            {BFType(std::vector<BType>({type_double,type_double}),type_double)},
-            {BFType(std::vector<BType>({type_int,type_double}),type_double)},
-            {BFType(std::vector<BType>({type_double,type_int}),type_double)},
-        }
-    },
-    {'<', 
-        {
-            {BFType(std::vector<BType>({type_int,type_int}), type_bool)},
-            {BFType(std::vector<BType>({type_double,type_double}),type_bool)},
-            {BFType(std::vector<BType>({type_int,type_double}),type_bool)},
-            {BFType(std::vector<BType>({type_double,type_int}),type_bool)},
-        }
-    },
-    {'>', 
-        {
-            {BFType(std::vector<BType>({type_int,type_int}), type_bool)},
-            {BFType(std::vector<BType>({type_double,type_double}),type_bool)},
-            {BFType(std::vector<BType>({type_int,type_double}),type_bool)},
-            {BFType(std::vector<BType>({type_double,type_int}),type_bool)},
+    }
+    for(auto promotion : numeric_promotions){
+        if(shift || !isIntegerType(promotion.first) || !isIntegerType(promotion.second)){
+            continue;
         }
-    },
-    {'&', 
-        {
-            {BFType(std::vector<BType>({type_bool,type_bool}), type_bool)},
+        overloads.push_back(BFType(std::vector<BType>({promotion.first, promotion.second}), promotion.second));
+        overloads.push_back(BFType(std::vector<BType>({promotion.second, promotion.first}), promotion.second));
+    }
+    for(BType lane : {type_int, type_long}){
+        for(int lanes : vector_lane_counts){
+            BType vector = vectorOf(lane, lanes);
+            overloads.push_back(BFType(std::vector<BType>({vector, vector}), vector));
+            overloads.push_back(BFType(std::vector<BType>({vector, lane}), vector));
+            if(!shift){
+                overloads.push_back(BFType(std::vector<BType>({lane, vector}), vector));
+            }
         }
-    },
-    {'|', 
-        {
-            {BFType(std::vector<BType>({type_bool,type_bool}), type_bool)},
+    }
+    return overloads;
+}
+
+// and &, | and ^ of ints are bitwise
+static std::vector<BFType> withIntegers(std::vector<BFType> overloads){
+    std::vector<BFType> integer_overloads = integerOperator(false);
+    overloads.insert(overloads.end(), integer_overloads.begin(), integer_overloads.end());
+    return overloads;
+}
+
+// bools, and element-wise on masks
+static std::vector<BFType> logicalOperator(){
+    std::vector<BFType> overloads = {BFType(std::vector<BType>({type_bool, type_bool}), type_bool)};
+    for(int lanes : vector_lane_counts){
+        BType mask = vectorOf(type_bool, lanes);
+        overloads.push_back(BFType(std::vector<BType>({mask, mask}), mask));
+    }
+    return overloads;
+}
+
+static std::vector<BFType> unaryOperator(std::vector<BType> lane_types){
+    std::vector<BFType> overloads;
+    for(BType lane : lane_types){
+        overloads.push_back(BFType(std::vector<BType>({lane}), lane));
+        for(int lanes : vector_lane_counts){
+            overloads.push_back(BFType(std::vector<BType>({vectorOf(lane, lanes)}), vectorOf(lane, lanes)));
         }
-    },
+    }
+    return overloads;
+}
+
+// negating complex numbers, or combining them with each other and with a real number
+// on either side
+static std::vector<BFType> withComplex(std::vector<BFType> overloads){
+    if(overloads[0].getArgCount() == 1){
+        overloads.push_back(BFType(std::vector<BType>({type_complex}), type_complex));
+        return overloads;
+    }
+    overloads.push_back(BFType(std::vector<BType>({type_complex, type_complex}), type_complex));
+    for(BType real : {type_int, type_double, type_float}){
+        overloads.push_back(BFType(std::vector<BType>({type_complex, real}), type_complex));
+        overloads.push_back(BFType(std::vector<BType>({real, type_complex}), type_complex));
+    }
+    return overloads;
+}
+
+// not, and, or, xor and nor of bits work on all their flags at once
+static std::vector<BFType> withBits(std::vector<BFType> overloads){
+    std::vector<BType> operands(overloads[0].getArgCount(), type_bits);
+    overloads.push_back(BFType(operands, type_bits));
+    return overloads;
+}
+
+std::map<char, std::vector<BFType>> unary_operators = 
+{   {'-', withComplex(unaryOperator({type_int, type_double, type_long, type_float}))},
+    {'!', withBits(unaryOperator({type_bool}))},
+    // the complement of an int
+    {'~', unaryOperator({type_int, type_long, type_uint, type_ulong})}
+};
+
+
+
+std::map<char, std::vector<BFType>> binary_operators = 
+{   {'-', withComplex(numericOperator(false))},
+    {'+', withComplex(numericOperator(false))},
+    {'*', withComplex(numericOperator(false))},
+    {'/', numericOperator(false)},
+    {'<', numericOperator(true)},
+    {'>', numericOperator(true)},
+    {'%', integerOperator(false)},
+    {'&', withIntegers(withBits(logicalOperator()))},
+    {'|', withIntegers(withBits(logicalOperator()))},
+    {'^', withIntegers(withBits(logicalOperator()))},
+    {'~', withBits(logicalOperator())},
+    // << and >>, the latter logical for unsigned ints and arithmetic for signed
+    {'l', integerOperator(true)},
+    {'r', integerOperator(true)},
 };
 
 } // namespace bassoon
@@ -2,6 +2,7 @@
 #define Bassoon_include_lexer_HXX
 
 #include "source_loc.hxx"
+#include <cstdint>
 #include <string>
 #include <functional>
 
@@ -12,6 +13,9 @@ class Lexer{
     static std::string identifier_;
     static double double_val_;
     static int int_val_;
+    static int64_t long_val_;
+    static float float_val_;
+    static uint64_t unsigned_val_; // uint and ulong literals
     static bool bool_val_; // redundant?
     static int check_keyword(std::string candidate_token);
 public:
@@ -22,6 +26,9 @@ public:
     static std::string getIdentifier();
     static double getDouble();
     static int getInt();
+    static int64_t getLong();
+    static float getFloat();
+    static uint64_t getUnsigned();
     static SourceLoc getLoc();
 };
 
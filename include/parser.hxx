@@ -28,18 +28,37 @@ class Parser{
     static std::unique_ptr<ExprAST> parseBoolExpr();
     static std::unique_ptr<ExprAST> parseIntExpr();
     static std::unique_ptr<ExprAST> parseDoubleExpr();
+    static std::unique_ptr<ExprAST> parseLongExpr();
+    static std::unique_ptr<ExprAST> parseFloatExpr();
+    static std::unique_ptr<ExprAST> parseUnsignedExpr();
     static std::unique_ptr<ExprAST> parseIdentifierExpr();
     static std::unique_ptr<ExprAST> parseCallExpr();
+    static std::unique_ptr<ExprAST> parseArrayExpr();
+    static std::unique_ptr<ExprAST> parseVectorExpr();
+    static std::unique_ptr<ExprAST> parseComplexExpr();
+    static std::unique_ptr<ExprAST> parseBitsExpr();
+    static std::unique_ptr<ExprAST> parseArrayLiteralExpr();
+    static bool parseArgs(std::vector<std::unique_ptr<ExprAST>> & args);
+    static std::unique_ptr<ExprAST> parseIndex();
+    static std::unique_ptr<ExprAST> parseSlice(SourceLoc slice_loc, const std::string & array, std::unique_ptr<ExprAST> start);
+    static BType parseType();
+    static int parseLayout();
+    static bool parseField(std::string & field);
+    static bool parseRecord();
 
     static std::unique_ptr<StatementAST> parseStatement();
     static std::unique_ptr<StatementAST> parseBlockStatement();
     static std::unique_ptr<StatementAST> parseIdentifierStatement();
     static std::unique_ptr<StatementAST> parseCallStatement(SourceLoc id_loc, std::string id);
-    static std::unique_ptr<StatementAST> parseInitStatement(SourceLoc id_loc, std::string id);
+    static std::unique_ptr<StatementAST> parseInitStatement(SourceLoc id_loc, std::string id, bool is_const = false);
+    static std::unique_ptr<StatementAST> parseConstStatement();
     static std::unique_ptr<StatementAST> parseAssignStatement(SourceLoc id_loc, std::string id);
+    static std::unique_ptr<StatementAST> parseIndexAssignStatement(SourceLoc id_loc, std::string id);
     static std::unique_ptr<StatementAST> parseIfStatement();
     static std::unique_ptr<StatementAST> parseForStatement();
     static std::unique_ptr<StatementAST> parseWhileStatement();
+    static std::unique_ptr<StatementAST> parseMatchStatement();
+    static bool parseMatchBound(int64_t & bound);
     static std::unique_ptr<StatementAST> parseReturnStatement();
 
     static std::unique_ptr<FunctionAST> parseDefinition();
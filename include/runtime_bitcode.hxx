@@ -0,0 +1,16 @@
+#ifndef Bassoon_include_runtime_bitcode_HXX
+#define Bassoon_include_runtime_bitcode_HXX
+
+#include <cstddef>
+
+namespace bassoon
+{
+
+// The runtime library (src/runtime) as LLVM bitcode, generated at build time.
+// runtime_bitcode_size is 0 when the build couldn't produce it.
+extern const unsigned char runtime_bitcode[];
+extern const std::size_t runtime_bitcode_size;
+
+} // namespace bassoon
+
+#endif // Bassoon_include_runtime_bitcode_HXX
@@ -43,6 +43,61 @@ enum token {
 
     //extern
     tok_extern = -25,
+
+    //function annotations
+    tok_multiversion = -26,
+    tok_export = -27,
+    tok_tailrec = -28,
+    tok_fastmath = -29,
+    tok_contract = -30,
+    tok_strict = -31,
+
+    //declarations
+    tok_const = -32,
+
+    //function annotations
+    tok_memo = -33,
+
+    //types
+    tok_array = -34,
+    tok_long = -35,
+    tok_float = -36,
+
+    //primary
+    tok_number_long = -37,
+    tok_number_float = -38,
+
+    //types
+    tok_vec2 = -39,
+    tok_vec4 = -40,
+    tok_vec8 = -41,
+    tok_complex = -42,
+
+    //records and the layouts of arrays of them
+    tok_record = -43,
+    tok_aos = -44,
+    tok_soa = -45,
+    tok_aosoa = -46,
+
+    //views of arrays
+    tok_slice = -47,
+    tok_strided = -48,
+
+    //packed flags
+    tok_bits = -49,
+
+    //unsigned ints, their literals (10u, 10uL) and shifts
+    tok_uint = -50,
+    tok_ulong = -51,
+    tok_number_uint = -52,
+    tok_number_ulong = -53,
+    tok_shl = -54,
+    tok_shr = -55,
+
+    //match statements, their arms and ranges
+    tok_match = -56,
+    tok_case = -57,
+    tok_to = -58,
 };
 
 static std::string tokToStr(int t){
@@ -80,6 +135,41 @@ static std::string tokToStr(int t){
     case tok_or : return "tok_or";
     case tok_xor : return "tok_xor";
     case tok_nor : return "tok_nor";
+
+    //function annotations
+    case tok_multiversion : return "tok_multiversion";
+    case tok_export : return "tok_export";
+    case tok_tailrec : return "tok_tailrec";
+    case tok_fastmath : return "tok_fastmath";
+    case tok_contract : return "tok_contract";
+    case tok_strict : return "tok_strict";
+    case tok_const : return "tok_const";
+    case tok_memo : return "tok_memo";
+    case tok_array : return "tok_array";
+    case tok_long : return "tok_long";
+    case tok_float : return "tok_float";
+    case tok_number_long : return "tok_number_long";
+    case tok_number_float : return "tok_number_float";
+    case tok_vec2 : return "tok_vec2";
+    case tok_vec4 : return "tok_vec4";
+    case tok_vec8 : return "tok_vec8";
+    case tok_complex : return "tok_complex";
+    case tok_record : return "tok_record";
+    case tok_aos : return "tok_aos";
+    case tok_soa : return "tok_soa";
+    case tok_aosoa : return "tok_aosoa";
+    case tok_slice : return "tok_slice";
+    case tok_strided : return "tok_strided";
+    case tok_bits : return "tok_bits";
+    case tok_uint : return "tok_uint";
+    case tok_ulong : return "tok_ulong";
+    case tok_number_uint : return "tok_number_uint";
+    case tok_number_ulong : return "tok_number_ulong";
+    case tok_shl : return "tok_shl";
+    case tok_shr : return "tok_shr";
+    case tok_match : return "tok_match";
+    case tok_case : return "tok_case";
+    case tok_to : return "tok_to";
     default: return "not a token";
     }
 }
@@ -87,7 +177,12 @@ static std::string tokToStr(int t){
 static int tokIsType(int tok){
     if (tok == tok_bool ||
         tok == tok_int ||
-        tok == tok_double)
+        tok == tok_double ||
+        tok == tok_long ||
+        tok == tok_float ||
+        tok == tok_complex ||
+        tok == tok_uint ||
+        tok == tok_ulong)
         return 1;
     else
         return 0;
@@ -100,6 +195,77 @@ static BType tokToType(int tok){
     case tok_bool: return type_bool;
     case tok_int: return type_int;
     case tok_double: return type_double;
+    case tok_long: return type_long;
+    case tok_float: return type_float;
+    case tok_complex: return type_complex;
+    case tok_uint: return type_uint;
+    case tok_ulong: return type_ulong;
+    }
+}
+
+// lanes of the vector type a token starts, 0 if it doesn't
+static int tokToLanes(int tok){
+    switch(tok)
+    {
+    default: return 0;
+    case tok_vec2: return 2;
+    case tok_vec4: return 4;
+    case tok_vec8: return 8;
+    }
+}
+
+// word operators share the opcode of their symbol form, nor has no symbol
+// so '~' stands in for it (as a unary operator '~' is the complement of an int).
+// The shifts are two characters, 'l' and 'r' stand in for << and >>.
+static int tokToOperator(int tok){
+    switch(tok)
+    {
+    default: return tok;
+    case tok_not: return '!';
+    case tok_and: return '&';
+    case tok_or: return '|';
+    case tok_xor: return '^';
+    case tok_nor: return '~';
+    case tok_shl: return 'l';
+    case tok_shr: return 'r';
+    }
+}
+
+// how an opcode is written, for messages
+static std::string opcodeToStr(int opcode){
+    switch(opcode)
+    {
+    default: return std::string(1, (char) opcode);
+    case 'l': return "<<";
+    case 'r': return ">>";
+    }
+}
+
+// whether a token is an operator's word form, which are logical: on ints only
+// the symbols are, bitwise
+static bool tokIsWordOperator(int tok){
+    return tok == tok_not || tok == tok_and || tok == tok_or || tok == tok_xor || tok == tok_nor;
+}
+
+static int tokIsAnnotation(int tok){
+    if (tok == tok_multiversion || tok == tok_export || tok == tok_tailrec
+        || tok == tok_fastmath || tok == tok_contract || tok == tok_strict || tok == tok_memo)
+        return 1;
+    else
+        return 0;
+}
+
+static FuncAnnotation tokToAnnotation(int tok){
+    switch(tok)
+    {
+    default: return not_an_annotation;
+    case tok_multiversion: return annot_multiversion;
+    case tok_export: return annot_export;
+    case tok_tailrec: return annot_tailrec;
+    case tok_fastmath: return annot_fastmath;
+    case tok_contract: return annot_contract;
+    case tok_strict: return annot_strict;
+    case tok_memo: return annot_memo;
     }
 }
 
@@ -3,6 +3,7 @@
 
 #include <fstream>
 #include <map>
+#include <set>
 
 #include "ast.hxx"
 #include "spdlog/spdlog.h"
@@ -30,6 +31,81 @@ class TypeVisitor : public ASTVisitor{
     // only return and block statements push to this stack. A block statement with
     // no return statement within will push the type_void
     std::vector<BType> return_type_stack_;
+
+    // the function whose body is being checked, and the call (if any) whose
+    // value the return statement being checked returns
+    std::string current_function_ = "";
+    BType current_return_type_ = type_unknown;
+    bool current_tailrec_ = false;
+    const CallExprAST * tail_position_call_ = nullptr;
+
+    // top level initialisations by global name, and whether the assignment
+    // being checked is one of their initialisations
+    std::map<std::string, InitStatementAST *> globals_;
+    bool initialising_ = false;
+    bool isGlobal(std::string identifier);
+
+    // purity: the functions each function calls, and those with effects of their
+    // own (impure builtins, non-const globals). Resolved after the bodies are checked.
+    std::map<std::string, FunctionAST *> functions_;
+    std::map<std::string, std::set<std::string>> callees_;
+    std::set<std::string> impure_functions_;
+    void markPureFunctions();
+
+    // views: array and slice variables (named function/name, or /name at the top level
+    // and for globals) by the variables made to view their elements, the variables
+    // elements are written through, those given new arrays and the globals each function
+    // uses. With the array and slice arguments of every call they prove slice arguments
+    // readonly, nocapture and noalias once everything is checked.
+    std::map<std::string, std::set<std::string>> viewers_;
+    std::map<std::string, std::set<std::string>> viewed_; // the reverse of viewers_
+    std::set<std::string> written_views_;
+    std::set<std::string> allocated_views_;
+    std::map<std::string, std::set<std::string>> referenced_globals_;
+    struct ViewCall{
+        std::string caller;
+        std::string callee;
+        std::vector<std::string> args; // the variable each argument views, "" for other types
+    };
+    std::vector<ViewCall> view_calls_;
+    std::map<std::string, std::vector<std::string>> arg_names_;
+    std::string viewNode(const std::string & identifier);
+    std::string viewNodeOf(const ExprAST & expr);
+    void addView(const std::string & viewed, const std::string & viewer);
+    void referenceVariable(const std::string & identifier);
+    void checkSliceLifetime(const std::string & slice, const ExprAST & value, const std::string & loc_str);
+    bool viewRoots(const std::string & caller, const std::string & node, std::set<std::string> & roots);
+    void markSliceArguments();
+    void checkConstTables();
+
+    // the array allocation being checked as a variable's initialisation, the only
+    // place one can be, so every array has a variable whose scope frees it
+    const ExprAST * initialised_array_ = nullptr;
+    // and the variable's type, which gives an array of records its layout
+    BType initialised_type_ = type_unknown;
+    // records are only array elements, and their names aren't variables'
+    void checkVariableType(const std::string & identifier, BType type, const std::string & loc_str);
+
+    // bounds check elimination: in the body of for (i of int = 0; i < len(xs); i = i + 1;)
+    // xs[i] is in bounds unless the body assigns i or defines another i or xs
+    struct InBoundsLoop{
+        std::string index;
+        std::string array;
+        std::vector<IndexExprAST *> accesses;
+        bool valid = true;
+    };
+    std::vector<InBoundsLoop> in_bounds_loops_;
+    bool isInBoundsLoop(ForStatementAST * for_node, InBoundsLoop & loop);
+    void invalidateInBounds(std::string identifier);
+    // the vector builtins, typed by their arguments rather than a BFType
+    void typeVectorBuiltin(CallExprAST * call_node);
+    void typeBitsBuiltin(CallExprAST * call_node);
+    void typeRotateBuiltin(CallExprAST * call_node);
+    // operations on bits are only the value assigned to a bits variable, which is
+    // computed a word at a time into its flags; these are the expressions being checked
+    // that can be such operations
+    std::set<const ExprAST *> bits_operands_;
+    void checkBitsOperation(const ExprAST & operation, BType result_type, std::vector<const ExprAST *> operands);
     BType popReturnType();
     void checkRetStackSize(int original_size);
     
@@ -43,12 +119,13 @@ class TypeVisitor : public ASTVisitor{
     void pushNewScope(std::vector<std::string> new_scope);
     void pushToCurrentScope(std::string new_definition);
     bool isInCurrentScope(std::string candidate_id);
+    int scopeDepth(const std::string & identifier);
 
     BType typeContext(std::string identifier); // get the type of an identifier in current scope.
     BFType funcContext(std::string func_name); 
     void addTypeContext(std::string identifier, BType type){identifier_stacks_[identifier].push_back(type);}
     void addFuncContext(std::string func_name, BFType type){func_types_[func_name] = type;}
-    bool isInFuncContext(std::string candidate_f){for (auto f: func_types_){if(f.first==candidate_f){return true;}}return false;}
+    bool isInFuncContext(std::string candidate_f){return func_types_.find(candidate_f) != func_types_.end();}
 
     void addVarDefinition(std::string identifier, BType type);
     //bool varIsDefined(std::string identifier);
@@ -64,19 +141,29 @@ public:
     void boolExprAction(BoolExprAST * bool_node) override;
     void intExprAction(IntExprAST * int_node) override;
     void doubleExprAction(DoubleExprAST * double_node) override;
+    void longExprAction(LongExprAST * long_node) override;
+    void floatExprAction(FloatExprAST * float_node) override;
+    void unsignedExprAction(UnsignedExprAST * unsigned_node) override;
     void variableExprAction(VariableExprAST * variable_node) override;
     void callExprAction(CallExprAST * call_node) override;
     void unaryExprAction(UnaryExprAST * unary_node) override;
     void binaryExprAction(BinaryExprAST * binary_node) override;
+    void arrayExprAction(ArrayExprAST * array_node) override;
+    void indexExprAction(IndexExprAST * index_node) override;
+    void sliceExprAction(SliceExprAST * slice_node) override;
+    void vectorExprAction(VectorExprAST * vector_node) override;
+    void arrayLiteralExprAction(ArrayLiteralExprAST * literal_node) override;
     
     void ifStAction(IfStatementAST * if_node) override;
     void forStAction(ForStatementAST * for_node) override;
     void whileStAction(WhileStatementAST * while_node) override;
+    void matchStAction(MatchStatementAST * match_node) override;
     void returnStAction(ReturnStatementAST * return_node) override;
     void blockStAction(BlockStatementAST * block_node) override;
     void callStAction(CallStatementAST * call_node) override;
     void assignStAction(AssignStatementAST * assign_node) override;
     void initStAction(InitStatementAST * init_node) override;
+    void indexAssignStAction(IndexAssignStatementAST * index_assign_node) override;
 
     void prototypeAction(PrototypeAST * proto_node) override;
     void functionAction(FunctionAST * func_node) override;
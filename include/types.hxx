@@ -1,7 +1,10 @@
 #ifndef Bassoon_include_types_HXX
 #define Bassoon_include_types_HXX
 
+#include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace bassoon{
 
@@ -12,8 +15,144 @@ enum BType {
     type_bool = 1,
     type_int = 2,
     type_double = 3,
+    type_long = 4, // 64 bit int
+    type_float = 5, // 32 bit float
+    type_complex = 6, // a pair of doubles
+    // a flag, packed 64 to a word as the element of bits
+    type_bit = 7,
+    type_uint = 8, // 32 bit unsigned int
+    type_ulong = 9, // 64 bit unsigned int
+    // record types are numbered from here in the order they're declared
+    type_record = 0x10,
+    // array of T is T with this bit set, e.g. type_array | type_double
+    type_array = 0x100,
+    // vecN of T is T with log2(N) in these bits, e.g. type_vec4 | type_float
+    type_vec2 = 0x200,
+    type_vec4 = 0x400,
+    type_vec8 = 0x600,
+    type_vec_lanes = 0xE00,
+    // the layout of an array of records, array of structs unless one of these is set:
+    // struct of arrays, or blocks of N records holding an array of each field, with
+    // log2(N) in the aosoa bits
+    type_soa = 0x1000,
+    type_aosoa = 0xE000,
+    type_layout = 0xF000,
+    // slice of T: an array of T that views another's elements instead of owning its
+    // own, with a stride between the elements it views if strided is set too
+    type_slice = 0x10000,
+    type_strided = 0x20000,
+    // bits: an array of flags
+    type_bits = type_array | type_bit,
 };
 
+static const std::vector<int> vector_lane_counts = {2, 4, 8};
+
+static bool isArrayType(int t){
+    return t > 0 && (t & type_array);
+}
+
+static BType arrayOf(BType element, int layout = 0){
+    return (BType) (element | type_array | layout);
+}
+
+static BType elementType(BType array){
+    return (BType) (array & ~(type_array | type_layout | type_slice | type_strided));
+}
+
+static bool isBitsType(int t){
+    return t == type_bits;
+}
+
+static bool isSliceType(int t){
+    return isArrayType(t) && (t & type_slice);
+}
+
+static bool isStridedType(int t){
+    return isSliceType(t) && (t & type_strided);
+}
+
+static BType sliceOf(BType element, bool strided = false){
+    return (BType) (element | type_array | type_slice | (strided? type_strided : 0));
+}
+
+static int arrayLayout(BType array){
+    return array & type_layout;
+}
+
+static int aosoaLayout(int records_per_block){
+    int log_records = 0;
+    while((1 << log_records) < records_per_block) ++log_records;
+    return log_records << 13;
+}
+
+// records in each block of an aosoa array, 0 for the other layouts
+static int aosoaBlockSize(int layout){
+    return (layout & type_aosoa)? 1 << ((layout & type_aosoa) >> 13) : 0;
+}
+
+static bool isVectorType(int t){
+    return t > 0 && !(t & type_array) && (t & type_vec_lanes);
+}
+
+static BType vectorOf(BType lane, int lanes){
+    int log_lanes = lanes == 2? 1 : lanes == 4? 2 : 3;
+    return (BType) (lane | (log_lanes << 9));
+}
+
+static int laneCount(int vector){
+    return 1 << ((vector & type_vec_lanes) >> 9);
+}
+
+// the type of a vector's lanes, a scalar type is its own
+static BType laneType(int t){
+    return (BType) (t & ~type_vec_lanes);
+}
+
+static bool isRecordType(int t){
+    return t >= type_record && t < type_array;
+}
+
+// A record's fields as declared. They're stored largest first (storage_order), so
+// neither a record nor a block of them in an aosoa array has padding between fields.
+struct Record{
+    std::string name;
+    std::vector<std::pair<std::string, BType>> fields;
+    std::vector<int> storage_order;
+    // the field's index in fields, -1 if there's no such field
+    int fieldIndex(const std::string & field) const {
+        for(int i = 0; i < (int) fields.size(); ++i){
+            if(fields[i].first == field) return i;
+        }
+        return -1;
+    }
+    // where the field is in the record's storage
+    int storageIndex(int field_index) const {
+        for(int i = 0; i < (int) storage_order.size(); ++i){
+            if(storage_order[i] == field_index) return i;
+        }
+        return -1;
+    }
+};
+
+// the declared records, record type type_record + i is the ith. Shared by the
+// parser, which adds them, and the typechecker and codegen.
+inline std::vector<Record> & recordTypes(){
+    static std::vector<Record> records;
+    return records;
+}
+
+inline const Record & recordOf(int t){
+    return recordTypes()[t - type_record];
+}
+
+// the record type with this name, not_a_type if none is declared
+inline BType recordNamed(const std::string & name){
+    for(int i = 0; i < (int) recordTypes().size(); ++i){
+        if(recordTypes()[i].name == name) return (BType) (type_record + i);
+    }
+    return not_a_type;
+}
+
 class BFType{
     std::vector<BType> argument_types_; // can be const/final? 
     BType return_type_;
@@ -28,32 +167,147 @@ public:
     bool isValid(){return valid_;}
 };
 
+// A value known at compile time, the member for its type is the one set
+struct BValue{
+    BType type = type_unknown;
+    bool bool_value = false;
+    int int_value = 0;
+    double double_value = 0.0;
+    int64_t long_value = 0;
+    float float_value = 0.0f;
+    uint32_t uint_value = 0;
+    uint64_t ulong_value = 0;
+};
+
+// Annotations written between a function's prototype and 'as'
+// define iter(re of double, im of double) gives int multiversion as {...}
+enum FuncAnnotation {
+    not_an_annotation = -1,
+    annot_multiversion = 0,
+    annot_export = 1, // visible outside the module, otherwise functions are internal
+    annot_tailrec = 2, // every recursive call must be a tail call
+    // numeric modes, overriding the compilation's for this function
+    annot_fastmath = 3,
+    annot_contract = 4,
+    annot_strict = 5,
+    annot_memo = 6, // pure, results cached by argument (-memo-size)
+};
+
+static std::string annotationToStr(FuncAnnotation annotation){
+    switch (annotation)
+    {
+    case annot_multiversion : return "multiversion";
+    case annot_export : return "export";
+    case annot_tailrec : return "tailrec";
+    case annot_fastmath : return "fastmath";
+    case annot_contract : return "contract";
+    case annot_strict : return "strict";
+    case annot_memo : return "memo";
+    default: return "not an annotation";
+    }
+}
+
 static std::string typeToStr(int t){
+    if(isBitsType(t)){
+        return "bits";
+    }
+    if(isSliceType(t)){
+        return "slice of " + typeToStr(elementType((BType) t)) + (isStridedType(t)? " strided" : "");
+    }
+    if(isArrayType(t)){
+        int layout = arrayLayout((BType) t);
+        std::string layout_str = !layout? "" : layout == type_soa? " soa"
+            : " aosoa(" + std::to_string(aosoaBlockSize(layout)) + ")";
+        return "array of " + typeToStr(elementType((BType) t)) + layout_str;
+    }
+    if(isRecordType(t)){
+        return recordOf(t).name;
+    }
+    if(isVectorType(t)){
+        return "vec" + std::to_string(laneCount(t)) + " of " + typeToStr(laneType(t));
+    }
     switch (t)
     {
     case type_void : return "void";
     case type_bool : return "bool";
     case type_int : return "int";
     case type_double : return "double";
+    case type_long : return "long";
+    case type_float : return "float";
+    case type_complex : return "complex";
+    case type_uint : return "uint";
+    case type_ulong : return "ulong";
     default: return "not a type";
     }
 }
 
-static bool isCastable(BType origin, BType destination){
-    switch(origin){
-    case(type_bool):{
-        return false;
-    }
-    case(type_int):{
-        return destination == type_double;
+static bool isNumericType(int t){
+    return t == type_int || t == type_long || t == type_float || t == type_double
+        || t == type_uint || t == type_ulong;
+}
+
+static bool isIntegerType(int t){
+    return t == type_int || t == type_long || t == type_uint || t == type_ulong;
+}
+
+static bool isUnsignedType(int t){
+    return t == type_uint || t == type_ulong;
+}
+
+static bool isFloatingType(int t){
+    return t == type_float || t == type_double;
+}
+
+// bytes a value of a scalar type takes in memory
+static int typeBytes(int t){
+    switch(t){
+    case type_bool : return 1;
+    case type_int : case type_uint : case type_float : return 4;
+    case type_long : case type_ulong : case type_double : return 8;
+    case type_complex : return 16;
+    default: return 0;
     }
-    case(type_double):{
-        return destination == type_int;
+}
+
+// numbers convert implicitly to any other numeric type on assignment and as
+// arguments; a narrowing conversion truncates or rounds
+// An array or slice converts to a slice of the same elements, which views them all;
+// only a strided slice can view a strided one.
+static bool isCastable(BType origin, BType destination){
+    if(isSliceType(destination)){
+        return origin != destination && isArrayType(origin) && elementType(origin) == elementType(destination)
+            && !arrayLayout(origin) && (!isStridedType(origin) || isStridedType(destination));
     }
-    default:{
-        return false;
+    return origin != destination && isNumericType(origin) && isNumericType(destination);
+}
+
+// the only mixed operands arithmetic and comparisons allow, the narrower type
+// (first) is promoted to the wider. long with float or double needs a conversion,
+// as do signed and unsigned ints of the same width or int with ulong.
+static const std::vector<std::pair<BType, BType>> numeric_promotions = {
+    {type_int, type_long},
+    {type_int, type_float},
+    {type_int, type_double},
+    {type_float, type_double},
+    {type_uint, type_ulong},
+    {type_uint, type_long},
+    {type_uint, type_float},
+    {type_uint, type_double},
+};
+
+// the type mixed numeric operands are both converted to, not_a_type if they don't mix.
+// A vector and a scalar of its lane type mix, the scalar is splat across the lanes.
+static BType promotedType(BType lhs, BType rhs){
+    if(lhs == rhs){
+        return lhs;
     }
+    if(isVectorType(lhs) && rhs == laneType(lhs)) return lhs;
+    if(isVectorType(rhs) && lhs == laneType(rhs)) return rhs;
+    for(auto promotion : numeric_promotions){
+        if(promotion.first == lhs && promotion.second == rhs) return rhs;
+        if(promotion.first == rhs && promotion.second == lhs) return lhs;
     }
+    return not_a_type;
 }
 
 
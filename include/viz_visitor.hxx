@@ -31,19 +31,29 @@ public:
     void boolExprAction(BoolExprAST * bool_node) override;
     void intExprAction(IntExprAST * int_node) override;
     void doubleExprAction(DoubleExprAST * double_node) override;
+    void longExprAction(LongExprAST * long_node) override;
+    void floatExprAction(FloatExprAST * float_node) override;
+    void unsignedExprAction(UnsignedExprAST * unsigned_node) override;
     void variableExprAction(VariableExprAST * variable_node) override;
     void callExprAction(CallExprAST * call_node) override;
     void unaryExprAction(UnaryExprAST * unary_node) override;
     void binaryExprAction(BinaryExprAST * binary_node) override;
+    void arrayExprAction(ArrayExprAST * array_node) override;
+    void indexExprAction(IndexExprAST * index_node) override;
+    void sliceExprAction(SliceExprAST * slice_node) override;
+    void vectorExprAction(VectorExprAST * vector_node) override;
+    void arrayLiteralExprAction(ArrayLiteralExprAST * literal_node) override;
     
     void ifStAction(IfStatementAST * if_node) override;
     void forStAction(ForStatementAST * for_node) override;
     void whileStAction(WhileStatementAST * while_node) override;
+    void matchStAction(MatchStatementAST * match_node) override;
     void returnStAction(ReturnStatementAST * return_node) override;
     void blockStAction(BlockStatementAST * block_node) override;
     void callStAction(CallStatementAST * call_node) override;
     void assignStAction(AssignStatementAST * assign_node) override;
     void initStAction(InitStatementAST * init_node) override;
+    void indexAssignStAction(IndexAssignStatementAST * index_assign_node) override;
 
     void prototypeAction(PrototypeAST * proto_node) override;
     void functionAction(FunctionAST * func_node) override;
@@ -4,29 +4,165 @@
 #include "viz_visitor.hxx"
 #include "type_visitor.hxx"
 #include "codegen.hxx"
+#include "const_eval.hxx"
 #include <iostream>
 
+#include "llvm/Support/CommandLine.h"
 #include "spdlog/spdlog.h"
 
+static llvm::cl::OptionCategory bassoon_options("Bassoon options");
+
+static llvm::cl::opt<spdlog::level::level_enum> log_level("log-level",
+    llvm::cl::desc("Logging level"),
+    llvm::cl::values(
+        clEnumValN(spdlog::level::trace, "trace", "Everything"),
+        clEnumValN(spdlog::level::debug, "debug", "Parser, typechecker and codegen internals"),
+        clEnumValN(spdlog::level::info, "info", "Compilation phases"),
+        clEnumValN(spdlog::level::warn, "warn", "Warnings and errors"),
+        clEnumValN(spdlog::level::err, "error", "Errors only"),
+        clEnumValN(spdlog::level::off, "off", "Nothing")),
+    llvm::cl::init(spdlog::level::debug),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<std::string> target_cpu("mcpu",
+    llvm::cl::desc("Cpu to tune for: a processor name, a microarchitecture level "
+                   "(x86-64, x86-64-v2, x86-64-v3, x86-64-v4) or 'native' for the host"),
+    llvm::cl::value_desc("cpu"),
+    llvm::cl::init("generic"),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<std::string> target_features("mattr",
+    llvm::cl::desc("Comma separated target features to enable (+) or disable (-), e.g. +avx2,+fma"),
+    llvm::cl::value_desc("a1,+a2,-a3,..."),
+    llvm::cl::init(""),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::list<std::string> multiversion_levels("mv-levels",
+    llvm::cl::desc("ISA levels that multiversion functions are cloned for (baseline, avx2, avx512), "
+                   "the baseline is always kept as the fallback"),
+    llvm::cl::value_desc("level,..."),
+    llvm::cl::CommaSeparated,
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<bassoon::codegen::OptLevel> opt_level("O",
+    llvm::cl::desc("Optimisation level"),
+    llvm::cl::values(
+        clEnumValN(bassoon::codegen::opt_O0, "0", "No optimisation"),
+        clEnumValN(bassoon::codegen::opt_O1, "1", "Quick optimisations"),
+        clEnumValN(bassoon::codegen::opt_O2, "2", "Default optimisations"),
+        clEnumValN(bassoon::codegen::opt_O3, "3", "Aggressive optimisations"),
+        clEnumValN(bassoon::codegen::opt_Os, "s", "Optimise for size"),
+        clEnumValN(bassoon::codegen::opt_Oz, "z", "Optimise harder for size"),
+        clEnumValN(bassoon::codegen::opt_jit, "jit", "mem2reg, instcombine, simplifycfg and gvn: fast to compile")),
+    llvm::cl::Prefix,
+    llvm::cl::init(bassoon::codegen::opt_O2),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<std::string> pass_pipeline("passes",
+    llvm::cl::desc("Textual pass pipeline to run instead of the -O level's, as for opt, e.g. 'function(mem2reg,gvn)'"),
+    llvm::cl::value_desc("pipeline"),
+    llvm::cl::init(""),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<bool> print_ir("print-ir",
+    llvm::cl::desc("Print the IR before and after optimisation"),
+    llvm::cl::init(false),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<unsigned> partitions("partitions",
+    llvm::cl::desc("Split the module into N partitions optimised and compiled in parallel, "
+                   "after interprocedural optimisation of the whole module"),
+    llvm::cl::value_desc("N"),
+    llvm::cl::init(1),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<bool> direct_ssa("ssa",
+    llvm::cl::desc("Build SSA directly during codegen instead of through allocas, "
+                   "so variables stay in registers without mem2reg"),
+    llvm::cl::init(false),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<bassoon::codegen::NumericMode> numeric_mode("numeric-mode",
+    llvm::cl::desc("Numeric semantics of functions without a fastmath, contract or strict annotation"),
+    llvm::cl::values(
+        clEnumValN(bassoon::codegen::num_strict, "strict", "IEEE floating point and wrapping integers"),
+        clEnumValN(bassoon::codegen::num_contract, "contract", "Allow fused multiply-add"),
+        clEnumValN(bassoon::codegen::num_fast, "fast", "All fast-math flags, integer overflow is undefined (nsw)")),
+    llvm::cl::init(bassoon::codegen::num_strict),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<llvm::TargetLibraryInfoImpl::VectorLibrary> vector_library("veclib",
+    llvm::cl::desc("Vector maths library that calls to exp, sin etc. in vectorised loops are mapped to"),
+    llvm::cl::values(
+        clEnumValN(llvm::TargetLibraryInfoImpl::NoLibrary, "none", "Scalar calls only, loops calling maths builtins don't vectorise"),
+        clEnumValN(llvm::TargetLibraryInfoImpl::LIBMVEC_X86, "libmvec", "glibc's libmvec, link with -lmvec"),
+        clEnumValN(llvm::TargetLibraryInfoImpl::SVML, "svml", "Intel's short vector math library"),
+        clEnumValN(llvm::TargetLibraryInfoImpl::MASSV, "massv", "IBM's MASS vector library"),
+        clEnumValN(llvm::TargetLibraryInfoImpl::Accelerate, "accelerate", "Apple's Accelerate framework"),
+        clEnumValN(llvm::TargetLibraryInfoImpl::DarwinLibSystemM, "darwin-libsystem-m", "Darwin's libsystem_m")),
+    llvm::cl::init(llvm::TargetLibraryInfoImpl::NoLibrary),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<bool> link_runtime("link-runtime",
+    llvm::cl::desc("Link the runtime's bitcode into the program so its functions can be inlined, "
+                   "otherwise the program must be linked with libbassoon_rt.a"),
+    llvm::cl::init(true),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<unsigned> ctfe_steps("ctfe-steps",
+    llvm::cl::desc("Steps the compile time evaluation of a const or a call of a pure function "
+                   "may take before it's left to run time, 0 to evaluate nothing"),
+    llvm::cl::value_desc("N"),
+    llvm::cl::init(1000000),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<unsigned> ctfe_depth("ctfe-depth",
+    llvm::cl::desc("Depth of calls compile time evaluation may recurse to"),
+    llvm::cl::value_desc("N"),
+    llvm::cl::init(512),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<unsigned> memo_size("memo-size",
+    llvm::cl::desc("Entries in each memo function's cache: the argument range of a direct-mapped table "
+                   "for one int argument, otherwise the slots of a hash table"),
+    llvm::cl::value_desc("N"),
+    llvm::cl::init(4096),
+    llvm::cl::cat(bassoon_options));
+
+static llvm::cl::opt<bassoon::codegen::MatchLowering> match_lowering("match-lowering",
+    llvm::cl::desc("How match statements are lowered"),
+    llvm::cl::values(
+        clEnumValN(bassoon::codegen::match_auto, "auto", "By the density of the arms' values"),
+        clEnumValN(bassoon::codegen::match_table, "table", "A lookup table when every arm returns a constant"),
+        clEnumValN(bassoon::codegen::match_switch, "switch", "A switch of every value between the outermost arms"),
+        clEnumValN(bassoon::codegen::match_search, "search", "A binary search over the starts of the arms' ranges")),
+    llvm::cl::init(bassoon::codegen::match_auto),
+    llvm::cl::cat(bassoon_options));
+
 int main(int argc, char *argv[]){
-    // Todo add CLI and specify logging level
-    spdlog::set_level(spdlog::level::debug);
+    llvm::cl::HideUnrelatedOptions(bassoon_options);
+    llvm::cl::ParseCommandLineOptions(argc, argv, "Bassoon: compiles a program read from stdin to output.o\n");
+    spdlog::set_level(log_level);
     spdlog::info("Starting Bassoon");
 
     spdlog::info("Parsing");
     std::shared_ptr<bassoon::BProgram> program = bassoon::Parser::parseLoop();
-    
+
     // Either switch back to manual delete to close files after visualisation
     // or close them earlier than destruction
     spdlog::info("Visualising");
     bassoon::viz::VizVisitor * p_visualiser = new bassoon::viz::VizVisitor("Parse");
     p_visualiser->visualiseAST(program);
     delete p_visualiser;
- 
-    spdlog::info("Typechecking");  
+
+    spdlog::info("Typechecking");
     bassoon::typecheck::TypeVisitor typechecker;
     typechecker.typecheck(program);
 
+    spdlog::info("Evaluating constants");
+    bassoon::ctfe::ConstFolder const_folder(ctfe_steps, ctfe_depth);
+    const_folder.fold(program);
+
     spdlog::info("Visualising");
     bassoon::viz::VizVisitor * tc_visualiser = new bassoon::viz::VizVisitor("Typecheck");
     tc_visualiser->visualiseAST(program);
@@ -34,11 +170,27 @@ int main(int argc, char *argv[]){
 
     spdlog::info("Code Generating");
     bassoon::codegen::CodeGenerator code_generator;
-    code_generator.definePutChar();
+    // The target is set first so functions are generated with its
+    // attributes and the optimiser can use its cost models.
+    code_generator.setTarget(target_cpu, target_features);
+    if(!multiversion_levels.empty()){
+        code_generator.setMultiversionLevels(multiversion_levels);
+    }
+    code_generator.setOptimization(opt_level, pass_pipeline);
+    code_generator.setPrintIR(print_ir);
+    code_generator.setPartitions(partitions);
+    code_generator.setDirectSSA(direct_ssa);
+    code_generator.setNumericMode(numeric_mode);
+    code_generator.setVectorLibrary(vector_library);
+    code_generator.setMemoSize(memo_size);
+    code_generator.setMatchLowering(match_lowering);
+    code_generator.defineBuiltins();
     code_generator.generate(program);
+    if(link_runtime){
+        code_generator.linkRuntime();
+    }
     //code_generator.printIR();
     code_generator.optimize();
-    code_generator.setTarget();
     code_generator.compile();
 
     return 0;
@@ -1,6 +1,10 @@
 #include "ast.hxx"
+#include "builtins.hxx"
 #include "codegen.hxx"
 #include "exceptions.hxx"
+#include "runtime_bitcode.hxx"
+
+#include <functional>
 
 #ifdef _WIN32
 #define DLLEXPORT __declspec(dllexport)
@@ -23,26 +27,107 @@ void CodeGenerator::printIR(){
     module_->print(llvm::errs(), nullptr);
 }
 
-void CodeGenerator::definePutChar(){
-    std::vector<llvm::Type *> arg_types;
-    arg_types.push_back(llvm::Type::getInt32Ty(*context_));
-    llvm::FunctionType * func_type = llvm::FunctionType::get(llvm::Type::getInt32Ty(*context_), arg_types, false); 
-    llvm::Function * func = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, "putchar", module_.get());
+void CodeGenerator::defineBuiltins(){
+    for(Builtin builtin : builtin_functions){
+        std::vector<llvm::Type *> arg_types;
+        for(BType arg_type : builtin.type.getArgumentTypes()){
+            arg_types.push_back(convertBType(arg_type));
+        }
+        llvm::Intrinsic::ID intrinsic = llvm::Function::lookupIntrinsicID(builtin.symbol);
+        if(intrinsic != llvm::Intrinsic::not_intrinsic){
+            builtin_callees_[builtin.name] = llvm::Intrinsic::getDeclaration(module_.get(), intrinsic, {llvm::Type::getDoubleTy(*context_)});
+            continue;
+        }
+        llvm::FunctionType * func_type = llvm::FunctionType::get(convertBType(builtin.type.getReturnType()), arg_types, false); 
+        builtin_callees_[builtin.name] = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, builtin.symbol, module_.get());
+    }
 }
 
 void CodeGenerator::generate(std::shared_ptr<BProgram> program){
     program->accept(this);
 }
 
-void CodeGenerator::optimize(){
+void CodeGenerator::linkRuntime(){
+    if(runtime_bitcode_size == 0){
+        spdlog::info("No runtime bitcode built in, link the program with libbassoon_rt.a");
+        return;
+    }
+    llvm::StringRef bitcode(reinterpret_cast<const char *>(runtime_bitcode), runtime_bitcode_size);
+    llvm::Expected<std::unique_ptr<llvm::Module>> runtime = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, "bassoon_rt"), *context_);
+    if(!runtime){
+        spdlog::error("Can't read the runtime bitcode: {0}", llvm::toString(runtime.takeError()));
+        throw BError();
+    }
+    (*runtime)->setTargetTriple(module_->getTargetTriple());
+    (*runtime)->setDataLayout(module_->getDataLayout());
+    // Tune the runtime for the program's target, the inliner won't inline a
+    // function built for different features into its callers.
+    for(llvm::Function & function : **runtime){
+        function.removeFnAttr("target-cpu");
+        function.removeFnAttr("target-features");
+        function.removeFnAttr("tune-cpu");
+        if(!function.isDeclaration()){
+            addTargetAttributes(&function);
+        }
+    }
+
+    // Only what the program calls is linked, and made internal so it can be
+    // inlined and dropped.
+    bool failed = llvm::Linker::linkModules(*module_, std::move(*runtime), llvm::Linker::LinkOnlyNeeded,
+        [](llvm::Module & module, const llvm::StringSet<> & linked_names){
+            llvm::internalizeModule(module, [&linked_names](const llvm::GlobalValue & global){
+                return !global.hasName() || !linked_names.count(global.getName());
+            });
+        });
+    if(failed){
+        spdlog::error("Can't link the runtime into the program");
+        throw BError();
+    }
+}
+
+void CodeGenerator::setOptimization(OptLevel level, std::string pipeline){
+    opt_level_ = level;
+    pass_pipeline_ = pipeline;
+}
+
+void CodeGenerator::setPartitions(unsigned partitions){
+    if(partitions < 1){
+        spdlog::error("Need at least one partition");
+        throw BError();
+    }
+    partitions_ = partitions;
+}
+
+void CodeGenerator::setMemoSize(unsigned size){
+    if(size < 1){
+        spdlog::error("Memo caches need at least one entry");
+        throw BError();
+    }
+    memo_size_ = size;
+}
+
+llvm::TargetLibraryInfoImpl CodeGenerator::createLibraryInfo(const llvm::Module & module){
+    // What the optimisers know of the C library, plus the vector variants of
+    // maths functions the loop vectoriser may call.
+    llvm::TargetLibraryInfoImpl library_info(llvm::Triple(module.getTargetTriple()));
+    library_info.addVectorizableFunctionsFromVecLib(vector_library_);
+    return library_info;
+}
+
+void CodeGenerator::runPipeline(llvm::Module & module, llvm::TargetMachine * target_machine, PipelineStage stage){
     // Create the analysis managers
     llvm::LoopAnalysisManager loop_analysis;
     llvm::FunctionAnalysisManager function_analysis;
     llvm::CGSCCAnalysisManager CGSCC_analysis;
     llvm::ModuleAnalysisManager module_analysis;
 
-    // Create a new pass manager builder
-    llvm::PassBuilder pass_builder;
+    // Registered first so the default registration doesn't replace it.
+    llvm::TargetLibraryInfoImpl library_info = createLibraryInfo(module);
+    function_analysis.registerPass([&]{return llvm::TargetLibraryAnalysis(library_info);});
+
+    // Create a new pass manager builder, giving it the target machine so the
+    // vectorisers and other cost models see the selected cpu.
+    llvm::PassBuilder pass_builder(target_machine);
 
     // Register the analyses with the managers
     pass_builder.registerModuleAnalyses(module_analysis);
@@ -51,20 +136,87 @@ void CodeGenerator::optimize(){
     pass_builder.registerLoopAnalyses(loop_analysis);
     pass_builder.crossRegisterProxies(loop_analysis, function_analysis, CGSCC_analysis, module_analysis);
 
-    // Create a pass manager
-    // Corresponds to typical -O2 optimization pipeline in clang.
-    llvm::ModulePassManager optimisation_pass_manager = pass_builder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
-    
-    // Do the optimisations
-    spdlog::info("BEFORE OPTIMIZATION ---------------------------");
-    this->printIR();
-    optimisation_pass_manager.run(*module_, module_analysis); 
-    spdlog::info("AFTER OPTIMIZATION ----------------------------");
-    this->printIR();
+    // Create a pass manager, the levels correspond to clang's -O pipelines.
+    llvm::ModulePassManager optimisation_pass_manager;
+    llvm::OptimizationLevel level;
+    switch(opt_level_){
+        case opt_O1: level = llvm::OptimizationLevel::O1; break;
+        case opt_O3: level = llvm::OptimizationLevel::O3; break;
+        case opt_Os: level = llvm::OptimizationLevel::Os; break;
+        case opt_Oz: level = llvm::OptimizationLevel::Oz; break;
+        default: level = llvm::OptimizationLevel::O2; break;
+    }
+
+    if(!pass_pipeline_.empty()){
+        // A custom pipeline can hold module passes, so it only runs on the whole module.
+        if(stage != stage_partition){
+            if(llvm::Error pipeline_error = pass_builder.parsePassPipeline(optimisation_pass_manager, pass_pipeline_)){
+                spdlog::error("Invalid pass pipeline {0}: {1}", pass_pipeline_, llvm::toString(std::move(pipeline_error)));
+                throw BError();
+            }
+            spdlog::info("Optimising with pipeline {0}", pass_pipeline_);
+        }
+    }
+    else if(opt_level_ == opt_O0){
+        if(stage != stage_partition){
+            optimisation_pass_manager = pass_builder.buildO0DefaultPipeline(llvm::OptimizationLevel::O0);
+        }
+    }
+    else if(opt_level_ == opt_jit){
+        // Promoting the allocas codegen makes for every variable and cleaning up
+        // after gets most of the runtime of O2 for a fraction of its compile time.
+        if(stage != stage_prelink){
+            llvm::FunctionPassManager function_pass_manager;
+            function_pass_manager.addPass(llvm::PromotePass());
+            function_pass_manager.addPass(llvm::InstCombinePass());
+            function_pass_manager.addPass(llvm::SimplifyCFGPass());
+            function_pass_manager.addPass(llvm::GVNPass());
+            optimisation_pass_manager.addPass(llvm::createModuleToFunctionPassAdaptor(std::move(function_pass_manager)));
+        }
+    }
+    else{
+        switch(stage){
+            case stage_whole:
+                optimisation_pass_manager = pass_builder.buildPerModuleDefaultPipeline(level);
+                break;
+            case stage_prelink:
+                optimisation_pass_manager = pass_builder.buildModuleSimplificationPipeline(level, llvm::ThinOrFullLTOPhase::None);
+                break;
+            case stage_partition:
+                optimisation_pass_manager = pass_builder.buildModuleOptimizationPipeline(level);
+                break;
+        }
+    }
 
+    optimisation_pass_manager.run(module, module_analysis); 
 }
 
-void CodeGenerator::setTarget(){
+void CodeGenerator::optimize(){
+    if(opt_level_ == opt_Os || opt_level_ == opt_Oz){
+        // The backend and most passes check these attributes rather than the pipeline's level
+        for(llvm::Function & function : *module_){
+            if(function.isDeclaration()){
+                continue;
+            }
+            function.addFnAttr(llvm::Attribute::OptimizeForSize);
+            if(opt_level_ == opt_Oz){
+                function.addFnAttr(llvm::Attribute::MinSize);
+            }
+        }
+    }
+    // Do the optimisations
+    if(print_ir_){
+        spdlog::info("BEFORE OPTIMIZATION ---------------------------");
+        this->printIR();
+    }
+    runPipeline(*module_, target_machine_, partitions_ > 1 ? stage_prelink : stage_whole);
+    if(print_ir_){
+        spdlog::info(partitions_ > 1 ? "AFTER INTERPROCEDURAL OPTIMIZATION ------------" : "AFTER OPTIMIZATION ----------------------------");
+        this->printIR();
+    }
+}
+
+void CodeGenerator::setTarget(std::string cpu, std::string features){
     std::string target_triple = llvm::sys::getDefaultTargetTriple();
     if(target_triple != "x86_64-unknown-linux-gnu"){
         spdlog::info("Initialising all targets");
@@ -86,36 +238,171 @@ void CodeGenerator::setTarget(){
         spdlog::error("{0}", target_lookup_error);
         throw BError();
     }
-    
-    std::string cpu = "generic";
-    std::string features = "";
-    llvm::TargetOptions options;
-    auto relocation_model = llvm::Optional<llvm::Reloc::Model>();
-    target_machine_ = target->createTargetMachine(target_triple, cpu, features, options, relocation_model);
+
+    // "native" takes the host cpu and every feature the host reports.
+    // Explicit features are added after so they can override the host's.
+    llvm::SubtargetFeatures subtarget_features;
+    if(cpu == "native"){
+        cpu = llvm::sys::getHostCPUName().str();
+        llvm::StringMap<bool> host_features;
+        if(llvm::sys::getHostCPUFeatures(host_features)){
+            for(auto & host_feature : host_features){
+                subtarget_features.AddFeature(host_feature.first(), host_feature.second);
+            }
+        }
+        else{
+            spdlog::warn("Could not detect host cpu features, using only those implied by {0}", cpu);
+        }
+    }
+    std::vector<std::string> explicit_features;
+    llvm::SubtargetFeatures::Split(explicit_features, features);
+    for(auto & feature : explicit_features){
+        subtarget_features.AddFeature(feature);
+    }
+    features = subtarget_features.getString();
+
+    // Named microarchitecture levels (x86-64-v2, x86-64-v3, x86-64-v4) are cpu names to llvm.
+    std::unique_ptr<llvm::MCSubtargetInfo> subtarget_info(target->createMCSubtargetInfo(target_triple, "", ""));
+    if(cpu != "generic" && !subtarget_info->isCPUStringValid(cpu)){
+        spdlog::error("{0} is not a recognised cpu for target {1}", cpu, target_triple);
+        throw BError();
+    }
+    spdlog::info("Targeting {0} cpu: {1} features: {2}", target_triple, cpu, features.empty()? "(none)" : features);
+
+    target_triple_ = target_triple;
+    target_cpu_ = cpu;
+    target_features_ = features;
+    target_machine_ = createTargetMachine().release();
     module_->setDataLayout(target_machine_->createDataLayout());
     module_->setTargetTriple(target_triple);
+    module_->setPICLevel(llvm::PICLevel::BigPIC);
+    module_->setPIELevel(llvm::PIELevel::Large);
 }
 
-void CodeGenerator::compile(){
-    std::string object_filename = "output.o";
+std::unique_ptr<llvm::TargetMachine> CodeGenerator::createTargetMachine(){
+    std::string target_lookup_error;
+    auto target = llvm::TargetRegistry::lookupTarget(target_triple_, target_lookup_error);
+    if(!target){
+        spdlog::error("{0}", target_lookup_error);
+        throw BError();
+    }
+    llvm::TargetOptions options;
+    // Position independent, as C compilers default to linking PIEs. Internal
+    // functions called through an ifunc would otherwise need text relocations.
+    auto relocation_model = llvm::Optional<llvm::Reloc::Model>(llvm::Reloc::PIC_);
+    return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(target_triple_, target_cpu_, target_features_, options, relocation_model));
+}
+
+llvm::CodeGenOpt::Level CodeGenerator::codeGenOptLevel(){
+    // Instruction selection and register allocation effort follows the opt level.
+    switch(opt_level_){
+        case opt_O0:
+            return llvm::CodeGenOpt::None;
+        case opt_O1:
+        case opt_jit:
+            return llvm::CodeGenOpt::Less;
+        case opt_O3:
+            return llvm::CodeGenOpt::Aggressive;
+        default:
+            return llvm::CodeGenOpt::Default;
+    }
+}
+
+bool CodeGenerator::emitObject(llvm::Module & module, llvm::TargetMachine * target_machine, std::string object_filename){
     std::error_code EC;
     llvm::raw_fd_ostream destination (object_filename, EC, llvm::sys::fs::OF_None);
     if(EC){
-        llvm::errs() << "Can't open file " << EC.message();
         spdlog::error("Can't open file {0}", EC.message());
-        throw BError();
+        return false;
     }
 
+    target_machine->setOptLevel(codeGenOptLevel());
     llvm::legacy::PassManager code_gen_pass_manager;
+    // vector intrinsics left after optimisation are replaced with the library's functions too
+    llvm::TargetLibraryInfoImpl library_info = createLibraryInfo(module);
+    code_gen_pass_manager.add(new llvm::TargetLibraryInfoWrapperPass(library_info));
     auto file_type = llvm::CGFT_ObjectFile; // code gen file type
 
-    if(target_machine_->addPassesToEmitFile(code_gen_pass_manager, destination, nullptr, file_type)){
-        llvm::errs() << "target machine can't emit a file of this type";
-        return;
+    if(target_machine->addPassesToEmitFile(code_gen_pass_manager, destination, nullptr, file_type)){
+        spdlog::error("target machine can't emit a file of this type");
+        return false;
     }
 
-    code_gen_pass_manager.run(*module_);
+    code_gen_pass_manager.run(module);
     destination.flush();
+    return true;
+}
+
+void CodeGenerator::compilePartitions(){
+    // Each partition is serialised so its thread can read it into a context of its own,
+    // LLVMContexts are not safe to share between threads.
+    std::vector<llvm::SmallVector<char, 0>> partition_bitcode;
+    llvm::SplitModule(*module_, partitions_, [&](std::unique_ptr<llvm::Module> partition){
+        partition_bitcode.emplace_back();
+        llvm::raw_svector_ostream bitcode_stream(partition_bitcode.back());
+        llvm::WriteBitcodeToFile(*partition, bitcode_stream);
+    });
+    spdlog::info("Compiling {0:d} partitions", partition_bitcode.size());
+
+    std::vector<std::string> object_filenames(partition_bitcode.size());
+    std::vector<char> partition_ok(partition_bitcode.size(), false);
+    llvm::ThreadPool thread_pool(llvm::hardware_concurrency(partitions_));
+    for(int i = 0; i < partition_bitcode.size(); ++i){
+        object_filenames[i] = "output." + std::to_string(i) + ".o";
+        thread_pool.async([this, i, &partition_bitcode, &object_filenames, &partition_ok]{
+            llvm::LLVMContext context;
+            llvm::StringRef bitcode(partition_bitcode[i].data(), partition_bitcode[i].size());
+            auto partition = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, object_filenames[i]), context);
+            if(!partition){
+                spdlog::error("partition {0:d}: {1}", i, llvm::toString(partition.takeError()));
+                return;
+            }
+            std::unique_ptr<llvm::TargetMachine> target_machine = createTargetMachine();
+            runPipeline(**partition, target_machine.get(), stage_partition);
+            partition_ok[i] = emitObject(**partition, target_machine.get(), object_filenames[i]);
+        });
+    }
+    thread_pool.wait();
+    for(char ok : partition_ok){
+        if(!ok){
+            throw BError();
+        }
+    }
+
+    // Combine the partitions into one relocatable output.o
+    auto linker = llvm::sys::findProgramByName("ld");
+    if(!linker){
+        spdlog::warn("ld not found, link the partitions output.0.o ... output.{0:d}.o instead of output.o", object_filenames.size() - 1);
+        return;
+    }
+    std::vector<llvm::StringRef> linker_args = {*linker, "-r", "-o", "output.o"};
+    for(auto & object_filename : object_filenames){
+        linker_args.push_back(object_filename);
+    }
+    std::string linker_error;
+    if(llvm::sys::ExecuteAndWait(*linker, linker_args, llvm::None, {}, 0, 0, &linker_error) != 0){
+        spdlog::error("ld -r failed to combine partitions {0}", linker_error);
+        throw BError();
+    }
+    for(auto & object_filename : object_filenames){
+        llvm::sys::fs::remove(object_filename);
+    }
+}
+
+void CodeGenerator::compile(){
+    if(partitions_ > 1 && !module_->ifunc_empty()){
+        // SplitModule clones every ifunc into every partition, without its resolver or
+        // versions, so a module with multiversion functions is finished as a single partition.
+        spdlog::warn("Multiversion functions can't be split, compiling one partition instead of {0:d}", partitions_);
+        runPipeline(*module_, target_machine_, stage_partition);
+    }
+    else if(partitions_ > 1){
+        compilePartitions();
+        return;
+    }
+    if(!emitObject(*module_, target_machine_, "output.o")){
+        throw BError();
+    }
 }
 
 
@@ -123,14 +410,431 @@ void CodeGenerator::compile(){
 // Helpers
 // ----------------------
 
-llvm::AllocaInst * CodeGenerator::createEntryBlockAlloca(llvm::Function *function, llvm::Argument * arg){
-    // Make an IR builder pointing to first instruction of entry block.
-    llvm::IRBuilder<> temp_builder (&function->getEntryBlock(), function->getEntryBlock().begin());
-    return temp_builder.CreateAlloca(arg->getType(),0,arg->getName());
+// ----------------------
+// Variables
+// ----------------------
+
+void CodeGenerator::resetVariables(){
+    named_values_.clear();
+    current_defs_.clear();
+    incomplete_phis_.clear();
+    sealed_blocks_.clear();
+    variable_types_.clear();
+    ssa_variables_.clear();
+}
+
+void CodeGenerator::declareVariable(std::string name, llvm::Type * type){
+    if(ssa_){
+        // names can't contain '.', so a shadowing declaration's variable is distinct from every other
+        std::string variable = variable_types_.count(name)? name + "." + std::to_string(variable_types_.size()) : name;
+        ssa_variables_[name] = variable;
+        variable_types_[variable] = type;
+        return;
+    }
+    // Allocas go in the entry block so loops don't grow the stack, and so mem2reg promotes them.
+    llvm::Function * function = builder_->GetInsertBlock()->getParent();
+    llvm::IRBuilder<> entry_builder(&function->getEntryBlock(), function->getEntryBlock().begin());
+    named_values_[name] = entry_builder.CreateAlloca(type, nullptr, name);
+}
+
+bool CodeGenerator::isLocalVariable(std::string name){
+    if(ssa_){
+        return ssa_variables_.count(name);
+    }
+    auto alloca = named_values_.find(name);
+    return alloca != named_values_.end() && alloca->second;
+}
+
+void CodeGenerator::writeVariable(std::string name, llvm::BasicBlock * block, llvm::Value * value){
+    if(!isLocalVariable(name) && globals_.count(name)){
+        builder_->CreateStore(value, globals_[name]);
+        return;
+    }
+    if(!ssa_){
+        builder_->CreateStore(value, named_values_[name]);
+        return;
+    }
+    writeDefinition(ssa_variables_[name], block, value);
+}
+
+void CodeGenerator::writeDefinition(std::string variable, llvm::BasicBlock * block, llvm::Value * value){
+    current_defs_[block][variable] = value;
+}
+
+llvm::Value * CodeGenerator::readVariable(std::string name, llvm::BasicBlock * block){
+    if(!isLocalVariable(name) && globals_.count(name)){
+        llvm::GlobalVariable * global = globals_[name];
+        if(global->isConstant()){
+            return global->getInitializer();
+        }
+        return builder_->CreateLoad(global->getValueType(), global, name);
+    }
+    if(!ssa_){
+        llvm::AllocaInst * alloca = named_values_[name];
+        return builder_->CreateLoad(alloca->getAllocatedType(), alloca, name);
+    }
+    return readDefinition(ssa_variables_[name], block);
+}
+
+llvm::Value * CodeGenerator::readDefinition(std::string variable, llvm::BasicBlock * block){
+    auto block_defs = current_defs_.find(block);
+    if(block_defs != current_defs_.end()){
+        auto def = block_defs->second.find(variable);
+        if(def != block_defs->second.end() && def->second){
+            return def->second;
+        }
+    }
+    return readVariableRecursive(variable, block);
+}
+
+llvm::Value * CodeGenerator::readVariableRecursive(std::string name, llvm::BasicBlock * block){
+    llvm::Type * type = variable_types_[name];
+    llvm::Value * value;
+    if(!sealed_blocks_.count(block)){
+        // Predecessors still to come, complete the phi when the block is sealed.
+        llvm::PHINode * phi = block->empty()? llvm::PHINode::Create(type, 0, name, block) : llvm::PHINode::Create(type, 0, name, &block->front());
+        incomplete_phis_[block][name] = phi;
+        value = phi;
+    }
+    else if(llvm::BasicBlock * predecessor = block->getSinglePredecessor()){
+        value = readDefinition(name, predecessor);
+    }
+    else if(llvm::pred_empty(block)){
+        // Unreachable, or read before any definition.
+        value = llvm::UndefValue::get(type);
+    }
+    else{
+        // Break cycles by defining the variable as the phi before reading the predecessors.
+        llvm::PHINode * phi = block->empty()? llvm::PHINode::Create(type, 0, name, block) : llvm::PHINode::Create(type, 0, name, &block->front());
+        writeDefinition(name, block, phi);
+        value = addPhiOperands(name, phi);
+    }
+    writeDefinition(name, block, value);
+    return value;
+}
+
+llvm::Value * CodeGenerator::addPhiOperands(std::string name, llvm::PHINode * phi){
+    for(llvm::BasicBlock * predecessor : llvm::predecessors(phi->getParent())){
+        phi->addIncoming(readDefinition(name, predecessor), predecessor);
+    }
+    return tryRemoveTrivialPhi(phi);
+}
+
+llvm::Value * CodeGenerator::tryRemoveTrivialPhi(llvm::PHINode * phi){
+    // A phi is trivial if it merges a single value (and possibly itself).
+    llvm::Value * same = nullptr;
+    for(llvm::Value * operand : phi->incoming_values()){
+        if(operand == same || operand == phi){
+            continue;
+        }
+        if(same){
+            return phi;
+        }
+        same = operand;
+    }
+    if(!same){
+        same = llvm::UndefValue::get(phi->getType());
+    }
+
+    // Replacing this phi may make the phis using it trivial in turn.
+    std::vector<llvm::WeakTrackingVH> phi_users;
+    for(llvm::User * user : phi->users()){
+        if(user != phi && llvm::isa<llvm::PHINode>(user)){
+            phi_users.push_back(user);
+        }
+    }
+    phi->replaceAllUsesWith(same);
+    phi->eraseFromParent();
+    for(auto & phi_user : phi_users){
+        if(phi_user){
+            tryRemoveTrivialPhi(llvm::cast<llvm::PHINode>(phi_user));
+        }
+    }
+    return same;
+}
+
+void CodeGenerator::sealBlock(llvm::BasicBlock * block){
+    if(!ssa_){
+        return;
+    }
+    for(auto & incomplete_phi : incomplete_phis_[block]){
+        addPhiOperands(incomplete_phi.first, incomplete_phi.second);
+    }
+    incomplete_phis_.erase(block);
+    sealed_blocks_.insert(block);
+}
+
+void CodeGenerator::addTargetAttributes(llvm::Function * function){
+    // Records the target selection in the module, this is what the optimiser's
+    // cost models and the backend read when tuning each function.
+    function->addFnAttr("target-cpu", target_cpu_);
+    if(!target_features_.empty()){
+        function->addFnAttr("target-features", target_features_);
+    }
+}
+
+void CodeGenerator::applyNumericMode(NumericMode mode, llvm::Function * function){
+    // The builder stamps its fast-math flags on every floating point op it creates.
+    llvm::FastMathFlags fast_math_flags;
+    switch(mode){
+        case num_strict:
+            break;
+        case num_contract:
+            fast_math_flags.setAllowContract();
+            break;
+        case num_fast:
+            fast_math_flags.setFast();
+            // Lets the backend make the same assumptions as the flags on each op.
+            function->addFnAttr("unsafe-fp-math", "true");
+            function->addFnAttr("no-nans-fp-math", "true");
+            function->addFnAttr("no-infs-fp-math", "true");
+            function->addFnAttr("no-signed-zeros-fp-math", "true");
+            function->addFnAttr("approx-func-fp-math", "true");
+            break;
+    }
+    builder_->setFastMathFlags(fast_math_flags);
+    no_signed_wrap_ = mode == num_fast;
+}
+
+// ----------------------
+// Multiversioning
+// ----------------------
+
+// An ISA level a multiversion function is cloned for. The clone is tuned for the
+// module's cpu plus features, and chosen at load time when every bit in
+// cpu_model_bits is set in libgcc/compiler-rt's __cpu_model.__cpu_features[0].
+struct IsaLevel{
+    std::string name;
+    std::string features;
+    std::vector<unsigned> cpu_model_bits;
+};
+
+// Bit positions follow the processor_features enum shared by libgcc and compiler-rt.
+enum CpuModelBit : unsigned {
+    cpu_model_avx2 = 10,
+    cpu_model_fma = 14,
+    cpu_model_avx512f = 15,
+    cpu_model_bmi = 16,
+    cpu_model_bmi2 = 17,
+    cpu_model_avx512vl = 20,
+    cpu_model_avx512bw = 21,
+    cpu_model_avx512dq = 22,
+    cpu_model_avx512cd = 23,
+};
+
+// Ordered lowest to highest, the resolver picks the highest the cpu supports.
+static const std::vector<IsaLevel> isa_levels = {
+    {"baseline", "", {}},
+    {"avx2", "+avx2,+fma,+bmi,+bmi2", {cpu_model_avx2, cpu_model_fma, cpu_model_bmi, cpu_model_bmi2}},
+    {"avx512", "+avx2,+fma,+bmi,+bmi2,+avx512f,+avx512vl,+avx512bw,+avx512dq,+avx512cd",
+        {cpu_model_avx2, cpu_model_fma, cpu_model_bmi, cpu_model_bmi2,
+         cpu_model_avx512f, cpu_model_avx512vl, cpu_model_avx512bw, cpu_model_avx512dq, cpu_model_avx512cd}},
+};
+
+void CodeGenerator::setMultiversionLevels(std::vector<std::string> levels){
+    for(auto & level : levels){
+        bool known = false;
+        for(auto & isa_level : isa_levels){
+            known = known || isa_level.name == level;
+        }
+        if(!known){
+            spdlog::error("Unknown multiversion level {0}", level);
+            throw BError();
+        }
+    }
+    multiversion_levels_ = levels;
+}
+
+void CodeGenerator::multiversionFunction(llvm::Function * function){
+    std::string name = function->getName().str();
+    if(!llvm::Triple(module_->getTargetTriple()).isX86()){
+        spdlog::warn("multiversion is only supported on x86, {0} gets a single body", name);
+        return;
+    }
+
+    // Calls through the ifunc use the C convention, so the versions and any
+    // calls made so far must too. A change of convention breaks musttail.
+    function->setCallingConv(llvm::CallingConv::C);
+    for(llvm::User * user : function->users()){
+        if(llvm::CallInst * call = llvm::dyn_cast<llvm::CallInst>(user)){
+            call->setCallingConv(llvm::CallingConv::C);
+            if(call->isMustTailCall()){
+                call->setTailCallKind(llvm::CallInst::TCK_Tail);
+            }
+        }
+    }
+    for(llvm::BasicBlock & block : *function){
+        for(llvm::Instruction & inst : block){
+            llvm::CallInst * call = llvm::dyn_cast<llvm::CallInst>(&inst);
+            if(call && call->isMustTailCall()){
+                call->setTailCallKind(llvm::CallInst::TCK_Tail);
+            }
+        }
+    }
+
+    // One clone per selected level, the baseline is always kept as the fallback.
+    llvm::FunctionType * func_type = function->getFunctionType();
+    std::vector<std::pair<const IsaLevel *, llvm::Function *>> versions;
+    for(auto & level : isa_levels){
+        bool selected = level.name == "baseline";
+        for(auto & level_name : multiversion_levels_){
+            selected = selected || level_name == level.name;
+        }
+        if(!selected){
+            continue;
+        }
+
+        llvm::Function * version = llvm::Function::Create(func_type, llvm::Function::InternalLinkage, name + "." + level.name, module_.get());
+        llvm::ValueToValueMapTy value_map;
+        auto version_arg = version->arg_begin();
+        for(auto & arg : function->args()){
+            version_arg->setName(arg.getName());
+            value_map[&arg] = &*version_arg++;
+        }
+        // Recursive calls stay within the same version.
+        value_map[function] = version;
+        llvm::SmallVector<llvm::ReturnInst *, 4> returns;
+        llvm::CloneFunctionInto(version, function, value_map, llvm::CloneFunctionChangeType::LocalChangesOnly, returns);
+
+        llvm::SubtargetFeatures version_features(target_features_);
+        std::vector<std::string> level_features;
+        llvm::SubtargetFeatures::Split(level_features, level.features);
+        for(auto & feature : level_features){
+            version_features.AddFeature(feature);
+        }
+        version->addFnAttr("target-cpu", target_cpu_);
+        if(!version_features.getString().empty()){
+            version->addFnAttr("target-features", version_features.getString());
+        }
+        versions.push_back({&level, version});
+    }
+
+    // The resolver runs at load time and returns the highest supported version.
+    llvm::Type * int32_type = llvm::Type::getInt32Ty(*context_);
+    llvm::FunctionType * resolver_type = llvm::FunctionType::get(func_type->getPointerTo(), false);
+    llvm::Function * resolver = llvm::Function::Create(resolver_type, llvm::Function::InternalLinkage, name + ".resolver", module_.get());
+    llvm::IRBuilder<> resolver_builder(llvm::BasicBlock::Create(*context_, "entry", resolver));
+
+    llvm::FunctionCallee cpu_indicator_init = module_->getOrInsertFunction("__cpu_indicator_init", llvm::Type::getVoidTy(*context_));
+    resolver_builder.CreateCall(cpu_indicator_init);
+    llvm::StructType * cpu_model_type = llvm::StructType::get(*context_, {int32_type, int32_type, int32_type, llvm::ArrayType::get(int32_type, 1)});
+    llvm::Constant * cpu_model = module_->getOrInsertGlobal("__cpu_model", cpu_model_type);
+    llvm::Value * features_ptr = resolver_builder.CreateConstInBoundsGEP2_32(cpu_model_type, cpu_model, 0, 3);
+    llvm::Value * features = resolver_builder.CreateLoad(int32_type, resolver_builder.CreateConstInBoundsGEP2_32(llvm::ArrayType::get(int32_type, 1), features_ptr, 0, 0), "cpu_features");
+
+    llvm::Value * chosen = versions[0].second;
+    for(int i = 1; i < versions.size(); ++i){
+        unsigned mask = 0;
+        for(unsigned bit : versions[i].first->cpu_model_bits){
+            mask |= 1u << bit;
+        }
+        llvm::Value * required = llvm::ConstantInt::get(int32_type, mask);
+        llvm::Value * supported = resolver_builder.CreateICmpEQ(resolver_builder.CreateAnd(features, required), required, versions[i].first->name + "_supported");
+        chosen = resolver_builder.CreateSelect(supported, versions[i].second, chosen);
+    }
+    resolver_builder.CreateRet(chosen);
+
+    // Callers see a single symbol: an ifunc bound to the resolver's choice.
+    llvm::GlobalIFunc * ifunc = llvm::GlobalIFunc::create(func_type, 0, function->getLinkage(), "", resolver, module_.get());
+    function->deleteBody();
+    function->replaceAllUsesWith(ifunc);
+    function->eraseFromParent();
+    ifunc->setName(name);
+    spdlog::debug("Multiversioned {0} into {1:d} versions", name, versions.size());
+}
+
+llvm::FunctionCallee CodeGenerator::getCallee(std::string name){
+    auto builtin = builtin_callees_.find(name);
+    if(builtin != builtin_callees_.end()){
+        return builtin->second;
+    }
+    if(llvm::Function * function = module_->getFunction(name)){
+        return function;
+    }
+    if(llvm::GlobalIFunc * ifunc = module_->getNamedIFunc(name)){
+        return llvm::FunctionCallee(llvm::cast<llvm::FunctionType>(ifunc->getValueType()), ifunc);
+    }
+    return llvm::FunctionCallee();
+}
+
+llvm::Function * CodeGenerator::getRuntimeFunction(std::string symbol, llvm::Type * ret_type, std::vector<llvm::Type *> arg_types){
+    if(llvm::Function * function = module_->getFunction(symbol)){
+        return function;
+    }
+    llvm::FunctionType * func_type = llvm::FunctionType::get(ret_type, arg_types, false);
+    return llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, symbol, module_.get());
+}
+
+llvm::StructType * CodeGenerator::namedStruct(const std::string & name, std::vector<llvm::Type *> members){
+    if(llvm::StructType * existing = llvm::StructType::getTypeByName(*context_, name)){
+        return existing;
+    }
+    return llvm::StructType::create(*context_, members, name);
+}
+
+llvm::StructType * CodeGenerator::aosoaBlockType(BType record_type, int records_per_block){
+    const Record & record = recordOf(record_type);
+    std::vector<llvm::Type *> members;
+    for(int field : record.storage_order){
+        members.push_back(llvm::ArrayType::get(convertBType(record.fields[field].second), records_per_block));
+    }
+    return namedStruct(record.name + ".aosoa" + std::to_string(records_per_block), members);
+}
+
+llvm::Value * CodeGenerator::arrayLength(llvm::Value * array){
+    // the last member, after the element pointer or soa field pointers
+    return builder_->CreateExtractValue(array, array->getType()->getStructNumElements() - 1, "length");
 }
 
 llvm::Type * CodeGenerator::convertBType(BType btype){
     // Handle function types?
+    if(isArrayType(btype)){
+        BType element = elementType(btype);
+        llvm::Type * length_type = llvm::Type::getInt32Ty(*context_);
+        if(isBitsType(btype)){
+            // named, as an array of longs has the same members
+            llvm::StructType * bits_type = namedStruct("bits", {convertBType(type_bit)->getPointerTo(), length_type});
+            array_types_[bits_type] = btype;
+            return bits_type;
+        }
+        if(isStridedType(btype)){
+            llvm::StructType * slice_type = llvm::StructType::get(*context_, {convertBType(element)->getPointerTo(), length_type, length_type});
+            array_types_[slice_type] = btype;
+            return slice_type;
+        }
+        if(!isRecordType(element)){
+            return llvm::StructType::get(*context_, {convertBType(element)->getPointerTo(), length_type});
+        }
+        int layout = arrayLayout(btype);
+        llvm::StructType * array_type;
+        if(layout == type_soa){
+            const Record & record = recordOf(element);
+            std::vector<llvm::Type *> members;
+            for(int field : record.storage_order){
+                members.push_back(convertBType(record.fields[field].second)->getPointerTo());
+            }
+            members.push_back(length_type);
+            array_type = namedStruct(record.name + ".soa", members);
+        }
+        else{
+            llvm::Type * unit = layout? aosoaBlockType(element, aosoaBlockSize(layout)) : convertBType(element);
+            array_type = llvm::StructType::get(*context_, {unit->getPointerTo(), length_type});
+        }
+        array_types_[array_type] = btype;
+        return array_type;
+    }
+    if(isRecordType(btype)){
+        const Record & record = recordOf(btype);
+        std::vector<llvm::Type *> members;
+        for(int field : record.storage_order){
+            members.push_back(convertBType(record.fields[field].second));
+        }
+        return namedStruct(record.name, members);
+    }
+    if(isVectorType(btype)){
+        // any width, the backend splits or widens it to the target's registers
+        return llvm::FixedVectorType::get(convertBType(laneType(btype)), laneCount(btype));
+    }
     switch(btype){
     case(type_void):{
         return llvm::Type::getVoidTy(*context_);
@@ -138,12 +842,28 @@ llvm::Type * CodeGenerator::convertBType(BType btype){
     case(type_bool):{
         return llvm::Type::getInt1Ty(*context_);
     }
-    case(type_int):{
+    case(type_int):
+    case(type_uint):{
+        // the instructions on them are signed or unsigned, not the values
         return llvm::Type::getInt32Ty(*context_);
     }
     case(type_double):{
         return llvm::Type::getDoubleTy(*context_);
     }
+    case(type_long):
+    case(type_ulong):
+    case(type_bit):{
+        // flags are stored in words of 64
+        return llvm::Type::getInt64Ty(*context_);
+    }
+    case(type_float):{
+        return llvm::Type::getFloatTy(*context_);
+    }
+    case(type_complex):{
+        // a first class aggregate, kept in registers and passed and returned as two doubles
+        llvm::Type * part = llvm::Type::getDoubleTy(*context_);
+        return llvm::StructType::get(*context_, {part, part});
+    }
     default:{
         spdlog::error("{0} is not a convertible type", typeToStr(btype));
         throw BError();
@@ -153,6 +873,10 @@ llvm::Type * CodeGenerator::convertBType(BType btype){
 
 
 BType CodeGenerator::convertLlvmType(llvm::Type * type){
+    auto array = array_types_.find(type);
+    if(array != array_types_.end()){
+        return array->second;
+    }
     if(type==convertBType(type_bool)){
         return type_bool;
     }
@@ -160,6 +884,16 @@ BType CodeGenerator::convertLlvmType(llvm::Type * type){
         return type_int;
     }else if(type==convertBType(type_double)){
         return type_double;
+    }else if(type==convertBType(type_long)){
+        return type_long;
+    }else if(type==convertBType(type_float)){
+        return type_float;
+    }else if(auto vector_type = llvm::dyn_cast<llvm::FixedVectorType>(type)){
+        return vectorOf(convertLlvmType(vector_type->getElementType()), vector_type->getNumElements());
+    }else if(type==convertBType(type_complex)){
+        return type_complex;
+    }else if(type->isStructTy() && type->getStructNumElements() == 2 && type->getStructElementType(0)->isPointerTy()){
+        return arrayOf(convertLlvmType(type->getStructElementType(0)->getPointerElementType()));
     }
     spdlog::error("Unknown llvm type to convert to BType");
     throw BError();
@@ -206,48 +940,48 @@ void CodeGenerator::pushLlvmProto(llvm::Function * proto){
 //  Casting
 // -----------------------
 
-llvm::Value * CodeGenerator::createCast(llvm::Value * val, BType dest_type){
-    if (dest_type == type_double){
-        return tryIntToDoubleCast(val);
-    }
-    else if(dest_type == type_int){
-        return tryDoubleToIntCast(val);
-    }
-    spdlog::error("not a castable type");
-    throw BError();
-}
-
-llvm::Value * CodeGenerator::createIntToDoubleCast(llvm::Value * int_val){
-    spdlog::debug("Casting int to double");
-    return builder_->CreateSIToFP(int_val, convertBType(type_double),"int_to_double_cast");
-}
-llvm::Value * CodeGenerator::createDoubleToIntCast(llvm::Value * double_val){
-    spdlog::debug("Casting double to int");
-    return builder_->CreateFPToSI(double_val, convertBType(type_int), "double_to_int_cast");
-}
-
-llvm::Value * CodeGenerator::tryIntToDoubleCast(llvm::Value * maybe_int_val){
-    if(maybe_int_val->getType()->isIntegerTy()){
-        spdlog::debug("int cast required");
-        return this->createIntToDoubleCast(maybe_int_val);
+llvm::Value * CodeGenerator::createCast(llvm::Value * val, BType src_type, BType dest_type){
+    llvm::Type * src = val->getType();
+    llvm::Type * dest = convertBType(dest_type);
+    if(src == dest){
+        return val;
+    }
+    if(isStridedType(dest_type)){
+        // an array or slice of consecutive elements, one apart
+        llvm::Value * slice = llvm::UndefValue::get(dest);
+        slice = builder_->CreateInsertValue(slice, builder_->CreateExtractValue(val, 0), 0);
+        slice = builder_->CreateInsertValue(slice, builder_->getInt32(1), 1);
+        return builder_->CreateInsertValue(slice, arrayLength(val), 2);
+    }
+    if(dest->isVectorTy() && !src->isVectorTy()){
+        // a scalar operand with a vector, already of the lane type
+        return builder_->CreateVectorSplat(laneCount(dest_type), val, "splat");
+    }
+    // bools are i1 but never cast, so integers here are ints, extended by the signedness
+    // of the type they're converted from
+    bool src_unsigned = isUnsignedType(laneType(src_type));
+    if(src->isIntegerTy() && dest->isIntegerTy()){
+        if(src_unsigned){
+            return builder_->CreateZExtOrTrunc(val, dest, "int_resize_cast");
+        }
+        return builder_->CreateSExtOrTrunc(val, dest, "int_resize_cast");
     }
-    else if(maybe_int_val->getType()->isFloatingPointTy()){
-        spdlog::debug("No int cast required");
-        return maybe_int_val;
+    if(src->isFloatingPointTy() && dest->isFloatingPointTy()){
+        return builder_->CreateFPCast(val, dest, "float_resize_cast");
     }
-    spdlog::error("Unexpected type given to tryIntToDoubleCast. Float? {0} Int? {1}", maybe_int_val->getType()->isFloatingPointTy(), maybe_int_val->getType()->isIntegerTy());
-    throw BError();
-}
-llvm::Value * CodeGenerator::tryDoubleToIntCast(llvm::Value * maybe_double_val){
-    if(maybe_double_val->getType()->isFloatingPointTy()){
-        spdlog::debug("double cast required");
-        return this->createDoubleToIntCast(maybe_double_val);
+    if(src->isIntegerTy() && dest->isFloatingPointTy()){
+        if(src_unsigned){
+            return builder_->CreateUIToFP(val, dest, "int_to_float_cast");
+        }
+        return builder_->CreateSIToFP(val, dest, "int_to_float_cast");
     }
-    else if(maybe_double_val->getType()->isIntegerTy()){
-        spdlog::debug("No double cast required");
-        return maybe_double_val;
+    if(src->isFloatingPointTy() && dest->isIntegerTy()){
+        if(isUnsignedType(laneType(dest_type))){
+            return builder_->CreateFPToUI(val, dest, "float_to_int_cast");
+        }
+        return builder_->CreateFPToSI(val, dest, "float_to_int_cast");
     }
-    spdlog::error("Unexpected type given to tryDoubleToIntCast");
+    spdlog::error("not a castable type");
     throw BError();
 }
 
@@ -256,10 +990,17 @@ llvm::Value * CodeGenerator::tryDoubleToIntCast(llvm::Value * maybe_double_val){
 //------------------------
 
 llvm::Value * CodeGenerator::createAdd(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val){
-    switch(res_type){
-    case(type_int):{
-        return builder_->CreateAdd(lhs_val,rhs_val,"int_bin_add_temp");
+    // vectors are element-wise
+    switch(laneType(res_type)){
+    case(type_int):
+    case(type_long):{
+        return builder_->CreateAdd(lhs_val,rhs_val,"int_bin_add_temp",false,no_signed_wrap_);
+    }
+    case(type_uint):
+    case(type_ulong):{
+        return builder_->CreateAdd(lhs_val,rhs_val,"uint_bin_add_temp");
     }
+    case(type_float):
     case(type_double):{
         return builder_->CreateFAdd(lhs_val,rhs_val,"double_bin_add_temp");
     }
@@ -271,10 +1012,17 @@ llvm::Value * CodeGenerator::createAdd(BType res_type, llvm::Value * lhs_val, ll
 }
 
 llvm::Value * CodeGenerator::createSub(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val){
-    switch(res_type){
-    case(type_int):{
-        return builder_->CreateSub(lhs_val,rhs_val,"int_bin_sub_temp");
+    // vectors are element-wise
+    switch(laneType(res_type)){
+    case(type_int):
+    case(type_long):{
+        return builder_->CreateSub(lhs_val,rhs_val,"int_bin_sub_temp",false,no_signed_wrap_);
     }
+    case(type_uint):
+    case(type_ulong):{
+        return builder_->CreateSub(lhs_val,rhs_val,"uint_bin_sub_temp");
+    }
+    case(type_float):
     case(type_double):{
         return builder_->CreateFSub(lhs_val,rhs_val,"double_bin_sub_temp");
     }
@@ -286,10 +1034,17 @@ llvm::Value * CodeGenerator::createSub(BType res_type, llvm::Value * lhs_val, ll
 }
 
 llvm::Value * CodeGenerator::createMul(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val){
-    switch(res_type){
-    case(type_int):{
-        return builder_->CreateMul(lhs_val,rhs_val,"int_bin_mul_temp");
+    // vectors are element-wise
+    switch(laneType(res_type)){
+    case(type_int):
+    case(type_long):{
+        return builder_->CreateMul(lhs_val,rhs_val,"int_bin_mul_temp",false,no_signed_wrap_);
     }
+    case(type_uint):
+    case(type_ulong):{
+        return builder_->CreateMul(lhs_val,rhs_val,"uint_bin_mul_temp");
+    }
+    case(type_float):
     case(type_double):{
         return builder_->CreateFMul(lhs_val,rhs_val,"double_bin_mul_temp");
     }
@@ -301,10 +1056,17 @@ llvm::Value * CodeGenerator::createMul(BType res_type, llvm::Value * lhs_val, ll
 }
 
 llvm::Value * CodeGenerator::createDiv(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val){
-    switch(res_type){
-    case(type_int):{
+    // vectors are element-wise
+    switch(laneType(res_type)){
+    case(type_int):
+    case(type_long):{
         return builder_->CreateSDiv(lhs_val,rhs_val,"int_bin_div_temp");
     }
+    case(type_uint):
+    case(type_ulong):{
+        return builder_->CreateUDiv(lhs_val,rhs_val,"uint_bin_div_temp");
+    }
+    case(type_float):
     case(type_double):{
         return builder_->CreateFDiv(lhs_val,rhs_val,"double_bin_div_temp");
     }
@@ -315,37 +1077,99 @@ llvm::Value * CodeGenerator::createDiv(BType res_type, llvm::Value * lhs_val, ll
     }
 }
 
-llvm::Value * CodeGenerator::createLessThan(BType lhs_type, BType rhs_type, llvm::Value * lhs_val, llvm::Value * rhs_val){
-    if(lhs_type == rhs_type && lhs_type == type_int){
-        return builder_->CreateICmpSLT(lhs_val, rhs_val, "int_cmp_lt");
+llvm::Value * CodeGenerator::createRem(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val){
+    // vectors are element-wise, the remainder has the sign of the lhs as C's does
+    if(isUnsignedType(laneType(res_type))){
+        return builder_->CreateURem(lhs_val, rhs_val, "uint_bin_rem_temp");
     }
-    else if(lhs_type == rhs_type && lhs_type == type_double){
-        return builder_->CreateFCmpOLT(lhs_val,rhs_val,"double_cmp_lt");
+    return builder_->CreateSRem(lhs_val, rhs_val, "int_bin_rem_temp");
+}
+
+llvm::Value * CodeGenerator::createShift(char op_code, BType res_type, llvm::Value * lhs_val, BType amount_type, llvm::Value * amount_val){
+    // the amount as the shifted type, modulo its width so it's never poison
+    BType lane_type = laneType(res_type);
+    if(!isVectorType(amount_type)){
+        amount_val = createCast(amount_val, amount_type, lane_type);
+        if(isVectorType(res_type)){
+            amount_val = builder_->CreateVectorSplat(laneCount(res_type), amount_val, "splat");
+        }
     }
-    else{
-        return builder_->CreateFCmpOLT(tryIntToDoubleCast(lhs_val),tryIntToDoubleCast(rhs_val),"double_cmp_lt");
+    amount_val = builder_->CreateAnd(amount_val, llvm::ConstantInt::get(lhs_val->getType(), typeBytes(lane_type) * 8 - 1), "shift_amount");
+    if(op_code == 'l'){
+        return builder_->CreateShl(lhs_val, amount_val, "shl_temp");
     }
+    if(isUnsignedType(lane_type)){
+        return builder_->CreateLShr(lhs_val, amount_val, "lshr_temp");
+    }
+    return builder_->CreateAShr(lhs_val, amount_val, "ashr_temp");
 }
 
-llvm::Value * CodeGenerator::createGreaterThan(BType lhs_type, BType rhs_type, llvm::Value * lhs_val, llvm::Value * rhs_val){
-    spdlog::debug("Making >, types: l: {0} r: {1}", typeToStr(lhs_type), typeToStr(rhs_type));
-    if(lhs_type == rhs_type && lhs_type == type_int){
-        return builder_->CreateICmpSGT(lhs_val, rhs_val, "int_cmp_gt");
-    }
-    else if(lhs_type == rhs_type && lhs_type == type_double){
-        return builder_->CreateFCmpOGT(lhs_val,rhs_val,"double_cmp_gt");
+llvm::Value * CodeGenerator::createRotate(CallExprAST * call_node){
+    // a funnel shift of the int with itself, which takes the amount modulo the width
+    BType type = call_node->getType();
+    call_node->argAcceptAt(this, 0);
+    llvm::Value * val = popLlvmValue();
+    call_node->argAcceptAt(this, 1);
+    llvm::Value * amount = createCast(popLlvmValue(), call_node->getArg(1).getType(), type);
+    llvm::Intrinsic::ID id = call_node->getName() == rotate_left_builtin? llvm::Intrinsic::fshl : llvm::Intrinsic::fshr;
+    llvm::Function * funnel_shift = llvm::Intrinsic::getDeclaration(module_.get(), id, {val->getType()});
+    return builder_->CreateCall(funnel_shift, {val, val, amount}, "rotate");
+}
+
+llvm::Value * CodeGenerator::createLessThan(BType operand_type, llvm::Value * lhs_val, llvm::Value * rhs_val){
+    if(isFloatingType(laneType(operand_type))){
+        return builder_->CreateFCmpOLT(lhs_val,rhs_val,"float_cmp_lt");
     }
-    else{
-        return builder_->CreateFCmpOGT(tryIntToDoubleCast(lhs_val),tryIntToDoubleCast(rhs_val),"double_cmp_gt");
+    if(isUnsignedType(laneType(operand_type))){
+        return builder_->CreateICmpULT(lhs_val, rhs_val, "uint_cmp_lt");
     }
+    return builder_->CreateICmpSLT(lhs_val, rhs_val, "int_cmp_lt");
 }
 
-llvm::Value * CodeGenerator::createAnd(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val){
-    return builder_->CreateAnd(lhs_val, rhs_val);
+llvm::Value * CodeGenerator::createGreaterThan(BType operand_type, llvm::Value * lhs_val, llvm::Value * rhs_val){
+    spdlog::debug("Making >, operand type: {0}", typeToStr(operand_type));
+    if(isFloatingType(laneType(operand_type))){
+        return builder_->CreateFCmpOGT(lhs_val,rhs_val,"float_cmp_gt");
+    }
+    if(isUnsignedType(laneType(operand_type))){
+        return builder_->CreateICmpUGT(lhs_val, rhs_val, "uint_cmp_gt");
+    }
+    return builder_->CreateICmpSGT(lhs_val, rhs_val, "int_cmp_gt");
 }
 
-llvm::Value * CodeGenerator::createOr(BType res_type, llvm::Value * lhs_val, llvm::Value * rhs_val){
-    return builder_->CreateOr(lhs_val, rhs_val);
+llvm::Value * CodeGenerator::createShortCircuit(BinaryExprAST * binary_node){
+    bool is_and = binary_node->getOpCode() == '&';
+    llvm::Function * parent_function = builder_->GetInsertBlock()->getParent();
+
+    binary_node->lhsAccept(this);
+    llvm::Value * lhs_val = popLlvmValue();
+    // the lhs may itself have branched, so the phi's edge is from wherever it finished
+    llvm::BasicBlock * lhs_block = builder_->GetInsertBlock();
+    llvm::BasicBlock * rhs_block = llvm::BasicBlock::Create(*context_, is_and ? "and_rhs" : "or_rhs", parent_function);
+    llvm::BasicBlock * merge_block = llvm::BasicBlock::Create(*context_, is_and ? "and_continue" : "or_continue");
+
+    // false and ... is false, true or ... is true: skip the rhs
+    if(is_and){
+        builder_->CreateCondBr(lhs_val, rhs_block, merge_block);
+    }
+    else{
+        builder_->CreateCondBr(lhs_val, merge_block, rhs_block);
+    }
+    sealBlock(rhs_block);
+
+    builder_->SetInsertPoint(rhs_block);
+    binary_node->rhsAccept(this);
+    llvm::Value * rhs_val = popLlvmValue();
+    llvm::BasicBlock * rhs_end_block = builder_->GetInsertBlock();
+    builder_->CreateBr(merge_block);
+
+    parent_function->getBasicBlockList().push_back(merge_block);
+    sealBlock(merge_block);
+    builder_->SetInsertPoint(merge_block);
+    llvm::PHINode * phi = builder_->CreatePHI(llvm::Type::getInt1Ty(*context_), 2, is_and ? "and_temp" : "or_temp");
+    phi->addIncoming(builder_->getInt1(!is_and), lhs_block);
+    phi->addIncoming(rhs_val, rhs_end_block);
+    return phi;
 }
 
 //--------------------
@@ -367,28 +1191,64 @@ void CodeGenerator::doubleExprAction(DoubleExprAST * double_node){
     pushLlvmValue(double_const);
 }
 
-void CodeGenerator::variableExprAction(VariableExprAST * variable_node){
-    std::string name = variable_node->getName();
-    std::string loc_str = variable_node->getLocStr();
-    spdlog::debug("gening variable {0} expression at {1}",name, variable_node->getLocStr());
-    llvm::Type * llvm_type = convertBType(variable_node->getType());
-    llvm::Value *var_val = named_values_[variable_node->getName()];
-    if(!var_val){
-        spdlog::error("Variable name unknown {0} at {1}",name, loc_str);
+void CodeGenerator::longExprAction(LongExprAST * long_node){
+    llvm::Value * long_const = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context_),long_node->getValue(),true);
+    pushLlvmValue(long_const);
+}
+
+void CodeGenerator::floatExprAction(FloatExprAST * float_node){
+    llvm::Value * float_const = llvm::ConstantFP::get(*context_,llvm::APFloat(float_node->getValue()));
+    pushLlvmValue(float_const);
+}
+
+void CodeGenerator::unsignedExprAction(UnsignedExprAST * unsigned_node){
+    llvm::Value * unsigned_const = llvm::ConstantInt::get(convertBType(unsigned_node->getType()),unsigned_node->getValue(),false);
+    pushLlvmValue(unsigned_const);
+}
+
+llvm::Constant * CodeGenerator::createConstant(BValue value){
+    switch(value.type){
+    case(type_bool):{
+        return llvm::ConstantInt::get(llvm::Type::getInt1Ty(*context_),value.bool_value,false);
+    }
+    case(type_int):{
+        return llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context_),value.int_value,true);
+    }
+    case(type_double):{
+        return llvm::ConstantFP::get(*context_,llvm::APFloat(value.double_value));
+    }
+    case(type_long):{
+        return llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context_),value.long_value,true);
+    }
+    case(type_float):{
+        return llvm::ConstantFP::get(*context_,llvm::APFloat(value.float_value));
+    }
+    case(type_uint):{
+        return llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context_),value.uint_value,false);
+    }
+    case(type_ulong):{
+        return llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context_),value.ulong_value,false);
+    }
+    default:{
+        spdlog::error("No constant of type {0}", typeToStr(value.type));
         throw BError();
     }
-    // Seg Fault HERE when for loop step uses variable
-    llvm::Value * load_val = builder_->CreateLoad(llvm_type, var_val, name);
-    pushLlvmValue(load_val);
+    }
 }
 
-void CodeGenerator::callExprAction(CallExprAST * call_node){
-    llvm::Function * callee_func = module_->getFunction(call_node->getName());
-    if(!callee_func){
-        spdlog::error("Unknown function called");
+void CodeGenerator::variableExprAction(VariableExprAST * variable_node){
+    std::string name = variable_node->getName();
+    std::string loc_str = variable_node->getLocStr();
+    spdlog::debug("gening variable {0} expression at {1}",name, variable_node->getLocStr());
+    if(!isLocalVariable(name) && !globals_.count(name)){
+        spdlog::error("Variable name unknown {0} at {1}",name, loc_str);
         throw BError();
     }
+    llvm::Value * load_val = readVariable(name, builder_->GetInsertBlock());
+    pushLlvmValue(load_val);
+}
 
+std::vector<llvm::Value *> CodeGenerator::createCallArgs(CallExprAST * call_node){
     // codegen the args and pop them off into args vec
     std::vector<BType> callee_arg_types = call_node->getCalleeType().getArgumentTypes();
     std::vector<llvm::Value *> args_vec;
@@ -396,13 +1256,13 @@ void CodeGenerator::callExprAction(CallExprAST * call_node){
     for(int i = 0; call_node->anotherArg(); i++){
         call_node->argAcceptOne(this);
         llvm::Value * arg_val = popLlvmValue();
-        BType arg_type = convertLlvmType(arg_val->getType());
+        BType arg_type = call_node->getArg(i).getType();
         BType expected_type = callee_arg_types[i];
         if(arg_type != expected_type){
             spdlog::debug("arg type not a match {0} expected: {1}", typeToStr(arg_type), typeToStr(expected_type));
             if(isCastable(arg_type,expected_type)){
                 spdlog::debug("creating cast");
-                arg_val = createCast(arg_val,expected_type);
+                arg_val = createCast(arg_val,arg_type,expected_type);
             }
             else{
                 throw BError();
@@ -410,19 +1270,71 @@ void CodeGenerator::callExprAction(CallExprAST * call_node){
         }
         args_vec.push_back(arg_val);
     }
+    return args_vec;
+}
+
+void CodeGenerator::callExprAction(CallExprAST * call_node){
+    if(call_node->isFolded()){
+        // evaluated at compile time
+        pushLlvmValue(createConstant(call_node->getFoldedValue()));
+        return;
+    }
+    if(call_node->getName() == array_length_builtin){
+        call_node->argAcceptAt(this, 0);
+        pushLlvmValue(arrayLength(popLlvmValue()));
+        return;
+    }
+    if(isVectorBuiltin(call_node->getName(), call_node->countArgs())){
+        pushLlvmValue(createVectorBuiltin(call_node));
+        return;
+    }
+    if(isComplexBuiltin(call_node->getName())){
+        pushLlvmValue(createComplexBuiltin(call_node));
+        return;
+    }
+    if(isBitsBuiltin(call_node->getName())){
+        pushLlvmValue(createBitsBuiltin(call_node));
+        return;
+    }
+    if(isRotateBuiltin(call_node->getName())){
+        pushLlvmValue(createRotate(call_node));
+        return;
+    }
+    llvm::FunctionCallee callee_func = getCallee(call_node->getName());
+    if(!callee_func){
+        spdlog::error("Unknown function called");
+        throw BError();
+    }
 
-    if(callee_func->arg_size() != args_vec.size()){
+    // slices are passed as their members
+    std::vector<BType> arg_types = call_node->getCalleeType().getArgumentTypes();
+    std::vector<llvm::Value *> call_args = createCallArgs(call_node);
+    std::vector<llvm::Value *> args_vec;
+    for(unsigned i = 0; i < call_args.size(); ++i){
+        if(!isSliceType(arg_types[i])){
+            args_vec.push_back(call_args[i]);
+            continue;
+        }
+        for(unsigned member = 0; member < call_args[i]->getType()->getStructNumElements(); ++member){
+            args_vec.push_back(builder_->CreateExtractValue(call_args[i], member));
+        }
+    }
+    if(callee_func.getFunctionType()->getNumParams() != args_vec.size()){
         spdlog::error("mismatch arg size");
         throw BError();
     }
 
-    llvm::Value * ret_val;
-    if (callee_func->getReturnType()->isVoidTy()){
+    llvm::CallInst * ret_val;
+    if (callee_func.getFunctionType()->getReturnType()->isVoidTy()){
         ret_val = builder_->CreateCall(callee_func,args_vec);
     }
     else{
         ret_val = builder_->CreateCall(callee_func,args_vec,"calltmp");
     }
+    // The call must use the callee's convention, ifuncs are always called with C's.
+    if(llvm::Function * callee_function = llvm::dyn_cast<llvm::Function>(callee_func.getCallee())){
+        ret_val->setCallingConv(callee_function->getCallingConv());
+    }
     pushLlvmValue(ret_val);
 }
 
@@ -435,11 +1347,16 @@ void CodeGenerator::unaryExprAction(UnaryExprAST * unary_node){
     llvm::Value * unary_val;
     switch(op_code){
     case('-'):{
-        if (unary_node->getType() == type_double){
+        if(unary_node->getType() == type_complex){
+            unary_val = createComplex(
+                builder_->CreateFNeg(builder_->CreateExtractValue(operand_val, 0), "re_neg"),
+                builder_->CreateFNeg(builder_->CreateExtractValue(operand_val, 1), "im_neg"));
+        }
+        else if (isFloatingType(laneType(unary_node->getType()))){
             unary_val = builder_->CreateFNeg(operand_val,"unary_fneg_temp");
         }
         else{
-            unary_val = builder_->CreateNeg(operand_val,"unary_neg_temp");
+            unary_val = builder_->CreateNeg(operand_val,"unary_neg_temp",false,no_signed_wrap_);
         }
         break;
     }
@@ -447,6 +1364,10 @@ void CodeGenerator::unaryExprAction(UnaryExprAST * unary_node){
         unary_val = builder_->CreateNot(operand_val,"unary_not_temp");
         break;
     }
+    case('~'):{
+        unary_val = builder_->CreateNot(operand_val,"unary_complement_temp");
+        break;
+    }
     default:{
         spdlog::error("Unknown unary operator {0}",op_code);
         throw BError(); 
@@ -461,25 +1382,35 @@ void CodeGenerator::binaryExprAction(BinaryExprAST * binary_node){
     BType lhs_type = binary_node->getLHS().getType();
     BType rhs_type = binary_node->getRHS().getType();
 
+    if((op_code == '&' || op_code == '|') && res_type == type_bool){
+        pushLlvmValue(createShortCircuit(binary_node));
+        return;
+    }
+
     binary_node->lhsAccept(this);
     llvm::Value * lhs_val = popLlvmValue();
     binary_node->rhsAccept(this);
     llvm::Value * rhs_val = popLlvmValue();
 
     spdlog::debug("doing a binop at {0}", binary_node->getLocStr());
+    if(res_type == type_complex){
+        pushLlvmValue(createComplexArithmetic(op_code, lhs_type, lhs_val, rhs_type, rhs_val));
+        return;
+    }
 
-    // Can replace this with more advanced function with lookup for
-    // which types to use if more types or operators added.
-    spdlog::debug("Checking if casts for binop needed");
-    if(res_type == type_int){
-        spdlog::debug("try doubles to ints");
-        lhs_val = tryDoubleToIntCast(lhs_val);
-        rhs_val = tryDoubleToIntCast(rhs_val);
+    // a shift's amount can be any int
+    if(op_code == 'l' || op_code == 'r'){
+        pushLlvmValue(createShift(op_code, res_type, lhs_val, rhs_type, rhs_val));
+        return;
     }
-    else if(res_type == type_double){
-        spdlog::debug("try int to doubbles");
-        lhs_val = tryIntToDoubleCast(lhs_val);
-        rhs_val = tryIntToDoubleCast(rhs_val);
+
+    // mixed numeric operands are both converted to their promoted type, which
+    // is also the result type of arithmetic
+    BType operand_type = promotedType(lhs_type, rhs_type);
+    if(isNumericType(laneType(operand_type))){
+        spdlog::debug("casting binop operands to {0}", typeToStr(operand_type));
+        lhs_val = createCast(lhs_val, lhs_type, operand_type);
+        rhs_val = createCast(rhs_val, rhs_type, operand_type);
     }
     else{
         spdlog::debug("Bool binary");
@@ -503,20 +1434,33 @@ void CodeGenerator::binaryExprAction(BinaryExprAST * binary_node){
         binary_val = createDiv(res_type, lhs_val, rhs_val);
         break;
     }
+    case('%'):{
+        binary_val = createRem(res_type, lhs_val, rhs_val);
+        break;
+    }
     case('<'):{
-        binary_val = createLessThan(lhs_type, rhs_type, lhs_val, rhs_val);
+        binary_val = createLessThan(operand_type, lhs_val, rhs_val);
         break;
     }
     case('>'):{
-        binary_val = createGreaterThan(lhs_type, rhs_type, lhs_val, rhs_val);
+        binary_val = createGreaterThan(operand_type, lhs_val, rhs_val);
         break;
     }
+    // masks, element-wise and evaluating both sides, and the bits of ints
     case('&'):{
-        binary_val = createAnd(res_type, lhs_val, rhs_val);
+        binary_val = builder_->CreateAnd(lhs_val, rhs_val, "and_temp");
         break;
     }
     case('|'):{
-        binary_val = createOr(res_type, lhs_val, rhs_val);
+        binary_val = builder_->CreateOr(lhs_val, rhs_val, "or_temp");
+        break;
+    }
+    case('^'):{
+        binary_val = builder_->CreateXor(lhs_val, rhs_val, "xor_temp");
+        break;
+    }
+    case('~'):{
+        binary_val = builder_->CreateNot(builder_->CreateOr(lhs_val, rhs_val), "nor_temp");
         break;
     }
     default:{
@@ -528,6 +1472,612 @@ void CodeGenerator::binaryExprAction(BinaryExprAST * binary_node){
     pushLlvmValue(binary_val);
 }
 
+//--------------------
+// Arrays
+//--------------------
+
+void CodeGenerator::arrayExprAction(ArrayExprAST * array_node){
+    array_node->lengthAccept(this);
+    llvm::Value * length = popLlvmValue();
+    BType array_type = array_node->getType();
+    BType element = array_node->getElementType();
+    int layout = isRecordType(element)? arrayLayout(array_type) : 0;
+
+    // the buffer holds units of elements: an element, an aosoa block of them, or for
+    // soa the bytes of one of each field
+    llvm::Type * unit_type = convertBType(element);
+    llvm::Value * units = length;
+    if(layout == type_soa){
+        uint64_t record_bytes = 0;
+        for(auto & field : recordOf(element).fields){
+            record_bytes += module_->getDataLayout().getTypeStoreSize(convertBType(field.second));
+        }
+        unit_type = llvm::ArrayType::get(builder_->getInt8Ty(), record_bytes);
+    }
+    else if(layout){
+        // whole blocks, a negative length is left for the runtime to fail on
+        int block_size = aosoaBlockSize(layout);
+        unit_type = aosoaBlockType(element, block_size);
+        llvm::Value * blocks = builder_->CreateAShr(builder_->CreateAdd(length, builder_->getInt32(block_size - 1)),
+            llvm::Log2_32(block_size), "blocks");
+        units = builder_->CreateSelect(builder_->CreateICmpSLT(length, builder_->getInt32(0)), length, blocks);
+    }
+    else if(element == type_bit){
+        // whole words of flags, likewise
+        llvm::Value * words = builder_->CreateAShr(builder_->CreateAdd(length, builder_->getInt32(63)), 6, "words");
+        units = builder_->CreateSelect(builder_->CreateICmpSLT(length, builder_->getInt32(0)), length, words);
+    }
+    uint64_t unit_size = module_->getDataLayout().getTypeAllocSize(unit_type);
+
+    llvm::Value * buffer;
+    llvm::ConstantInt * fixed_units = llvm::dyn_cast<llvm::ConstantInt>(units);
+    if(fixed_units && !fixed_units->isNegative() && fixed_units->getZExtValue() * unit_size <= stack_array_bytes){
+        // In the entry block so loops reuse the space, zeroed where the array is made
+        uint64_t count = fixed_units->getZExtValue();
+        llvm::Function * function = builder_->GetInsertBlock()->getParent();
+        llvm::IRBuilder<> entry_builder(&function->getEntryBlock(), function->getEntryBlock().begin());
+        llvm::AllocaInst * frame_buffer = entry_builder.CreateAlloca(llvm::ArrayType::get(unit_type, count), nullptr, "array");
+        frame_buffer->setAlignment(llvm::Align(array_alignment));
+        builder_->CreateMemSet(frame_buffer, builder_->getInt8(0), count * unit_size, llvm::MaybeAlign(array_alignment));
+        buffer = frame_buffer;
+    }
+    else{
+        // zeroed by the runtime, which fails on a negative length
+        llvm::Function * alloc = getRuntimeFunction("bsn_array_alloc", builder_->getInt8PtrTy(), {builder_->getInt32Ty(), builder_->getInt64Ty()});
+        llvm::CallInst * heap_buffer = builder_->CreateCall(alloc, {units, builder_->getInt64(unit_size)}, "array");
+        heap_buffer->addRetAttr(llvm::Attribute::NoAlias);
+        heap_buffer->addRetAttr(llvm::Attribute::getWithAlignment(*context_, llvm::Align(array_alignment)));
+        // top level arrays last as long as the program
+        if(!array_scopes_.empty()){
+            array_scopes_.back().push_back(heap_buffer);
+        }
+        buffer = heap_buffer;
+    }
+    arrays_declared_ = true;
+
+    llvm::Value * array = llvm::UndefValue::get(convertBType(array_type));
+    if(layout == type_soa){
+        // each field's array after the larger fields', so it's aligned to its size
+        const Record & record = recordOf(element);
+        llvm::Value * bytes = builder_->CreatePointerCast(buffer, builder_->getInt8PtrTy(), "bytes");
+        llvm::Value * wide_length = builder_->CreateZExt(length, builder_->getInt64Ty());
+        uint64_t offset_bytes = 0;
+        for(unsigned i = 0; i < record.storage_order.size(); ++i){
+            llvm::Type * field_type = convertBType(record.fields[record.storage_order[i]].second);
+            llvm::Value * offset = builder_->CreateMul(wide_length, builder_->getInt64(offset_bytes), "field_offset", true, true);
+            llvm::Value * field = builder_->CreateInBoundsGEP(builder_->getInt8Ty(), bytes, offset);
+            array = builder_->CreateInsertValue(array, builder_->CreatePointerCast(field, field_type->getPointerTo(), "field"), i);
+            offset_bytes += module_->getDataLayout().getTypeStoreSize(field_type);
+        }
+    }
+    else{
+        array = builder_->CreateInsertValue(array, builder_->CreatePointerCast(buffer, unit_type->getPointerTo(), "elements"), 0);
+    }
+    array = builder_->CreateInsertValue(array, length, array->getType()->getStructNumElements() - 1);
+    pushLlvmValue(array);
+}
+
+// a lookup table: its elements are a private constant, in read-only data, and the const
+// array viewing them is a constant too, so indexing it is one load from the table
+void CodeGenerator::arrayLiteralExprAction(ArrayLiteralExprAST * literal_node){
+    const std::vector<BValue> & values = literal_node->getFoldedElements();
+    if(values.size() != (size_t) literal_node->countElements()){
+        spdlog::error("Array literal at {0} was not evaluated at compile time", literal_node->getLocStr());
+        throw BError();
+    }
+    BType array_type = literal_node->getType();
+    std::vector<llvm::Constant *> elements;
+    for(const BValue & value : values){
+        elements.push_back(createConstant(value));
+    }
+    llvm::ArrayType * table_type = llvm::ArrayType::get(convertBType(elementType(array_type)), elements.size());
+    auto * table = new llvm::GlobalVariable(*module_, table_type, true, llvm::GlobalValue::PrivateLinkage,
+        llvm::ConstantArray::get(table_type, elements), "table");
+    table->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    table->setAlignment(llvm::Align(array_alignment));
+    llvm::Constant * zero = builder_->getInt32(0);
+    llvm::Constant * first = llvm::ConstantExpr::getInBoundsGetElementPtr(table_type, table, llvm::ArrayRef<llvm::Constant *>{zero, zero});
+    pushLlvmValue(llvm::ConstantStruct::get(llvm::cast<llvm::StructType>(convertBType(array_type)),
+        {first, builder_->getInt32(elements.size())}));
+}
+
+void CodeGenerator::createBoundsCheck(llvm::Value * index, llvm::Value * length){
+    // one unsigned compare also catches negative indices
+    llvm::Value * in_bounds = builder_->CreateICmpULT(index, length, "in_bounds");
+    createRuntimeCheck(in_bounds, "bsn_index_error", {index, length});
+}
+
+void CodeGenerator::createRuntimeCheck(llvm::Value * in_bounds, const std::string & error, std::vector<llvm::Value *> args){
+    llvm::Function * function = builder_->GetInsertBlock()->getParent();
+    llvm::BasicBlock * fail_block = llvm::BasicBlock::Create(*context_, "index_error", function);
+    llvm::BasicBlock * ok_block = llvm::BasicBlock::Create(*context_, "index_ok", function);
+    builder_->CreateCondBr(in_bounds, ok_block, fail_block, llvm::MDBuilder(*context_).createBranchWeights(1 << 20, 1));
+    sealBlock(fail_block);
+    sealBlock(ok_block);
+
+    builder_->SetInsertPoint(fail_block);
+    std::vector<llvm::Type *> arg_types(args.size(), builder_->getInt32Ty());
+    llvm::CallInst * error_call = builder_->CreateCall(getRuntimeFunction(error, builder_->getVoidTy(), arg_types), args);
+    error_call->setDoesNotReturn();
+    error_call->addFnAttr(llvm::Attribute::Cold);
+    builder_->CreateUnreachable();
+    builder_->SetInsertPoint(ok_block);
+}
+
+llvm::Value * CodeGenerator::createElementPointer(IndexExprAST * index_node){
+    llvm::Value * array = readVariable(index_node->getArrayName(), builder_->GetInsertBlock());
+    index_node->indexAccept(this);
+    llvm::Value * index = popLlvmValue();
+
+    if(index_node->isChecked()){
+        createBoundsCheck(index, arrayLength(array));
+    }
+    // the index is in [0, length) here, so zero extending it is the same as sign extending
+    llvm::Value * offset = builder_->CreateZExt(index, builder_->getInt64Ty(), "offset");
+    BType array_type = convertLlvmType(array->getType());
+    BType element = elementType(array_type);
+    if(isStridedType(array_type)){
+        // the stride is positive, so the offset is in the array the slice views
+        llvm::Value * stride = builder_->CreateZExt(builder_->CreateExtractValue(array, 1, "stride"), builder_->getInt64Ty());
+        offset = builder_->CreateMul(offset, stride, "strided_offset", true, true);
+    }
+    if(!isRecordType(element)){
+        llvm::Value * elements = builder_->CreateExtractValue(array, 0, "elements");
+        return builder_->CreateInBoundsGEP(convertBType(index_node->getType()), elements, offset, "element");
+    }
+
+    const Record & record = recordOf(element);
+    unsigned field = record.storageIndex(record.fieldIndex(index_node->getField()));
+    int layout = arrayLayout(array_type);
+    if(layout == type_soa){
+        // contiguous: the field's own array
+        llvm::Value * field_elements = builder_->CreateExtractValue(array, field, index_node->getField());
+        return builder_->CreateInBoundsGEP(convertBType(index_node->getType()), field_elements, offset, "element");
+    }
+    llvm::Value * elements = builder_->CreateExtractValue(array, 0, "elements");
+    if(layout){
+        // the field's array in the element's block
+        int block_size = aosoaBlockSize(layout);
+        llvm::Value * block = builder_->CreateLShr(offset, llvm::Log2_32(block_size), "block");
+        llvm::Value * in_block = builder_->CreateAnd(offset, block_size - 1, "in_block");
+        return builder_->CreateInBoundsGEP(aosoaBlockType(element, block_size), elements,
+            {block, builder_->getInt32(field), in_block}, "element");
+    }
+    // strided: the field of the element's record
+    return builder_->CreateInBoundsGEP(convertBType(element), elements, {offset, builder_->getInt32(field)}, "element");
+}
+
+llvm::Value * CodeGenerator::createFlagPointer(IndexExprAST * index_node, llvm::Value *& mask){
+    llvm::Value * bits = readVariable(index_node->getArrayName(), builder_->GetInsertBlock());
+    index_node->indexAccept(this);
+    llvm::Value * index = popLlvmValue();
+
+    if(index_node->isChecked()){
+        createBoundsCheck(index, arrayLength(bits));
+    }
+    llvm::Value * offset = builder_->CreateZExt(index, builder_->getInt64Ty(), "offset");
+    mask = builder_->CreateShl(builder_->getInt64(1), builder_->CreateAnd(offset, 63), "mask");
+    llvm::Value * words = builder_->CreateExtractValue(bits, 0, "words");
+    return builder_->CreateInBoundsGEP(builder_->getInt64Ty(), words, builder_->CreateLShr(offset, 6), "word");
+}
+
+void CodeGenerator::indexExprAction(IndexExprAST * index_node){
+    if(index_node->isLane()){
+        index_node->indexAccept(this);
+        llvm::Value * index = popLlvmValue();
+        llvm::Value * vector = readVariable(index_node->getArrayName(), builder_->GetInsertBlock());
+        if(index_node->isChecked()){
+            createBoundsCheck(index, builder_->getInt32(llvm::cast<llvm::FixedVectorType>(vector->getType())->getNumElements()));
+        }
+        pushLlvmValue(builder_->CreateExtractElement(vector, index, index_node->getArrayName()));
+        return;
+    }
+    if(isBitsType(convertLlvmType(readVariable(index_node->getArrayName(), builder_->GetInsertBlock())->getType()))){
+        llvm::Value * mask;
+        llvm::Value * word = createFlagPointer(index_node, mask);
+        llvm::Value * flag = builder_->CreateAnd(builder_->CreateLoad(builder_->getInt64Ty(), word, "word"), mask);
+        pushLlvmValue(builder_->CreateICmpNE(flag, builder_->getInt64(0), index_node->getArrayName()));
+        return;
+    }
+    llvm::Value * element = createElementPointer(index_node);
+    pushLlvmValue(builder_->CreateLoad(convertBType(index_node->getType()), element, index_node->getArrayName()));
+}
+
+void CodeGenerator::sliceExprAction(SliceExprAST * slice_node){
+    llvm::Value * array = readVariable(slice_node->getArrayName(), builder_->GetInsertBlock());
+    llvm::Value * length = arrayLength(array);
+    llvm::Value * start = builder_->getInt32(0);
+    if(slice_node->hasStart()){
+        slice_node->startAccept(this);
+        start = popLlvmValue();
+    }
+    llvm::Value * end = length;
+    if(slice_node->hasEnd()){
+        slice_node->endAccept(this);
+        end = popLlvmValue();
+    }
+    llvm::Value * stride = builder_->getInt32(1);
+    if(slice_node->hasStride()){
+        slice_node->strideAccept(this);
+        stride = popLlvmValue();
+    }
+    // 0 <= start <= end <= length, unsigned compares catch negative bounds
+    llvm::Value * in_bounds = builder_->CreateAnd(builder_->CreateICmpULE(start, end), builder_->CreateICmpULE(end, length));
+    in_bounds = builder_->CreateAnd(in_bounds, builder_->CreateICmpSGT(stride, builder_->getInt32(0)), "in_bounds");
+    createRuntimeCheck(in_bounds, "bsn_slice_error", {start, end, stride, length});
+
+    // the elements from start, every stride-th of those the array or slice views
+    BType array_type = convertLlvmType(array->getType());
+    llvm::Value * array_stride = isStridedType(array_type)? builder_->CreateExtractValue(array, 1, "stride") : builder_->getInt32(1);
+    llvm::Value * offset = builder_->CreateMul(builder_->CreateZExt(start, builder_->getInt64Ty()),
+        builder_->CreateZExt(array_stride, builder_->getInt64Ty()), "offset", true, true);
+    llvm::Value * elements = builder_->CreateInBoundsGEP(convertBType(elementType(array_type)),
+        builder_->CreateExtractValue(array, 0), offset, "elements");
+    llvm::Value * count = builder_->CreateZExt(builder_->CreateSub(end, start), builder_->getInt64Ty());
+    llvm::Value * wide_stride = builder_->CreateZExt(stride, builder_->getInt64Ty());
+    count = builder_->CreateUDiv(builder_->CreateAdd(count, builder_->CreateSub(wide_stride, builder_->getInt64(1))), wide_stride);
+
+    BType slice_type = slice_node->getType();
+    llvm::Value * slice = builder_->CreateInsertValue(llvm::UndefValue::get(convertBType(slice_type)), elements, 0);
+    if(isStridedType(slice_type)){
+        slice = builder_->CreateInsertValue(slice, builder_->CreateMul(array_stride, stride, "stride"), 1);
+    }
+    slice = builder_->CreateInsertValue(slice, builder_->CreateTrunc(count, builder_->getInt32Ty()), slice->getType()->getStructNumElements() - 1);
+    pushLlvmValue(slice);
+}
+
+void CodeGenerator::freeArrays(unsigned from_scope){
+    llvm::Function * array_free = getRuntimeFunction("bsn_array_free", builder_->getVoidTy(), {builder_->getInt8PtrTy()});
+    for(unsigned scope = from_scope; scope < array_scopes_.size(); ++scope){
+        for(llvm::Value * buffer : array_scopes_[scope]){
+            builder_->CreateCall(array_free, {buffer});
+        }
+    }
+}
+
+//--------------------
+// Bits
+//--------------------
+
+void CodeGenerator::createBitsAssignment(AssignStatementAST * assign_node){
+    llvm::Value * bits = readVariable(assign_node->getIdentifier(), builder_->GetInsertBlock());
+    llvm::Value * length = arrayLength(bits);
+    // the words of each bits operand, which has as many flags as the assigned bits
+    std::map<std::string, llvm::Value *> operand_words;
+    std::function<void(const ExprAST &)> readOperands = [&](const ExprAST & operation){
+        if(auto variable = dynamic_cast<const VariableExprAST *>(&operation)){
+            if(operand_words.count(variable->getName())){
+                return;
+            }
+            llvm::Value * operand = readVariable(variable->getName(), builder_->GetInsertBlock());
+            llvm::Value * operand_length = arrayLength(operand);
+            createRuntimeCheck(builder_->CreateICmpEQ(operand_length, length), "bsn_bits_error", {length, operand_length});
+            operand_words[variable->getName()] = builder_->CreateExtractValue(operand, 0, variable->getName());
+        }
+        else if(auto binary = dynamic_cast<const BinaryExprAST *>(&operation)){
+            readOperands(binary->getLHS());
+            readOperands(binary->getRHS());
+        }
+        else if(auto unary = dynamic_cast<const UnaryExprAST *>(&operation)){
+            readOperands(unary->getOperand());
+        }
+    };
+    readOperands(assign_node->getValue());
+
+    llvm::Function * function = builder_->GetInsertBlock()->getParent();
+    llvm::BasicBlock * entry_block = builder_->GetInsertBlock();
+    llvm::BasicBlock * loop_block = llvm::BasicBlock::Create(*context_, "bits_loop", function);
+    llvm::BasicBlock * end_block = llvm::BasicBlock::Create(*context_, "bits_end");
+    llvm::Value * words = builder_->CreateExtractValue(bits, 0, "words");
+    llvm::Value * count = builder_->CreateLShr(builder_->CreateAdd(builder_->CreateZExt(length, builder_->getInt64Ty()),
+        builder_->getInt64(63)), 6, "word_count");
+    builder_->CreateCondBr(builder_->CreateICmpEQ(count, builder_->getInt64(0)), end_block, loop_block);
+
+    // word by word, which the loop vectoriser widens to whole registers of them
+    builder_->SetInsertPoint(loop_block);
+    llvm::PHINode * word_index = builder_->CreatePHI(builder_->getInt64Ty(), 2, "word_index");
+    word_index->addIncoming(builder_->getInt64(0), entry_block);
+    bool sets_tail = false;
+    llvm::Value * word = createBitsWord(assign_node->getValue(), operand_words, word_index, sets_tail);
+    builder_->CreateStore(word, builder_->CreateInBoundsGEP(builder_->getInt64Ty(), words, word_index));
+    llvm::Value * next_index = builder_->CreateAdd(word_index, builder_->getInt64(1), "next_word", true, true);
+    word_index->addIncoming(next_index, loop_block);
+    llvm::BasicBlock * exit_block = end_block;
+    if(sets_tail){
+        // not and nor set the flags past the length, which stay clear
+        exit_block = llvm::BasicBlock::Create(*context_, "bits_tail", function);
+    }
+    builder_->CreateCondBr(builder_->CreateICmpEQ(next_index, count), exit_block, loop_block);
+    sealBlock(loop_block);
+    if(sets_tail){
+        sealBlock(exit_block);
+        builder_->SetInsertPoint(exit_block);
+        llvm::Value * last = builder_->CreateInBoundsGEP(builder_->getInt64Ty(), words, builder_->CreateSub(count, builder_->getInt64(1)));
+        llvm::Value * unused = builder_->CreateAnd(builder_->CreateNeg(builder_->CreateZExt(length, builder_->getInt64Ty())), 63);
+        llvm::Value * mask = builder_->CreateLShr(builder_->getInt64(-1), unused, "tail_mask");
+        builder_->CreateStore(builder_->CreateAnd(builder_->CreateLoad(builder_->getInt64Ty(), last), mask), last);
+        builder_->CreateBr(end_block);
+    }
+    sealBlock(end_block);
+    function->getBasicBlockList().push_back(end_block);
+    builder_->SetInsertPoint(end_block);
+}
+
+llvm::Value * CodeGenerator::createBitsWord(const ExprAST & operation, std::map<std::string, llvm::Value *> & operand_words,
+        llvm::Value * word_index, bool & sets_tail){
+    if(auto variable = dynamic_cast<const VariableExprAST *>(&operation)){
+        llvm::Value * word = builder_->CreateInBoundsGEP(builder_->getInt64Ty(), operand_words[variable->getName()], word_index);
+        return builder_->CreateLoad(builder_->getInt64Ty(), word, variable->getName());
+    }
+    if(auto unary = dynamic_cast<const UnaryExprAST *>(&operation)){
+        sets_tail = true;
+        return builder_->CreateNot(createBitsWord(unary->getOperand(), operand_words, word_index, sets_tail), "not_word");
+    }
+    auto binary = dynamic_cast<const BinaryExprAST *>(&operation);
+    if(!binary){
+        spdlog::error("Bits at {0} must be a bits variable or an operation on them", operation.getLocStr());
+        throw BError();
+    }
+    llvm::Value * lhs = createBitsWord(binary->getLHS(), operand_words, word_index, sets_tail);
+    llvm::Value * rhs = createBitsWord(binary->getRHS(), operand_words, word_index, sets_tail);
+    switch(binary->getOpCode()){
+    case('&'): return builder_->CreateAnd(lhs, rhs, "and_word");
+    case('|'): return builder_->CreateOr(lhs, rhs, "or_word");
+    case('^'): return builder_->CreateXor(lhs, rhs, "xor_word");
+    case('~'):{
+        sets_tail = true;
+        return builder_->CreateNot(builder_->CreateOr(lhs, rhs), "nor_word");
+    }
+    default:{
+        spdlog::error("Unknown operator {0} on bits", binary->getOpCode());
+        throw BError();
+    }
+    }
+}
+
+llvm::Value * CodeGenerator::createBitsBuiltin(CallExprAST * call_node){
+    call_node->argAcceptAt(this, 0);
+    llvm::Value * bits = popLlvmValue();
+    std::vector<llvm::Value *> args = {builder_->CreateExtractValue(bits, 0, "words"), arrayLength(bits)};
+    if(call_node->getName() == bits_next_builtin){
+        call_node->argAcceptAt(this, 1);
+        args.push_back(popLlvmValue());
+    }
+    else if(call_node->getName() == bits_first_builtin){
+        args.push_back(builder_->getInt32(0));
+    }
+    std::string builtin = call_node->getName() == bits_count_builtin? bits_count_builtin : bits_next_builtin;
+    return builder_->CreateCall(getBitsFunction(builtin), args, call_node->getName());
+}
+
+llvm::Function * CodeGenerator::getBitsFunction(const std::string & builtin){
+    std::string name = "bsn.bits." + builtin;
+    if(llvm::Function * function = module_->getFunction(name)){
+        return function;
+    }
+    bool count_flags = builtin == bits_count_builtin;
+    llvm::Type * int32_type = llvm::Type::getInt32Ty(*context_);
+    llvm::Type * word_type = llvm::Type::getInt64Ty(*context_);
+    std::vector<llvm::Type *> arg_types = {word_type->getPointerTo(), int32_type};
+    if(!count_flags){
+        arg_types.push_back(int32_type);
+    }
+    llvm::Function * function = llvm::Function::Create(llvm::FunctionType::get(int32_type, arg_types, false),
+        llvm::Function::InternalLinkage, name, module_.get());
+    // small enough to always inline, so the caller's loops see through them
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    function->addFnAttr(llvm::Attribute::NoUnwind);
+    function->addFnAttr(llvm::Attribute::ArgMemOnly);
+    function->addFnAttr(llvm::Attribute::ReadOnly);
+    function->addParamAttr(0, llvm::Attribute::NoCapture);
+    addTargetAttributes(function);
+    llvm::Value * words = function->getArg(0);
+    llvm::Value * length = function->getArg(1);
+    words->setName("words");
+    length->setName("length");
+
+    llvm::BasicBlock * entry_block = llvm::BasicBlock::Create(*context_, "entry", function);
+    llvm::IRBuilder<> bits_builder(entry_block);
+    llvm::Value * count = bits_builder.CreateLShr(bits_builder.CreateAdd(bits_builder.CreateZExt(length, word_type),
+        bits_builder.getInt64(63)), 6, "word_count");
+    if(count_flags){
+        // the sum of each word's llvm.ctpop, a reduction the loop vectoriser widens
+        llvm::BasicBlock * loop_block = llvm::BasicBlock::Create(*context_, "loop", function);
+        llvm::BasicBlock * end_block = llvm::BasicBlock::Create(*context_, "end", function);
+        bits_builder.CreateCondBr(bits_builder.CreateICmpEQ(count, bits_builder.getInt64(0)), end_block, loop_block);
+        bits_builder.SetInsertPoint(loop_block);
+        llvm::PHINode * word_index = bits_builder.CreatePHI(word_type, 2, "word_index");
+        llvm::PHINode * total = bits_builder.CreatePHI(word_type, 2, "total");
+        llvm::Value * word = bits_builder.CreateLoad(word_type, bits_builder.CreateInBoundsGEP(word_type, words, word_index), "word");
+        llvm::Value * sum = bits_builder.CreateAdd(total, bits_builder.CreateUnaryIntrinsic(llvm::Intrinsic::ctpop, word), "sum", true, true);
+        llvm::Value * next_index = bits_builder.CreateAdd(word_index, bits_builder.getInt64(1), "next_word", true, true);
+        word_index->addIncoming(bits_builder.getInt64(0), entry_block);
+        word_index->addIncoming(next_index, loop_block);
+        total->addIncoming(bits_builder.getInt64(0), entry_block);
+        total->addIncoming(sum, loop_block);
+        bits_builder.CreateCondBr(bits_builder.CreateICmpEQ(next_index, count), end_block, loop_block);
+        bits_builder.SetInsertPoint(end_block);
+        llvm::PHINode * result = bits_builder.CreatePHI(word_type, 2, "result");
+        result->addIncoming(bits_builder.getInt64(0), entry_block);
+        result->addIncoming(sum, loop_block);
+        bits_builder.CreateRet(bits_builder.CreateTrunc(result, int32_type));
+        return function;
+    }
+
+    // the first set flag from a word masked below the start, then llvm.cttz of the
+    // first word that isn't zero; the flags past the length are clear
+    llvm::Value * from = function->getArg(2);
+    from->setName("from");
+    llvm::BasicBlock * search_block = llvm::BasicBlock::Create(*context_, "search", function);
+    llvm::BasicBlock * test_block = llvm::BasicBlock::Create(*context_, "test", function);
+    llvm::BasicBlock * advance_block = llvm::BasicBlock::Create(*context_, "advance", function);
+    llvm::BasicBlock * load_block = llvm::BasicBlock::Create(*context_, "load", function);
+    llvm::BasicBlock * found_block = llvm::BasicBlock::Create(*context_, "found", function);
+    llvm::BasicBlock * none_block = llvm::BasicBlock::Create(*context_, "none", function);
+    llvm::Value * start = bits_builder.CreateSelect(bits_builder.CreateICmpSLT(from, bits_builder.getInt32(0)), bits_builder.getInt32(0), from, "start");
+    bits_builder.CreateCondBr(bits_builder.CreateICmpSLT(start, length), search_block, none_block);
+
+    bits_builder.SetInsertPoint(search_block);
+    llvm::Value * offset = bits_builder.CreateZExt(start, word_type, "offset");
+    llvm::Value * first_index = bits_builder.CreateLShr(offset, 6, "first_index");
+    llvm::Value * first_word = bits_builder.CreateLoad(word_type, bits_builder.CreateInBoundsGEP(word_type, words, first_index));
+    first_word = bits_builder.CreateAnd(first_word, bits_builder.CreateShl(bits_builder.getInt64(-1), bits_builder.CreateAnd(offset, 63)), "first_word");
+    bits_builder.CreateBr(test_block);
+
+    bits_builder.SetInsertPoint(test_block);
+    llvm::PHINode * word_index = bits_builder.CreatePHI(word_type, 2, "word_index");
+    llvm::PHINode * word = bits_builder.CreatePHI(word_type, 2, "word");
+    bits_builder.CreateCondBr(bits_builder.CreateICmpNE(word, bits_builder.getInt64(0)), found_block, advance_block);
+
+    bits_builder.SetInsertPoint(advance_block);
+    llvm::Value * next_index = bits_builder.CreateAdd(word_index, bits_builder.getInt64(1), "next_word", true, true);
+    bits_builder.CreateCondBr(bits_builder.CreateICmpULT(next_index, count), load_block, none_block);
+
+    bits_builder.SetInsertPoint(load_block);
+    llvm::Value * next_word = bits_builder.CreateLoad(word_type, bits_builder.CreateInBoundsGEP(word_type, words, next_index));
+    bits_builder.CreateBr(test_block);
+    word_index->addIncoming(first_index, search_block);
+    word_index->addIncoming(next_index, load_block);
+    word->addIncoming(first_word, search_block);
+    word->addIncoming(next_word, load_block);
+
+    bits_builder.SetInsertPoint(found_block);
+    llvm::Value * bit = bits_builder.CreateIntrinsic(llvm::Intrinsic::cttz, {word_type}, {word, bits_builder.getTrue()});
+    llvm::Value * flag = bits_builder.CreateAdd(bits_builder.CreateShl(word_index, 6), bit, "flag", true, true);
+    bits_builder.CreateRet(bits_builder.CreateTrunc(flag, int32_type));
+
+    bits_builder.SetInsertPoint(none_block);
+    bits_builder.CreateRet(length);
+    return function;
+}
+
+//--------------------
+// Vectors
+//--------------------
+
+void CodeGenerator::vectorExprAction(VectorExprAST * vector_node){
+    BType vector_type = vector_node->getVectorType();
+    std::vector<llvm::Value *> lanes;
+    for(int i = 0; i < vector_node->countLanes(); ++i){
+        vector_node->laneAcceptAt(this, i);
+        lanes.push_back(createCast(popLlvmValue(), vector_node->getLane(i).getType(), laneType(vector_type)));
+    }
+    if(lanes.size() == 1){
+        pushLlvmValue(builder_->CreateVectorSplat(laneCount(vector_type), lanes[0], "splat"));
+        return;
+    }
+    // constant lanes fold to a constant vector
+    llvm::Value * vector = llvm::PoisonValue::get(convertBType(vector_type));
+    for(unsigned i = 0; i < lanes.size(); ++i){
+        vector = builder_->CreateInsertElement(vector, lanes[i], i, "lanes");
+    }
+    pushLlvmValue(vector);
+}
+
+llvm::Value * CodeGenerator::createVectorBuiltin(CallExprAST * call_node){
+    std::string name = call_node->getName();
+    std::vector<llvm::Value *> args;
+    for(int i = 0; i < call_node->countArgs(); ++i){
+        call_node->argAcceptAt(this, i);
+        args.push_back(popLlvmValue());
+    }
+    if(name == select_builtin){
+        return builder_->CreateSelect(args[0], args[1], args[2], "select");
+    }
+    llvm::Value * vector = args[0];
+    llvm::Type * lane_type = vector->getType()->getScalarType();
+    if(name == vector_any_builtin){
+        return builder_->CreateOrReduce(vector);
+    }
+    if(name == vector_all_builtin){
+        return builder_->CreateAndReduce(vector);
+    }
+    if(name == vector_sum_builtin){
+        // the lanes are added in order unless the numeric mode allows reassociating them
+        if(lane_type->isFloatingPointTy()){
+            return builder_->CreateFAddReduce(llvm::ConstantFP::getNegativeZero(lane_type), vector);
+        }
+        return builder_->CreateAddReduce(vector);
+    }
+    // min and max as the scalar builtins, ignoring NaNs
+    bool is_min = name == "min";
+    if(lane_type->isFloatingPointTy()){
+        return is_min? builder_->CreateFPMinReduce(vector) : builder_->CreateFPMaxReduce(vector);
+    }
+    return is_min? builder_->CreateIntMinReduce(vector, true) : builder_->CreateIntMaxReduce(vector, true);
+}
+
+//--------------------
+// Complex numbers
+//--------------------
+
+llvm::Value * CodeGenerator::createComplex(llvm::Value * re, llvm::Value * im){
+    // constant parts fold to a constant pair
+    llvm::Value * complex = llvm::PoisonValue::get(convertBType(type_complex));
+    complex = builder_->CreateInsertValue(complex, re, 0, "re");
+    return builder_->CreateInsertValue(complex, im, 1, "im");
+}
+
+llvm::Value * CodeGenerator::createComplexArithmetic(char op_code, BType lhs_type, llvm::Value * lhs_val, BType rhs_type, llvm::Value * rhs_val){
+    // on the parts, a + bi and c + di. A real operand has no imaginary part (null) rather
+    // than a zero one, so x * z is two multiplies and an infinite x doesn't give 0 * inf = NaN.
+    auto parts = [&](BType type, llvm::Value * val) -> std::pair<llvm::Value *, llvm::Value *>{
+        if(type != type_complex){
+            return {createCast(val, type, type_double), nullptr};
+        }
+        return {builder_->CreateExtractValue(val, 0, "re"), builder_->CreateExtractValue(val, 1, "im")};
+    };
+    auto [a, b] = parts(lhs_type, lhs_val);
+    auto [c, d] = parts(rhs_type, rhs_val);
+    switch(op_code){
+    case('+'):{
+        llvm::Value * im = !b? d : !d? b : createAdd(type_double, b, d);
+        return createComplex(createAdd(type_double, a, c), im);
+    }
+    case('-'):{
+        llvm::Value * im = !b? builder_->CreateFNeg(d, "im_neg") : !d? b : createSub(type_double, b, d);
+        return createComplex(createSub(type_double, a, c), im);
+    }
+    case('*'):{
+        if(!b){
+            return createComplex(createMul(type_double, a, c), createMul(type_double, a, d));
+        }
+        if(!d){
+            return createComplex(createMul(type_double, a, c), createMul(type_double, b, c));
+        }
+        // (ac - bd) + (ad + bc)i, without C's recovery of infinities from NaN parts.
+        // The contract and fast numeric modes fuse these into fmas.
+        llvm::Value * re = createSub(type_double, createMul(type_double, a, c), createMul(type_double, b, d));
+        llvm::Value * im = createAdd(type_double, createMul(type_double, a, d), createMul(type_double, b, c));
+        return createComplex(re, im);
+    }
+    default:{
+        spdlog::error("Unknown complex operator {0}", op_code);
+        throw BError();
+    }
+    }
+}
+
+llvm::Value * CodeGenerator::createComplexBuiltin(CallExprAST * call_node){
+    std::string name = call_node->getName();
+    std::vector<llvm::Value *> args = createCallArgs(call_node);
+    if(name == complex_builtin){
+        return createComplex(args[0], args[1]);
+    }
+    llvm::Value * re = builder_->CreateExtractValue(args[0], 0, "re");
+    llvm::Value * im = builder_->CreateExtractValue(args[0], 1, "im");
+    if(name == "real"){
+        return re;
+    }
+    if(name == "imag"){
+        return im;
+    }
+    if(name == "conj"){
+        return createComplex(re, builder_->CreateFNeg(im, "im_neg"));
+    }
+    // abs2
+    return createAdd(type_double, createMul(type_double, re, re), createMul(type_double, im, im));
+}
 
 void CodeGenerator::ifStAction(IfStatementAST * if_node){
     if_node->condAccept(this);
@@ -543,6 +2093,8 @@ void CodeGenerator::ifStAction(IfStatementAST * if_node){
 
     // Branch to else block if it exists, else jump straight to merge.
     builder_->CreateCondBr(if_val, then_block, if_node->getHasElse()? else_block : merge_block);
+    sealBlock(then_block);
+    sealBlock(else_block);
 
     // Move, emit code, and branch to the merge block
     builder_->SetInsertPoint(then_block);
@@ -566,6 +2118,7 @@ void CodeGenerator::ifStAction(IfStatementAST * if_node){
     }
 
     parent_function->getBasicBlockList().push_back(merge_block);
+    sealBlock(merge_block);
     builder_->SetInsertPoint(merge_block);
 }
 
@@ -580,8 +2133,12 @@ void CodeGenerator::forStAction(ForStatementAST * for_node){
     llvm::BasicBlock * loop_cond_block = llvm::BasicBlock::Create(*context_, "loop_condition");
     llvm::BasicBlock * loop_body_block = llvm::BasicBlock::Create(*context_, "loop_body");
     llvm::BasicBlock * loop_end_block = llvm::BasicBlock::Create(*context_, "loop_end");
+    // the induction variables are only in scope in the loop
+    auto outer_values = named_values_;
+    auto outer_variables = ssa_variables_;
 
     builder_->CreateBr(loop_start_block); // explicit fall through to start
+    sealBlock(loop_start_block);
     builder_->SetInsertPoint(loop_start_block);
     for_node->startAccept(this);
     builder_->CreateBr(loop_cond_block);
@@ -592,6 +2149,8 @@ void CodeGenerator::forStAction(ForStatementAST * for_node){
     llvm::Value * cond_val = popLlvmValue();
     // While the condition is true, branch to the loop body, else skip
     builder_->CreateCondBr(cond_val, loop_body_block, loop_end_block);
+    sealBlock(loop_body_block);
+    sealBlock(loop_end_block);
     
     // Insert the body and step code
     parent_function->getBasicBlockList().push_back(loop_body_block);
@@ -605,13 +2164,16 @@ void CodeGenerator::forStAction(ForStatementAST * for_node){
         // Check condition for another iteration
         builder_->CreateBr(loop_cond_block);
     }    
+    // The back edge is the condition's last predecessor
+    sealBlock(loop_cond_block);
 
     // Add body to end of function
 
-    // TODO: handle scoping of induction variables?
     // Add loop end at end of function
     parent_function->getBasicBlockList().push_back(loop_end_block);
     builder_->SetInsertPoint(loop_end_block);
+    named_values_ = outer_values;
+    ssa_variables_ = outer_variables;
 }
 
 void CodeGenerator::whileStAction(WhileStatementAST * while_node){
@@ -627,6 +2189,8 @@ void CodeGenerator::whileStAction(WhileStatementAST * while_node){
     while_node->condAccept(this);
     llvm::Value * cond_val = popLlvmValue();
     builder_->CreateCondBr(cond_val,loop_body,loop_end);
+    sealBlock(loop_body);
+    sealBlock(loop_end);
     
     parent_function->getBasicBlockList().push_back(loop_body);
     builder_->SetInsertPoint(loop_body);
@@ -636,26 +2200,210 @@ void CodeGenerator::whileStAction(WhileStatementAST * while_node){
     if(!term_inst){
         builder_->CreateBr(loop_cond);
     }
+    sealBlock(loop_cond);
 
     parent_function->getBasicBlockList().push_back(loop_end);
     builder_->SetInsertPoint(loop_end);
 }
 
+void CodeGenerator::matchStAction(MatchStatementAST * match_node){
+    match_node->subjectAccept(this);
+    llvm::Value * subject = popLlvmValue();
+    const std::vector<std::pair<int64_t, int>> & segments = match_node->getSegments();
+    llvm::Function * parent_function = builder_->GetInsertBlock()->getParent();
+    llvm::BasicBlock * merge_block = llvm::BasicBlock::Create(*context_, "match_continue");
+
+    if(!createMatchTable(match_node, subject)){
+        int arms = match_node->countArms() + 1;
+        std::vector<llvm::BasicBlock *> arm_blocks;
+        for(int i = 0; i < arms; ++i){
+            arm_blocks.push_back(llvm::BasicBlock::Create(*context_, i == match_node->countArms()? "match_else" : "match_arm"));
+        }
+        uint64_t span = segments.size() > 2? (uint64_t)segments.back().first - (uint64_t)segments[1].first : 0;
+        bool dense = span <= match_switch_density * segments.size() && span <= match_switch_values;
+        bool use_switch = segments.size() > 2 && (match_lowering_ == match_auto? dense : match_lowering_ == match_switch && span <= (1 << 16));
+        if(use_switch){
+            createMatchSwitch(subject, segments, arm_blocks);
+        }
+        else{
+            createMatchSearch(subject, segments, 0, segments.size(), arm_blocks);
+        }
+
+        // an arm only the values of other arms would take (else) is dropped
+        for(int i = 0; i < arms; ++i){
+            llvm::BasicBlock * arm_block = arm_blocks[i];
+            if(arm_block->hasNPredecessors(0)){
+                delete arm_block;
+                continue;
+            }
+            parent_function->getBasicBlockList().push_back(arm_block);
+            sealBlock(arm_block);
+            builder_->SetInsertPoint(arm_block);
+            match_node->armAcceptAt(this, i);
+            if(!builder_->GetInsertBlock()->getTerminator()){
+                builder_->CreateBr(merge_block);
+            }
+        }
+    }
+
+    parent_function->getBasicBlockList().push_back(merge_block);
+    sealBlock(merge_block);
+    builder_->SetInsertPoint(merge_block);
+}
+
+bool CodeGenerator::createMatchTable(MatchStatementAST * match_node, llvm::Value * subject){
+    // the value every arm returns, by the subject's offset from the second segment,
+    // with those of the outermost segments selected by a comparison
+    const std::vector<BValue> & values = match_node->getReturnedValues();
+    const std::vector<std::pair<int64_t, int>> & segments = match_node->getSegments();
+    if(values.empty() || segments.size() < 3 || match_lowering_ == match_switch || match_lowering_ == match_search){
+        return false;
+    }
+    llvm::Function * function = builder_->GetInsertBlock()->getParent();
+    std::vector<llvm::Constant *> returned;
+    for(const BValue & value : values){
+        returned.push_back(createConstant(value));
+        if(returned.back()->getType() != function->getReturnType()){
+            return false;
+        }
+    }
+    uint64_t span = (uint64_t)segments.back().first - (uint64_t)segments[1].first;
+    bool dense = span <= match_table_density * segments.size() && span <= match_table_entries;
+    if(!(match_lowering_ == match_auto? dense : span <= (1 << 16))){
+        return false;
+    }
+
+    std::vector<llvm::Constant *> entries;
+    for(unsigned i = 1; i + 1 < segments.size(); ++i){
+        uint64_t length = segments[i + 1].first - segments[i].first;
+        entries.insert(entries.end(), length, returned[segments[i].second]);
+    }
+    llvm::ArrayType * table_type = llvm::ArrayType::get(function->getReturnType(), entries.size());
+    auto * table = new llvm::GlobalVariable(*module_, table_type, true, llvm::GlobalValue::PrivateLinkage,
+        llvm::ConstantArray::get(table_type, entries), "match_table");
+    table->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+
+    llvm::Constant * start = llvm::ConstantInt::get(subject->getType(), segments[1].first, true);
+    llvm::Value * offset = builder_->CreateSub(subject, start, "match_offset");
+    llvm::Value * in_table = builder_->CreateICmpULT(offset, llvm::ConstantInt::get(subject->getType(), span), "in_table");
+    // clamped, so the load is always in bounds and the lookup doesn't branch
+    offset = builder_->CreateSelect(in_table, offset, llvm::ConstantInt::get(subject->getType(), 0));
+    offset = builder_->CreateZExt(offset, builder_->getInt64Ty());
+    llvm::Value * entry = builder_->CreateInBoundsGEP(table_type, table, {builder_->getInt64(0), offset});
+    llvm::Value * tabled = builder_->CreateLoad(function->getReturnType(), entry, "match_entry");
+    llvm::Value * outside = builder_->CreateSelect(builder_->CreateICmpSLT(subject, start),
+        returned[segments.front().second], returned[segments.back().second], "match_outside");
+    llvm::Value * return_val = builder_->CreateSelect(in_table, tabled, outside, "match_value");
+    freeArrays(0);
+    builder_->CreateRet(return_val);
+    return true;
+}
+
+void CodeGenerator::createMatchSwitch(llvm::Value * subject, const std::vector<std::pair<int64_t, int>> & segments,
+    const std::vector<llvm::BasicBlock *> & arm_blocks){
+    // a case for each value between the outermost segments, unless it takes their
+    // arm when they share one, which is then the default
+    int low_arm = segments.front().second;
+    int high_arm = segments.back().second;
+    llvm::BasicBlock * default_block = arm_blocks[low_arm];
+    llvm::BasicBlock * outside_block = nullptr;
+    if(low_arm != high_arm){
+        outside_block = llvm::BasicBlock::Create(*context_, "match_outside", builder_->GetInsertBlock()->getParent());
+        default_block = outside_block;
+    }
+    llvm::SwitchInst * switch_inst = builder_->CreateSwitch(subject, default_block);
+    for(unsigned i = 1; i + 1 < segments.size(); ++i){
+        if(segments[i].second == low_arm && !outside_block){
+            continue;
+        }
+        for(int64_t value = segments[i].first; value != segments[i + 1].first; ++value){
+            switch_inst->addCase(llvm::cast<llvm::ConstantInt>(llvm::ConstantInt::get(subject->getType(), value, true)),
+                arm_blocks[segments[i].second]);
+        }
+    }
+    if(outside_block){
+        sealBlock(outside_block);
+        builder_->SetInsertPoint(outside_block);
+        llvm::Constant * start = llvm::ConstantInt::get(subject->getType(), segments[1].first, true);
+        builder_->CreateCondBr(builder_->CreateICmpSLT(subject, start), arm_blocks[low_arm], arm_blocks[high_arm]);
+    }
+}
+
+void CodeGenerator::createMatchSearch(llvm::Value * subject, const std::vector<std::pair<int64_t, int>> & segments,
+    int first, int last, const std::vector<llvm::BasicBlock *> & arm_blocks){
+    // the subject is in one of segments [first, last), halved by each comparison
+    if(last - first == 1){
+        builder_->CreateBr(arm_blocks[segments[first].second]);
+        return;
+    }
+    int middle = (first + last) / 2;
+    llvm::Function * function = builder_->GetInsertBlock()->getParent();
+    llvm::BasicBlock * below_block = llvm::BasicBlock::Create(*context_, "match_below", function);
+    llvm::BasicBlock * above_block = llvm::BasicBlock::Create(*context_, "match_above", function);
+    llvm::Constant * start = llvm::ConstantInt::get(subject->getType(), segments[middle].first, true);
+    builder_->CreateCondBr(builder_->CreateICmpSLT(subject, start, "match_cmp"), below_block, above_block);
+    sealBlock(below_block);
+    sealBlock(above_block);
+    builder_->SetInsertPoint(below_block);
+    createMatchSearch(subject, segments, first, middle, arm_blocks);
+    builder_->SetInsertPoint(above_block);
+    createMatchSearch(subject, segments, middle, last, arm_blocks);
+}
+
 void CodeGenerator::returnStAction(ReturnStatementAST * return_node){
+    llvm::Function * function = builder_->GetInsertBlock()->getParent();
+    CallExprAST * call_node = return_node->getCallExpr();
+    // a tail call would reuse or free the frame its arrays are in, and their memory is freed before returning
+    bool tail_call = return_node->isTailCall() && !arrays_declared_;
+    if(tail_call && !call_node->isFolded() && call_node->getName() == function->getName() && tail_recursion_block_){
+        // Self tail recursion: rebind the arguments and jump back to the top of the body
+        std::vector<llvm::Value *> args_vec = createCallArgs(call_node);
+        for(unsigned i = 0; i < args_vec.size(); ++i){
+            if(ssa_){
+                writeDefinition(argument_variables_[i], builder_->GetInsertBlock(), args_vec[i]);
+            }
+            else{
+                builder_->CreateStore(args_vec[i], argument_allocas_[i]);
+            }
+        }
+        builder_->CreateBr(tail_recursion_block_);
+        return;
+    }
+
     // codegen return value
     return_node->returnExprAccept(this);
     llvm::Value * return_val = popLlvmValue();
+    freeArrays(0);
+    llvm::CallInst * call_inst = llvm::dyn_cast<llvm::CallInst>(return_val);
+    if(tail_call && call_inst){
+        // musttail needs the caller and callee to match in prototype and convention,
+        // otherwise the call is only marked as a candidate.
+        llvm::Function * callee = call_inst->getCalledFunction();
+        bool must_tail = callee && !callee->isIntrinsic() && callee->getFunctionType() == function->getFunctionType()
+            && callee->getCallingConv() == function->getCallingConv();
+        call_inst->setTailCallKind(must_tail? llvm::CallInst::TCK_MustTail : llvm::CallInst::TCK_Tail);
+    }
     builder_->CreateRet(return_val);
 }
 
 void CodeGenerator::blockStAction(BlockStatementAST * block_node){
     int llvm_val_stack_size = llvm_value_stack_.size();
+    array_scopes_.emplace_back();
+    // declarations in the block shadow the variables outside it until it ends
+    auto outer_values = named_values_;
+    auto outer_variables = ssa_variables_;
 
     // codegen for each statement, starting from this entry block
     block_node->resetStatementIndex();
     while(block_node->anotherStatement()){
         block_node->statementAcceptOne(this);
     }
+    if(!builder_->GetInsertBlock()->getTerminator()){
+        freeArrays(array_scopes_.size()-1);
+    }
+    array_scopes_.pop_back();
+    named_values_ = outer_values;
+    ssa_variables_ = outer_variables;
 
     if(llvm_val_stack_size != llvm_value_stack_.size()){
         spdlog::error("Value stack size not maintained in block");
@@ -671,20 +2419,23 @@ void CodeGenerator::callStAction(CallStatementAST * call_node){
 }
 
 void CodeGenerator::assignStAction(AssignStatementAST * assign_node){
+    if(isBitsType(assign_node->getDestType()) && !dynamic_cast<const ArrayExprAST *>(&assign_node->getValue())){
+        createBitsAssignment(assign_node);
+        return;
+    }
     assign_node->valueAccept(this);
     llvm::Value * val_to_assign = popLlvmValue();
 
     std::string var_name = assign_node->getIdentifier();
 
     // TODO ensure that var is already initialised.
-    llvm::AllocaInst * alloca = named_values_[var_name];
 
     // TYPE CHECK
     BType dest_type = assign_node->getDestType();
     if(convertBType(dest_type) != val_to_assign->getType()){
-        val_to_assign = createCast(val_to_assign,dest_type);
+        val_to_assign = createCast(val_to_assign,assign_node->getValue().getType(),dest_type);
     }
-    builder_->CreateStore(val_to_assign, alloca);
+    writeVariable(var_name, builder_->GetInsertBlock(), val_to_assign);
 }
 
 void CodeGenerator::initStAction(InitStatementAST * init_node){
@@ -692,31 +2443,120 @@ void CodeGenerator::initStAction(InitStatementAST * init_node){
     std::string var_name = init_node->getIdentifier();
     spdlog::debug("generating init statement");
     llvm::Type * var_type = convertBType(init_node->getType());
-    llvm::AllocaInst *alloca = builder_->CreateAlloca(var_type, nullptr, var_name);
-    named_values_[var_name] = alloca;
+    if(init_node->isGlobal()){
+        if(declaring_){
+            globals_[var_name] = new llvm::GlobalVariable(*module_, var_type, false, llvm::GlobalValue::InternalLinkage,
+                llvm::Constant::getNullValue(var_type), var_name);
+            return;
+        }
+        init_node->valueAccept(this);
+        llvm::Value * init_val = popLlvmValue();
+        if(init_val->getType() != var_type){
+            init_val = createCast(init_val, init_node->getAssignment().getValue().getType(), init_node->getType());
+        }
+        // The builder folds constant expressions, so a constant here can be the
+        // global's initialiser and every read of it folds.
+        llvm::Constant * init_const = llvm::dyn_cast<llvm::Constant>(init_val);
+        if(init_const && !init_node->isReassigned()){
+            globals_[var_name]->setInitializer(init_const);
+            globals_[var_name]->setConstant(true);
+            return;
+        }
+        builder_->CreateStore(init_val, globals_[var_name]);
+        return;
+    }
+    declareVariable(var_name, var_type);
 
     init_node->assignmentAccept(this);
 }
 
+void CodeGenerator::indexAssignStAction(IndexAssignStatementAST * index_assign_node){
+    IndexExprAST * element_node = index_assign_node->getElementExpr();
+    if(element_node->isLane()){
+        // the vector with the lane replaced, read after the value in case that assigns it
+        std::string name = element_node->getArrayName();
+        element_node->indexAccept(this);
+        llvm::Value * index = popLlvmValue();
+        index_assign_node->valueAccept(this);
+        llvm::Value * val_to_assign = createCast(popLlvmValue(), index_assign_node->getValue().getType(), element_node->getType());
+        llvm::Value * vector = readVariable(name, builder_->GetInsertBlock());
+        if(element_node->isChecked()){
+            createBoundsCheck(index, builder_->getInt32(llvm::cast<llvm::FixedVectorType>(vector->getType())->getNumElements()));
+        }
+        writeVariable(name, builder_->GetInsertBlock(), builder_->CreateInsertElement(vector, val_to_assign, index));
+        return;
+    }
+    if(isBitsType(convertLlvmType(readVariable(element_node->getArrayName(), builder_->GetInsertBlock())->getType()))){
+        llvm::Value * mask;
+        llvm::Value * word_ptr = createFlagPointer(element_node, mask);
+        index_assign_node->valueAccept(this);
+        llvm::Value * flag = popLlvmValue();
+        llvm::Value * word = builder_->CreateLoad(builder_->getInt64Ty(), word_ptr, "word");
+        word = builder_->CreateSelect(flag, builder_->CreateOr(word, mask), builder_->CreateAnd(word, builder_->CreateNot(mask)));
+        builder_->CreateStore(word, word_ptr);
+        return;
+    }
+    llvm::Value * element = createElementPointer(element_node);
+    index_assign_node->valueAccept(this);
+    llvm::Value * val_to_assign = popLlvmValue();
+    BType element_type = index_assign_node->getElementExpr()->getType();
+    if(convertBType(element_type) != val_to_assign->getType()){
+        val_to_assign = createCast(val_to_assign, index_assign_node->getValue().getType(), element_type);
+    }
+    builder_->CreateStore(val_to_assign, element);
+}
+
 void CodeGenerator::prototypeAction(PrototypeAST * proto_node){
     std::vector<llvm::Type *> llvm_arg_types;
     BFType b_func_type = proto_node->getType();
     auto b_arg_types = b_func_type.getArgumentTypes();
     for (auto b_arg_type:b_arg_types){
         spdlog::debug("generating prototype args");
-        llvm_arg_types.push_back(convertBType(b_arg_type));
+        llvm::Type * arg_type = convertBType(b_arg_type);
+        if(isSliceType(b_arg_type)){
+            // passed as its members, in registers
+            llvm_arg_types.insert(llvm_arg_types.end(), arg_type->subtype_begin(), arg_type->subtype_end());
+            continue;
+        }
+        llvm_arg_types.push_back(arg_type);
     }
 
     spdlog::debug("generating prototype RET");
     auto ret_type = convertBType(b_func_type.getReturnType());
     llvm::FunctionType * func_type = llvm::FunctionType::get(ret_type, llvm_arg_types, false);
 
-    llvm::Function * func = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, proto_node->getName(), module_.get());
+    // Functions are private to the module unless exported, leaving the optimiser
+    // free to inline, specialise, drop them and pick their calling convention.
+    bool exported = proto_node->hasAnnotation(annot_export);
+    auto linkage = exported? llvm::Function::ExternalLinkage : llvm::Function::InternalLinkage;
+    llvm::Function * func = llvm::Function::Create(func_type, linkage, proto_node->getName(), module_.get());
+    if(!exported){
+        func->setCallingConv(llvm::CallingConv::Fast);
+    }
+    addTargetAttributes(func);
 
     std::vector<std::pair<std::string,BType>> args = proto_node->getArgs();
-    unsigned i = 0;
-    for(auto &arg : func->args()){
-        arg.setName(args[i++].first);
+    unsigned llvm_arg = 0;
+    for(unsigned i = 0; i < args.size(); ++i){
+        if(!isSliceType(args[i].second)){
+            func->getArg(llvm_arg++)->setName(args[i].first);
+            continue;
+        }
+        SliceAccess access = proto_node->getSliceAccess(i);
+        if(access.noalias){
+            func->addParamAttr(llvm_arg, llvm::Attribute::NoAlias);
+        }
+        if(access.readonly){
+            func->addParamAttr(llvm_arg, llvm::Attribute::ReadOnly);
+        }
+        if(access.nocapture){
+            func->addParamAttr(llvm_arg, llvm::Attribute::NoCapture);
+        }
+        func->getArg(llvm_arg++)->setName(args[i].first + ".elements");
+        if(isStridedType(args[i].second)){
+            func->getArg(llvm_arg++)->setName(args[i].first + ".stride");
+        }
+        func->getArg(llvm_arg++)->setName(args[i].first + ".length");
     }
 
     pushLlvmProto(func);
@@ -725,6 +2565,14 @@ void CodeGenerator::prototypeAction(PrototypeAST * proto_node){
 void CodeGenerator::functionAction(FunctionAST * func_node){
     llvm::Function * function = module_->getFunction(func_node->getProto().getName());
 
+    if(declaring_){
+        if(!function){
+            func_node->protoAccept(this);
+            popLlvmProto();
+        }
+        return;
+    }
+
     if(!function){
         spdlog::debug("Function not previously declared, accepting proto");
         func_node->protoAccept(this);
@@ -741,26 +2589,64 @@ void CodeGenerator::functionAction(FunctionAST * func_node){
     llvm::BasicBlock *entry_block = llvm::BasicBlock::Create(*context_, "entry", function);
     builder_->SetInsertPoint(entry_block);
 
+    NumericMode numeric_mode = numeric_mode_;
+    if(func_node->getProto().hasAnnotation(annot_fastmath)){
+        numeric_mode = num_fast;
+    }
+    else if(func_node->getProto().hasAnnotation(annot_contract)){
+        numeric_mode = num_contract;
+    }
+    else if(func_node->getProto().hasAnnotation(annot_strict)){
+        numeric_mode = num_strict;
+    }
+    applyNumericMode(numeric_mode, function);
+
     // If args exist, record them in named values here
-    named_values_.clear();
-    for(auto &arg : function->args()){
-        std::string arg_name = arg.getName().str();
-        llvm::AllocaInst *alloca = createEntryBlockAlloca(function, &arg);
-        builder_->CreateStore(&arg, alloca);
-        named_values_[arg_name] = alloca;
+    resetVariables();
+    arrays_declared_ = false;
+    sealBlock(entry_block);
+    argument_allocas_.clear();
+    argument_variables_.clear();
+    auto llvm_arg = function->arg_begin();
+    for(auto & [arg_name, arg_type] : func_node->getProto().getArgs()){
+        llvm::Type * type = convertBType(arg_type);
+        llvm::Value * value = &*llvm_arg++;
+        if(isSliceType(arg_type)){
+            // put the slice back together from its members
+            value = builder_->CreateInsertValue(llvm::UndefValue::get(type), value, 0);
+            for(unsigned member = 1; member < type->getStructNumElements(); ++member){
+                value = builder_->CreateInsertValue(value, &*llvm_arg++, member);
+            }
+        }
+        declareVariable(arg_name, type);
+        writeVariable(arg_name, entry_block, value);
+        if(ssa_){
+            argument_variables_.push_back(ssa_variables_[arg_name]);
+        }
+        else{
+            argument_allocas_.push_back(named_values_[arg_name]);
+        }
     }
 
     llvm::BasicBlock *body_block = llvm::BasicBlock::Create(*context_, "body", function);
     builder_->CreateBr(body_block);
     builder_->SetInsertPoint(body_block);
+    tail_recursion_block_ = body_block;
 
     func_node->bodyAccept(this);
+    // Self tail calls are the body's last predecessors
+    sealBlock(body_block);
+    tail_recursion_block_ = nullptr;
 
     // Handle void functions
     llvm::Instruction * term_inst = builder_->GetInsertBlock()->getTerminator();
     if(!term_inst && func_node->getType().getReturnType()==type_void){
         builder_->CreateRetVoid();
     }
+    else if(!term_inst && llvm::pred_empty(builder_->GetInsertBlock())){
+        // e.g. the merge block after an if and else that both return
+        builder_->CreateUnreachable();
+    }
 
     // If we catch an error in the above accepts, then erase this function from parent
     // function->eraseFromParent();
@@ -773,16 +2659,147 @@ void CodeGenerator::functionAction(FunctionAST * func_node){
         spdlog::error("function {0}: body not verified", func_node->getProto().getName());
         throw BError();
     }
-    
+
+    // A memo function's body is what gets multiversioned, the cache lookup in front is small
+    if(func_node->getProto().hasAnnotation(annot_memo)){
+        function = memoiseFunction(function);
+    }
+    if(func_node->getProto().hasAnnotation(annot_multiversion)){
+        multiversionFunction(function);
+    }
+}
+
+llvm::Function * CodeGenerator::memoiseFunction(llvm::Function * function){
+    std::string name = function->getName().str();
+    llvm::FunctionType * func_type = function->getFunctionType();
+    llvm::Type * ret_type = func_type->getReturnType();
+    llvm::Type * int8_type = llvm::Type::getInt8Ty(*context_);
+    llvm::Type * int64_type = llvm::Type::getInt64Ty(*context_);
+
+    // The body moves to its own function and function becomes a cache lookup in
+    // front of it. Recursive calls in the body still call function, so are cached too.
+    llvm::Function * uncached = llvm::Function::Create(func_type, llvm::Function::InternalLinkage, name + ".uncached", module_.get());
+    uncached->setCallingConv(function->getCallingConv());
+    uncached->setAttributes(function->getAttributes());
+    uncached->getBasicBlockList().splice(uncached->end(), function->getBasicBlockList());
+    std::vector<llvm::Value *> args;
+    auto uncached_arg = uncached->arg_begin();
+    for(auto & arg : function->args()){
+        uncached_arg->setName(arg.getName());
+        arg.replaceAllUsesWith(&*uncached_arg++);
+        args.push_back(&arg);
+    }
+
+    llvm::BasicBlock * entry_block = llvm::BasicBlock::Create(*context_, "entry", function);
+    llvm::BasicBlock * hit_block = llvm::BasicBlock::Create(*context_, "memo_hit", function);
+    llvm::BasicBlock * miss_block = llvm::BasicBlock::Create(*context_, "memo_miss", function);
+    llvm::IRBuilder<> memo_builder(entry_block);
+    auto callUncached = [&](){
+        llvm::CallInst * call = memo_builder.CreateCall(uncached, args, "uncached");
+        call->setCallingConv(uncached->getCallingConv());
+        return call;
+    };
+
+    llvm::Value * value_ptr;
+    llvm::Value * known_ptr;
+    std::vector<std::pair<llvm::Value *, llvm::Value *>> key_stores;
+    if(args.size() == 1 && args[0]->getType()->isIntegerTy(32)){
+        // A small int domain indexes the table directly, arguments outside it aren't cached
+        llvm::ArrayType * values_type = llvm::ArrayType::get(ret_type, memo_size_);
+        llvm::ArrayType * known_type = llvm::ArrayType::get(int8_type, memo_size_);
+        llvm::GlobalVariable * values = new llvm::GlobalVariable(*module_, values_type, false, llvm::GlobalValue::InternalLinkage,
+            llvm::ConstantAggregateZero::get(values_type), name + ".memo_values");
+        llvm::GlobalVariable * known = new llvm::GlobalVariable(*module_, known_type, false, llvm::GlobalValue::InternalLinkage,
+            llvm::ConstantAggregateZero::get(known_type), name + ".memo_known");
+
+        llvm::BasicBlock * lookup_block = llvm::BasicBlock::Create(*context_, "memo_lookup", function);
+        llvm::BasicBlock * outside_block = llvm::BasicBlock::Create(*context_, "memo_outside", function);
+        // unsigned, so negative arguments are outside too
+        llvm::Value * inside = memo_builder.CreateICmpULT(args[0], memo_builder.getInt32(memo_size_), "memo_inside");
+        memo_builder.CreateCondBr(inside, lookup_block, outside_block);
+
+        memo_builder.SetInsertPoint(outside_block);
+        llvm::CallInst * outside_call = callUncached();
+        outside_call->setTailCallKind(llvm::CallInst::TCK_Tail);
+        memo_builder.CreateRet(outside_call);
+
+        memo_builder.SetInsertPoint(lookup_block);
+        llvm::Value * index = memo_builder.CreateZExt(args[0], int64_type, "memo_index");
+        value_ptr = memo_builder.CreateInBoundsGEP(values_type, values, {memo_builder.getInt64(0), index}, "memo_value_ptr");
+        known_ptr = memo_builder.CreateInBoundsGEP(known_type, known, {memo_builder.getInt64(0), index}, "memo_known_ptr");
+        llvm::Value * is_known = memo_builder.CreateICmpNE(memo_builder.CreateLoad(int8_type, known_ptr), memo_builder.getInt8(0), "memo_is_known");
+        memo_builder.CreateCondBr(is_known, hit_block, miss_block);
+    }
+    else{
+        // Otherwise the arguments' bits are hashed to a slot holding the last call that hashed there
+        uint64_t slots = llvm::PowerOf2Ceil(memo_size_);
+        llvm::ArrayType * keys_type = llvm::ArrayType::get(int64_type, args.size());
+        llvm::StructType * slot_type = llvm::StructType::get(*context_, {keys_type, ret_type, int8_type});
+        llvm::ArrayType * table_type = llvm::ArrayType::get(slot_type, slots);
+        llvm::GlobalVariable * table = new llvm::GlobalVariable(*module_, table_type, false, llvm::GlobalValue::InternalLinkage,
+            llvm::ConstantAggregateZero::get(table_type), name + ".memo_table");
+
+        std::vector<llvm::Value *> keys;
+        llvm::Value * hash = memo_builder.getInt64(0);
+        for(llvm::Value * arg : args){
+            llvm::Value * key = arg;
+            if(arg->getType()->isFloatingPointTy()){
+                key = memo_builder.CreateBitCast(arg, memo_builder.getIntNTy(arg->getType()->getPrimitiveSizeInBits()));
+            }
+            key = memo_builder.CreateZExt(key, int64_type);
+            keys.push_back(key);
+            hash = memo_builder.CreateMul(memo_builder.CreateXor(hash, key), memo_builder.getInt64(0x9E3779B97F4A7C15ULL));
+            hash = memo_builder.CreateXor(hash, memo_builder.CreateLShr(hash, 32));
+        }
+        llvm::Value * index = memo_builder.CreateAnd(hash, memo_builder.getInt64(slots - 1), "memo_index");
+        llvm::Value * slot_ptr = memo_builder.CreateInBoundsGEP(table_type, table, {memo_builder.getInt64(0), index}, "memo_slot");
+        value_ptr = memo_builder.CreateStructGEP(slot_type, slot_ptr, 1, "memo_value_ptr");
+        known_ptr = memo_builder.CreateStructGEP(slot_type, slot_ptr, 2, "memo_known_ptr");
+        llvm::Value * matches = memo_builder.CreateICmpNE(memo_builder.CreateLoad(int8_type, known_ptr), memo_builder.getInt8(0), "memo_is_known");
+        for(unsigned i = 0; i < keys.size(); ++i){
+            llvm::Value * key_ptr = memo_builder.CreateInBoundsGEP(slot_type, slot_ptr, {memo_builder.getInt64(0), memo_builder.getInt32(0), memo_builder.getInt64(i)});
+            matches = memo_builder.CreateAnd(matches, memo_builder.CreateICmpEQ(memo_builder.CreateLoad(int64_type, key_ptr), keys[i]));
+            key_stores.push_back({keys[i], key_ptr});
+        }
+        memo_builder.CreateCondBr(matches, hit_block, miss_block);
+    }
+
+    memo_builder.SetInsertPoint(hit_block);
+    memo_builder.CreateRet(memo_builder.CreateLoad(ret_type, value_ptr, "memo_value"));
+
+    memo_builder.SetInsertPoint(miss_block);
+    llvm::CallInst * miss_call = callUncached();
+    for(auto & [key, key_ptr] : key_stores){
+        memo_builder.CreateStore(key, key_ptr);
+    }
+    memo_builder.CreateStore(miss_call, value_ptr);
+    memo_builder.CreateStore(memo_builder.getInt8(1), known_ptr);
+    memo_builder.CreateRet(miss_call);
+
+    if(llvm::verifyFunction(*function) || llvm::verifyFunction(*uncached)){
+        this->printIR();
+        spdlog::error("function {0}: memo cache not verified", name);
+        throw BError();
+    }
+    return uncached;
 }
 
 void CodeGenerator::topLevelsAction(TopLevels * top_levels_node){
+    if(declaring_){
+        top_levels_node->globalsAllAccept(this);
+        return;
+    }
     // setup the main function
     llvm::FunctionType * func_type = llvm::FunctionType::get(llvm::Type::getInt32Ty(*context_), false); 
     llvm::Function * main_function = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, "main", module_.get());
+    addTargetAttributes(main_function);
 
     llvm::BasicBlock *main_entry_block = llvm::BasicBlock::Create(*context_, "main_entry", main_function);
     builder_->SetInsertPoint(main_entry_block);
+    applyNumericMode(numeric_mode_, main_function);
+    resetVariables();
+    arrays_declared_ = false;
+    sealBlock(main_entry_block);
 
     // Add to a basic block inside the function
     top_levels_node->statementsAllAccept(this);
@@ -801,10 +2818,18 @@ void CodeGenerator::funcDefsAction(FuncDefs * func_defs_node){
     func_defs_node->functionsAllAccept(this);
 }
 void CodeGenerator::programAction(BProgram * program_node){
+    // Declare every global and function before generating any bodies, so a call
+    // can come before its callee's definition (as in mutual recursion).
+    declaring_ = true;
+    program_node->topLevelsAccept(this);
     program_node->funcDefsAccept(this);
-    spdlog::info("Functions Generated");
+    declaring_ = false;
+    // The top levels go first so constant globals are known when the function
+    // bodies read them.
     program_node->topLevelsAccept(this);
     spdlog::info("Top Level Statements Generated ");
+    program_node->funcDefsAccept(this);
+    spdlog::info("Functions Generated");
     spdlog::debug("Final stack size {0:d}", llvm_value_stack_.size());
 }
 
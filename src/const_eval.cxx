@@ -0,0 +1,957 @@
+#include "const_eval.hxx"
+#include "builtins.hxx"
+#include "exceptions.hxx"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+namespace bassoon
+{
+namespace ctfe
+{
+
+//--------------------
+// Value helpers
+//--------------------
+
+BValue boolValue(bool value){
+    BValue result;
+    result.type = type_bool;
+    result.bool_value = value;
+    return result;
+}
+
+BValue intValue(int value){
+    BValue result;
+    result.type = type_int;
+    result.int_value = value;
+    return result;
+}
+
+BValue doubleValue(double value){
+    BValue result;
+    result.type = type_double;
+    result.double_value = value;
+    return result;
+}
+
+BValue longValue(int64_t value){
+    BValue result;
+    result.type = type_long;
+    result.long_value = value;
+    return result;
+}
+
+BValue floatValue(float value){
+    BValue result;
+    result.type = type_float;
+    result.float_value = value;
+    return result;
+}
+
+BValue uintValue(uint32_t value){
+    BValue result;
+    result.type = type_uint;
+    result.uint_value = value;
+    return result;
+}
+
+BValue ulongValue(uint64_t value){
+    BValue result;
+    result.type = type_ulong;
+    result.ulong_value = value;
+    return result;
+}
+
+double asDouble(BValue value){
+    switch(value.type){
+    case(type_int): return value.int_value;
+    case(type_long): return value.long_value;
+    case(type_float): return value.float_value;
+    case(type_uint): return value.uint_value;
+    case(type_ulong): return value.ulong_value;
+    default: return value.double_value;
+    }
+}
+
+// fptosi is poison outside the integer type's range
+double truncateInRange(double value, double min, double max){
+    double truncated = std::trunc(value);
+    if(!(truncated >= min && truncated < max)){
+        throw EvaluationAborted("floating point to integer conversion out of range");
+    }
+    return truncated;
+}
+
+// ints wrap as they do in two's complement
+int wrap(int64_t value){
+    return (int) (uint32_t) value;
+}
+
+uint64_t valueBits(BValue value){
+    switch(value.type){
+    case(type_bool):{
+        return value.bool_value;
+    }
+    case(type_int):{
+        return (uint32_t) value.int_value;
+    }
+    case(type_long):{
+        return (uint64_t) value.long_value;
+    }
+    case(type_uint):{
+        return value.uint_value;
+    }
+    case(type_ulong):{
+        return value.ulong_value;
+    }
+    case(type_float):{
+        uint32_t bits;
+        std::memcpy(&bits, &value.float_value, sizeof(bits));
+        return bits;
+    }
+    default:{
+        uint64_t bits;
+        std::memcpy(&bits, &value.double_value, sizeof(bits));
+        return bits;
+    }
+    }
+}
+
+// the int of the type with the low bits of bits, wrapping as two's complement does
+BValue integerValue(BType type, uint64_t bits){
+    switch(type){
+    case(type_int): return intValue((int) (uint32_t) bits);
+    case(type_long): return longValue((int64_t) bits);
+    case(type_uint): return uintValue((uint32_t) bits);
+    default: return ulongValue(bits);
+    }
+}
+
+// the casts codegen makes on assignment, arguments and mixed arithmetic. Ints are
+// extended by the signedness of the type they're converted from, as sext and zext are.
+BValue convert(BValue value, BType type){
+    if(value.type == type){
+        return value;
+    }
+    if(!isNumericType(value.type) || !isNumericType(type)){
+        throw EvaluationAborted("no conversion from " + typeToStr(value.type) + " to " + typeToStr(type));
+    }
+    if(isIntegerType(value.type) && isIntegerType(type)){
+        uint64_t bits = value.type == type_int? (uint64_t) (int64_t) value.int_value : valueBits(value);
+        return integerValue(type, bits);
+    }
+    switch(type){
+    case(type_int):{
+        return intValue((int) truncateInRange(asDouble(value), INT_MIN, (double) INT_MAX + 1));
+    }
+    case(type_long):{
+        return longValue((int64_t) truncateInRange(asDouble(value), -0x1p63, 0x1p63));
+    }
+    case(type_uint):{
+        return uintValue((uint32_t) truncateInRange(asDouble(value), 0, 0x1p32));
+    }
+    case(type_ulong):{
+        return ulongValue((uint64_t) truncateInRange(asDouble(value), 0, 0x1p64));
+    }
+    case(type_float):{
+        // straight from a 64 bit int, rounding once as sitofp and uitofp do
+        if(value.type == type_long){
+            return floatValue((float) value.long_value);
+        }
+        return floatValue(value.type == type_ulong? (float) value.ulong_value : (float) asDouble(value));
+    }
+    default:{
+        return doubleValue(asDouble(value));
+    }
+    }
+}
+
+// arithmetic and bit operations of ints of the type on their bits, with the int
+// semantics of codegen's instructions. Shift and rotate amounts are modulo the width.
+BValue integerOperation(char op_code, BType type, uint64_t lhs, uint64_t rhs, const std::string & loc_str){
+    unsigned width = typeBytes(type) * 8;
+    bool is_signed = !isUnsignedType(type);
+    // sign extended from the width
+    auto signedBits = [width](uint64_t bits) -> int64_t{
+        return width == 32? (int64_t) (int32_t) bits : (int64_t) bits;
+    };
+    uint64_t amount = rhs & (width - 1);
+    switch(op_code){
+    case('+'): return integerValue(type, lhs + rhs);
+    case('-'): return integerValue(type, lhs - rhs);
+    case('*'): return integerValue(type, lhs * rhs);
+    case('&'): return integerValue(type, lhs & rhs);
+    case('|'): return integerValue(type, lhs | rhs);
+    case('^'): return integerValue(type, lhs ^ rhs);
+    case('/'):
+    case('%'):{
+        // sdiv, srem, udiv and urem are undefined for these
+        int64_t min = width == 32? INT_MIN : INT64_MIN;
+        if(rhs == 0){
+            throw EvaluationAborted("integer division by zero at " + loc_str);
+        }
+        if(!is_signed){
+            return integerValue(type, op_code == '/'? lhs / rhs : lhs % rhs);
+        }
+        int64_t l = signedBits(lhs), r = signedBits(rhs);
+        if(l == min && r == -1){
+            throw EvaluationAborted("integer division overflow at " + loc_str);
+        }
+        return integerValue(type, op_code == '/'? l / r : l % r);
+    }
+    case('l'): return integerValue(type, lhs << amount);
+    case('r'): return integerValue(type, is_signed? (uint64_t) (signedBits(lhs) >> amount) : lhs >> amount);
+    }
+    throw EvaluationAborted(std::string("unknown operator ") + op_code + " on " + typeToStr(type));
+}
+
+//--------------------
+// Evaluator state
+//--------------------
+
+void ConstEvaluator::addFunction(FunctionAST * func_node){
+    functions_[func_node->getProto().getName()] = func_node;
+}
+
+bool ConstEvaluator::isPure(const std::string & func_name){
+    if(functions_.count(func_name) || isRotateBuiltin(func_name)){
+        return true;
+    }
+    for(const Builtin & builtin : builtin_functions){
+        if(builtin.name == func_name){
+            return builtin.pure;
+        }
+    }
+    return false;
+}
+
+bool ConstEvaluator::evaluate(std::function<void(ASTVisitor *)> accept, BValue & result, unsigned min_steps){
+    steps_ = 0;
+    step_limit_ = std::max(max_steps_, min_steps);
+    returning_ = false;
+    frames_.clear();
+    try{
+        accept(this);
+    }catch(EvaluationAborted & e){
+        failure_ = e.what();
+        frames_.clear();
+        return false;
+    }
+    result = value_;
+    return true;
+}
+
+bool ConstEvaluator::evaluateReturn(std::function<void(ASTVisitor *)> accept, BValue & result){
+    return evaluate([this, accept](ASTVisitor * v){
+        frames_.push_back(Frame(1));
+        accept(v);
+        if(!returning_){
+            throw EvaluationAborted("nothing returned");
+        }
+    }, result);
+}
+
+void ConstEvaluator::step(){
+    if(++steps_ > step_limit_){
+        throw EvaluationAborted("ran out of steps");
+    }
+}
+
+BValue ConstEvaluator::lookup(const std::string & name){
+    if(!frames_.empty()){
+        Frame & frame = frames_.back();
+        for(auto scope = frame.rbegin(); scope != frame.rend(); ++scope){
+            auto variable = scope->find(name);
+            if(variable != scope->end()){
+                return variable->second;
+            }
+        }
+    }
+    else if(hidden_.count(name)){
+        throw EvaluationAborted(name + " is only known at run time");
+    }
+    auto constant = constants_.find(name);
+    if(constant == constants_.end()){
+        throw EvaluationAborted(name + " is only known at run time");
+    }
+    return constant->second;
+}
+
+// a const array's elements never change, so they're known wherever it isn't hidden by a local
+const std::vector<BValue> & ConstEvaluator::lookupTable(const std::string & name){
+    bool local = false;
+    if(!frames_.empty()){
+        for(auto & scope : frames_.back()){
+            local = local || scope.count(name);
+        }
+    }
+    else{
+        local = hidden_.count(name);
+    }
+    auto table = tables_.find(name);
+    if(local || table == tables_.end()){
+        throw EvaluationAborted("elements of " + name + " are only known at run time");
+    }
+    return table->second;
+}
+
+void ConstEvaluator::assign(const std::string & name, BValue value){
+    if(!frames_.empty()){
+        Frame & frame = frames_.back();
+        for(auto scope = frame.rbegin(); scope != frame.rend(); ++scope){
+            auto variable = scope->find(name);
+            if(variable != scope->end()){
+                variable->second = value;
+                return;
+            }
+        }
+    }
+    throw EvaluationAborted("assignment to global " + name);
+}
+
+void ConstEvaluator::define(const std::string & name, BValue value){
+    frames_.back().back()[name] = value;
+}
+
+BValue ConstEvaluator::callBuiltin(const std::string & name, const std::vector<BValue> & args){
+    // the builtins' intrinsics have the same semantics as libm's functions
+    std::vector<double> x;
+    for(BValue arg : args){
+        x.push_back(asDouble(arg));
+    }
+    if(name == "sqrt") return doubleValue(std::sqrt(x[0]));
+    if(name == "fabs") return doubleValue(std::fabs(x[0]));
+    if(name == "floor") return doubleValue(std::floor(x[0]));
+    if(name == "exp") return doubleValue(std::exp(x[0]));
+    if(name == "log") return doubleValue(std::log(x[0]));
+    if(name == "sin") return doubleValue(std::sin(x[0]));
+    if(name == "cos") return doubleValue(std::cos(x[0]));
+    if(name == "pow") return doubleValue(std::pow(x[0], x[1]));
+    if(name == "min") return doubleValue(std::fmin(x[0], x[1]));
+    if(name == "max") return doubleValue(std::fmax(x[0], x[1]));
+    if(name == "fma") return doubleValue(std::fma(x[0], x[1], x[2]));
+    throw EvaluationAborted("call of impure function " + name);
+}
+
+BValue ConstEvaluator::call(const std::string & name, const std::vector<BValue> & args){
+    auto function = functions_.find(name);
+    if(function == functions_.end()){
+        return callBuiltin(name, args);
+    }
+    std::pair<std::string, std::vector<uint64_t>> key(name, {});
+    for(BValue arg : args){
+        key.second.push_back(valueBits(arg));
+    }
+    auto known = results_.find(key);
+    if(known != results_.end()){
+        return known->second;
+    }
+    if(frames_.size() >= max_depth_){
+        throw EvaluationAborted("ran out of call depth");
+    }
+
+    FunctionAST * func_node = function->second;
+    frames_.push_back(Frame(1));
+    auto params = func_node->getProto().getArgs();
+    for(int i = 0; i < params.size(); ++i){
+        define(params[i].first, args[i]);
+    }
+    returning_ = false;
+    func_node->bodyAccept(this);
+    BType return_type = func_node->getType().getReturnType();
+    if(!returning_ && return_type != type_void){
+        throw EvaluationAborted(name + " ended without returning");
+    }
+    returning_ = false;
+    frames_.pop_back();
+
+    BValue result = return_type == type_void? BValue() : value_;
+    results_[key] = result;
+    return result;
+}
+
+//---------------------
+// Expressions
+//---------------------
+
+void ConstEvaluator::boolExprAction(BoolExprAST * bool_node){
+    step();
+    value_ = boolValue(bool_node->getValue());
+}
+
+void ConstEvaluator::intExprAction(IntExprAST * int_node){
+    step();
+    value_ = intValue(int_node->getValue());
+}
+
+void ConstEvaluator::doubleExprAction(DoubleExprAST * double_node){
+    step();
+    value_ = doubleValue(double_node->getValue());
+}
+
+void ConstEvaluator::longExprAction(LongExprAST * long_node){
+    step();
+    value_ = longValue(long_node->getValue());
+}
+
+void ConstEvaluator::floatExprAction(FloatExprAST * float_node){
+    step();
+    value_ = floatValue(float_node->getValue());
+}
+
+void ConstEvaluator::unsignedExprAction(UnsignedExprAST * unsigned_node){
+    step();
+    value_ = integerValue(unsigned_node->getType(), unsigned_node->getValue());
+}
+
+void ConstEvaluator::variableExprAction(VariableExprAST * variable_node){
+    step();
+    value_ = lookup(variable_node->getName());
+}
+
+void ConstEvaluator::callExprAction(CallExprAST * call_node){
+    step();
+    if(call_node->isFolded()){
+        value_ = call_node->getFoldedValue();
+        return;
+    }
+    std::string func_name = call_node->getName();
+    if(isRotateBuiltin(func_name)){
+        // llvm.fshl and llvm.fshr of the int with itself
+        call_node->argAcceptAt(this, 0);
+        BValue x = value_;
+        call_node->argAcceptAt(this, 1);
+        unsigned width = typeBytes(x.type) * 8;
+        uint64_t bits = valueBits(x), amount = valueBits(value_) & (width - 1);
+        if(func_name == rotate_right_builtin){
+            amount = (width - amount) & (width - 1);
+        }
+        value_ = integerValue(x.type, amount? bits << amount | bits >> (width - amount) : bits);
+        return;
+    }
+    auto table = call_node->countArgs() == 1? dynamic_cast<const VariableExprAST *>(&call_node->getArg(0)) : nullptr;
+    if(func_name == array_length_builtin && table){
+        value_ = intValue(lookupTable(table->getName()).size());
+        return;
+    }
+    // builtins typed by their arguments (len, vector reductions, bits) and complex numbers are left to run time
+    if(!call_node->getCalleeType().isValid() || isComplexBuiltin(func_name)){
+        throw EvaluationAborted(func_name + " is evaluated at run time");
+    }
+    if(!isPure(func_name)){
+        throw EvaluationAborted("call of impure function " + func_name);
+    }
+    std::vector<BType> arg_types = call_node->getCalleeType().getArgumentTypes();
+    std::vector<BValue> args;
+    for(int i = 0; i < call_node->countArgs(); ++i){
+        call_node->argAcceptAt(this, i);
+        args.push_back(convert(value_, arg_types[i]));
+    }
+    value_ = call(func_name, args);
+}
+
+void ConstEvaluator::unaryExprAction(UnaryExprAST * unary_node){
+    step();
+    unary_node->operandAccept(this);
+    switch(unary_node->getOpCode()){
+    case('-'):{
+        switch(value_.type){
+        case(type_int): value_ = intValue(wrap(-(int64_t) value_.int_value)); break;
+        case(type_long): value_ = longValue((int64_t) -(uint64_t) value_.long_value); break;
+        case(type_float): value_ = floatValue(-value_.float_value); break;
+        default: value_ = doubleValue(-value_.double_value); break;
+        }
+        break;
+    }
+    case('~'):{
+        value_ = integerValue(value_.type, ~valueBits(value_));
+        break;
+    }
+    case('!'):{
+        value_ = boolValue(!value_.bool_value);
+        break;
+    }
+    default:{
+        throw EvaluationAborted(std::string("unknown unary operator ") + unary_node->getOpCode());
+    }
+    }
+}
+
+void ConstEvaluator::binaryExprAction(BinaryExprAST * binary_node){
+    step();
+    char op_code = binary_node->getOpCode();
+    binary_node->lhsAccept(this);
+    BValue lhs = value_;
+    // and, or of bools only evaluate their rhs if the lhs doesn't decide them
+    if((op_code == '&' || op_code == '|') && lhs.type == type_bool){
+        if(lhs.bool_value == (op_code == '|')){
+            value_ = lhs;
+            return;
+        }
+        binary_node->rhsAccept(this);
+        return;
+    }
+    binary_node->rhsAccept(this);
+    BValue rhs = value_;
+
+    if((op_code == '^' || op_code == '~') && lhs.type == type_bool){
+        bool either = op_code == '^'? lhs.bool_value != rhs.bool_value : !(lhs.bool_value || rhs.bool_value);
+        value_ = boolValue(either);
+        return;
+    }
+    if(op_code == '<' || op_code == '>'){
+        BType operand_type = promotedType(lhs.type, rhs.type);
+        lhs = convert(lhs, operand_type);
+        rhs = convert(rhs, operand_type);
+        bool less, greater;
+        switch(operand_type){
+        case(type_int): less = lhs.int_value < rhs.int_value; greater = lhs.int_value > rhs.int_value; break;
+        case(type_long): less = lhs.long_value < rhs.long_value; greater = lhs.long_value > rhs.long_value; break;
+        case(type_uint): less = lhs.uint_value < rhs.uint_value; greater = lhs.uint_value > rhs.uint_value; break;
+        case(type_ulong): less = lhs.ulong_value < rhs.ulong_value; greater = lhs.ulong_value > rhs.ulong_value; break;
+        case(type_float): less = lhs.float_value < rhs.float_value; greater = lhs.float_value > rhs.float_value; break;
+        default: less = lhs.double_value < rhs.double_value; greater = lhs.double_value > rhs.double_value; break;
+        }
+        value_ = boolValue(op_code == '<'? less : greater);
+        return;
+    }
+
+    BType result_type = binary_node->getType();
+    // a shift's amount keeps its own type
+    if(op_code != 'l' && op_code != 'r'){
+        rhs = convert(rhs, result_type);
+    }
+    lhs = convert(lhs, result_type);
+    if(isIntegerType(result_type)){
+        value_ = integerOperation(op_code, result_type, valueBits(lhs), valueBits(rhs), binary_node->getLocStr());
+        return;
+    }
+    switch(result_type){
+    case(type_float):{
+        float l = lhs.float_value, r = rhs.float_value;
+        switch(op_code){
+        case('+'): value_ = floatValue(l + r); return;
+        case('-'): value_ = floatValue(l - r); return;
+        case('*'): value_ = floatValue(l * r); return;
+        case('/'): value_ = floatValue(l / r); return;
+        }
+        break;
+    }
+    default:{
+        double l = lhs.double_value, r = rhs.double_value;
+        switch(op_code){
+        case('+'): value_ = doubleValue(l + r); return;
+        case('-'): value_ = doubleValue(l - r); return;
+        case('*'): value_ = doubleValue(l * r); return;
+        case('/'): value_ = doubleValue(l / r); return;
+        }
+        break;
+    }
+    }
+    throw EvaluationAborted(std::string("unknown binary operator ") + op_code);
+}
+
+// array elements are only known at run time, but for those of const arrays
+void ConstEvaluator::arrayExprAction(ArrayExprAST * array_node){
+    throw EvaluationAborted("arrays are made at run time");
+}
+
+void ConstEvaluator::indexExprAction(IndexExprAST * index_node){
+    step();
+    const std::vector<BValue> & table = lookupTable(index_node->getArrayName());
+    index_node->indexAccept(this);
+    int index = value_.int_value;
+    if(index < 0 || index >= (int) table.size()){
+        throw EvaluationAborted("index " + std::to_string(index) + " of " + index_node->getArrayName() + " out of bounds at " + index_node->getLocStr());
+    }
+    value_ = table[index];
+}
+
+void ConstEvaluator::sliceExprAction(SliceExprAST * slice_node){
+    throw EvaluationAborted("slices view arrays, which are made at run time");
+}
+
+// vectors are left to codegen, whose constant folding covers them
+void ConstEvaluator::vectorExprAction(VectorExprAST * vector_node){
+    throw EvaluationAborted("vectors are made at run time");
+}
+
+// evaluated element by element by the folder, and only ever indexed
+void ConstEvaluator::arrayLiteralExprAction(ArrayLiteralExprAST * literal_node){
+    throw EvaluationAborted("array literals are only indexed");
+}
+
+//----------------------
+// Statements
+//----------------------
+
+void ConstEvaluator::ifStAction(IfStatementAST * if_node){
+    step();
+    if_node->condAccept(this);
+    if(value_.bool_value){
+        if_node->thenAccept(this);
+    }
+    else if(if_node->getHasElse()){
+        if_node->elseAccept(this);
+    }
+}
+
+void ConstEvaluator::forStAction(ForStatementAST * for_node){
+    step();
+    // the induction variables' scope
+    frames_.back().emplace_back();
+    for_node->startAccept(this);
+    while(true){
+        for_node->endAccept(this);
+        if(!value_.bool_value){
+            break;
+        }
+        for_node->bodyAccept(this);
+        if(returning_){
+            break;
+        }
+        for_node->stepAccept(this);
+    }
+    frames_.back().pop_back();
+}
+
+void ConstEvaluator::whileStAction(WhileStatementAST * while_node){
+    step();
+    while(true){
+        while_node->condAccept(this);
+        if(!value_.bool_value){
+            break;
+        }
+        while_node->bodyAccept(this);
+        if(returning_){
+            break;
+        }
+    }
+}
+
+void ConstEvaluator::matchStAction(MatchStatementAST * match_node){
+    step();
+    match_node->subjectAccept(this);
+    int64_t subject = value_.type == type_long? value_.long_value : value_.int_value;
+    // the last segment starting at or before the subject
+    const std::vector<std::pair<int64_t, int>> & segments = match_node->getSegments();
+    auto segment = std::upper_bound(segments.begin(), segments.end(), subject,
+        [](int64_t value, const std::pair<int64_t, int> & start){return value < start.first;});
+    match_node->armAcceptAt(this, std::prev(segment)->second);
+}
+
+void ConstEvaluator::returnStAction(ReturnStatementAST * return_node){
+    step();
+    return_node->returnExprAccept(this);
+    returning_ = true;
+}
+
+void ConstEvaluator::blockStAction(BlockStatementAST * block_node){
+    step();
+    frames_.back().emplace_back();
+    // by index, a recursive call can be evaluating the same block
+    for(int i = 0; i < block_node->countStatements() && !returning_; ++i){
+        block_node->statementAcceptAt(this, i);
+    }
+    frames_.back().pop_back();
+}
+
+void ConstEvaluator::callStAction(CallStatementAST * call_node){
+    step();
+    call_node->callAccept(this);
+}
+
+void ConstEvaluator::assignStAction(AssignStatementAST * assign_node){
+    step();
+    assign_node->valueAccept(this);
+    assign(assign_node->getIdentifier(), convert(value_, assign_node->getDestType()));
+}
+
+void ConstEvaluator::initStAction(InitStatementAST * init_node){
+    step();
+    init_node->valueAccept(this);
+    define(init_node->getIdentifier(), convert(value_, init_node->getType()));
+}
+
+void ConstEvaluator::indexAssignStAction(IndexAssignStatementAST * index_assign_node){
+    throw EvaluationAborted("array elements are only known at run time");
+}
+
+// Only expressions and function bodies are evaluated
+
+void ConstEvaluator::prototypeAction(PrototypeAST * proto_node){}
+void ConstEvaluator::functionAction(FunctionAST * func_node){}
+void ConstEvaluator::topLevelsAction(TopLevels * top_levels_node){}
+void ConstEvaluator::funcDefsAction(FuncDefs * func_defs_node){}
+void ConstEvaluator::programAction(BProgram * program_node){}
+
+//-----------------------
+// Folder
+//-----------------------
+
+void ConstFolder::fold(std::shared_ptr<BProgram> program){
+    program->accept(this);
+}
+
+std::set<std::string> ConstFolder::localNames(){
+    std::set<std::string> names;
+    for(auto & scope : scopes_){
+        names.insert(scope.begin(), scope.end());
+    }
+    return names;
+}
+
+void ConstFolder::boolExprAction(BoolExprAST * bool_node){}
+void ConstFolder::intExprAction(IntExprAST * int_node){}
+void ConstFolder::doubleExprAction(DoubleExprAST * double_node){}
+void ConstFolder::longExprAction(LongExprAST * long_node){}
+void ConstFolder::floatExprAction(FloatExprAST * float_node){}
+void ConstFolder::unsignedExprAction(UnsignedExprAST * unsigned_node){}
+void ConstFolder::variableExprAction(VariableExprAST * variable_node){}
+
+void ConstFolder::callExprAction(CallExprAST * call_node){
+    // innermost calls first, so a call with folded arguments is evaluated from their values
+    for(int i = 0; i < call_node->countArgs(); ++i){
+        call_node->argAcceptAt(this, i);
+    }
+    if(call_node->getType() == type_void || !evaluator_.isPure(call_node->getName())){
+        return;
+    }
+    evaluator_.setHidden(localNames());
+    BValue value;
+    if(evaluator_.evaluate([call_node](ASTVisitor * v){call_node->accept(v);}, value)){
+        spdlog::debug("Folded call of {0} at {1}", call_node->getName(), call_node->getLocStr());
+        call_node->setFoldedValue(value);
+    }
+    else{
+        spdlog::debug("Call of {0} at {1} left to run time: {2}", call_node->getName(), call_node->getLocStr(), evaluator_.getFailure());
+    }
+}
+
+void ConstFolder::unaryExprAction(UnaryExprAST * unary_node){
+    unary_node->operandAccept(this);
+}
+
+void ConstFolder::binaryExprAction(BinaryExprAST * binary_node){
+    binary_node->lhsAccept(this);
+    binary_node->rhsAccept(this);
+}
+
+void ConstFolder::arrayExprAction(ArrayExprAST * array_node){
+    array_node->lengthAccept(this);
+}
+
+void ConstFolder::indexExprAction(IndexExprAST * index_node){
+    index_node->indexAccept(this);
+}
+
+void ConstFolder::sliceExprAction(SliceExprAST * slice_node){
+    if(slice_node->hasStart()){
+        slice_node->startAccept(this);
+    }
+    if(slice_node->hasEnd()){
+        slice_node->endAccept(this);
+    }
+    if(slice_node->hasStride()){
+        slice_node->strideAccept(this);
+    }
+}
+
+void ConstFolder::vectorExprAction(VectorExprAST * vector_node){
+    for(int i = 0; i < vector_node->countLanes(); ++i){
+        vector_node->laneAcceptAt(this, i);
+    }
+}
+
+// a lookup table's elements are all known at compile time, as the element type
+void ConstFolder::arrayLiteralExprAction(ArrayLiteralExprAST * literal_node){
+    BType element_type = elementType(literal_node->getType());
+    std::vector<BValue> elements;
+    for(int i = 0; i < literal_node->countElements(); ++i){
+        literal_node->elementAcceptAt(this, i);
+        BValue value;
+        std::string failure;
+        evaluator_.setHidden(localNames());
+        if(evaluator_.evaluate([literal_node, i](ASTVisitor * v){literal_node->elementAcceptAt(v, i);}, value, table_element_steps)){
+            try{
+                elements.push_back(convert(value, element_type));
+                continue;
+            }catch(EvaluationAborted & e){
+                failure = e.what();
+            }
+        }
+        else{
+            failure = evaluator_.getFailure();
+        }
+        spdlog::error("Element {0:d} of array literal at {1} is not known at compile time: {2}", i, literal_node->getLocStr(), failure);
+        throw BError();
+    }
+    literal_node->setFoldedElements(elements);
+}
+
+void ConstFolder::ifStAction(IfStatementAST * if_node){
+    if_node->condAccept(this);
+    if_node->thenAccept(this);
+    if(if_node->getHasElse()){
+        if_node->elseAccept(this);
+    }
+}
+
+void ConstFolder::forStAction(ForStatementAST * for_node){
+    scopes_.emplace_back();
+    for_node->startAccept(this);
+    for_node->endAccept(this);
+    for_node->stepAccept(this);
+    for_node->bodyAccept(this);
+    scopes_.pop_back();
+}
+
+void ConstFolder::whileStAction(WhileStatementAST * while_node){
+    while_node->condAccept(this);
+    while_node->bodyAccept(this);
+}
+
+void ConstFolder::matchStAction(MatchStatementAST * match_node){
+    match_node->subjectAccept(this);
+    int arms = match_node->countArms() + match_node->hasElse();
+    for(int i = 0; i < arms; ++i){
+        match_node->armAcceptAt(this, i);
+    }
+    // when every arm just returns a value known at compile time, the match can be a lookup
+    std::vector<BValue> values;
+    for(int i = 0; i < arms; ++i){
+        auto block = dynamic_cast<const BlockStatementAST *>(&match_node->getArm(i));
+        if(!block || block->countStatements() != 1 || !dynamic_cast<const ReturnStatementAST *>(&block->getStatementAt(0))){
+            return;
+        }
+        BValue value;
+        evaluator_.setHidden(localNames());
+        if(!evaluator_.evaluateReturn([match_node, i](ASTVisitor * v){match_node->armAcceptAt(v, i);}, value)){
+            return;
+        }
+        values.push_back(value);
+    }
+    match_node->setReturnedValues(values);
+}
+
+void ConstFolder::returnStAction(ReturnStatementAST * return_node){
+    return_node->returnExprAccept(this);
+}
+
+void ConstFolder::blockStAction(BlockStatementAST * block_node){
+    scopes_.emplace_back();
+    block_node->resetStatementIndex();
+    while(block_node->anotherStatement()){
+        block_node->statementAcceptOne(this);
+    }
+    scopes_.pop_back();
+}
+
+void ConstFolder::callStAction(CallStatementAST * call_node){
+    call_node->callAccept(this);
+}
+
+void ConstFolder::assignStAction(AssignStatementAST * assign_node){
+    assign_node->valueAccept(this);
+}
+
+void ConstFolder::initStAction(InitStatementAST * init_node){
+    if(!init_node->isGlobal()){
+        scopes_.back().push_back(init_node->getIdentifier());
+        init_node->valueAccept(this);
+        return;
+    }
+    if(init_node->isConst() != (phase_ == fp_constants)){
+        // const globals are folded before anything else, the others with the top levels
+        return;
+    }
+    init_node->valueAccept(this);
+    if(!init_node->isConst()){
+        return;
+    }
+    auto table = dynamic_cast<const ArrayLiteralExprAST *>(&init_node->getAssignment().getValue());
+    if(table){
+        evaluator_.addTable(init_node->getIdentifier(), table->getFoldedElements());
+        return;
+    }
+    BValue value;
+    if(!evaluator_.evaluate([init_node](ASTVisitor * v){init_node->valueAccept(v);}, value)){
+        spdlog::warn("const {0} at {1} is evaluated at run time: {2}", init_node->getIdentifier(), init_node->getLocStr(), evaluator_.getFailure());
+        return;
+    }
+    try{
+        evaluator_.addConstant(init_node->getIdentifier(), convert(value, init_node->getType()));
+    }catch(EvaluationAborted & e){
+        spdlog::warn("const {0} at {1} is evaluated at run time: {2}", init_node->getIdentifier(), init_node->getLocStr(), e.what());
+    }
+}
+
+void ConstFolder::indexAssignStAction(IndexAssignStatementAST * index_assign_node){
+    index_assign_node->elementAccept(this);
+    index_assign_node->valueAccept(this);
+}
+
+void ConstFolder::prototypeAction(PrototypeAST * proto_node){
+    std::vector<std::string> params;
+    for(auto & param : proto_node->getArgs()){
+        params.push_back(param.first);
+    }
+    scopes_.push_back(params);
+}
+
+void ConstFolder::functionAction(FunctionAST * func_node){
+    switch(phase_){
+    case(fp_functions):{
+        if(func_node->isPure()){
+            evaluator_.addFunction(func_node);
+        }
+        break;
+    }
+    case(fp_bodies):{
+        // the parameters' scope
+        func_node->protoAccept(this);
+        func_node->bodyAccept(this);
+        scopes_.pop_back();
+        break;
+    }
+    default:{
+        spdlog::warn("function folded in unexpected phase {0:d}", (int) phase_);
+    }
+    }
+}
+
+void ConstFolder::topLevelsAction(TopLevels * top_levels_node){
+    if(phase_ == fp_constants){
+        top_levels_node->globalsAllAccept(this);
+    }
+    else{
+        top_levels_node->statementsAllAccept(this);
+    }
+}
+
+void ConstFolder::funcDefsAction(FuncDefs * func_defs_node){
+    func_defs_node->functionsAllAccept(this);
+}
+
+void ConstFolder::programAction(BProgram * program_node){
+    // 1 - find the pure functions the evaluator can call
+    // 2 - evaluate the const globals in order, so later ones and functions can use them
+    // 3 - fold calls in the function bodies
+    // 4 - fold calls in the other top level statements
+    scopes_.emplace_back();
+    phase_ = fp_functions;
+    program_node->funcDefsAccept(this);
+    phase_ = fp_constants;
+    program_node->topLevelsAccept(this);
+    phase_ = fp_bodies;
+    program_node->funcDefsAccept(this);
+    phase_ = fp_top_levels;
+    program_node->topLevelsAccept(this);
+    scopes_.pop_back();
+}
+
+} // namespace ctfe
+} // namespace bassoon
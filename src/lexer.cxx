@@ -7,6 +7,9 @@ SourceLoc Lexer::lexer_loc_ = {1,0};
 std::string Lexer::identifier_ = "";
 int Lexer::int_val_ = 0;
 double Lexer::double_val_ = 0.0;
+int64_t Lexer::long_val_ = 0;
+float Lexer::float_val_ = 0.0f;
+uint64_t Lexer::unsigned_val_ = 0;
 bool Lexer::bool_val_ = false;
 std::function<int()> Lexer::bassoon_getchar_ = getchar;
 
@@ -43,8 +46,40 @@ int Lexer::check_keyword(std::string candidate_token){
         return tok_int;
     if (identifier_ == "double")
         return tok_double;
+    if (identifier_ == "long")
+        return tok_long;
+    if (identifier_ == "uint")
+        return tok_uint;
+    if (identifier_ == "ulong")
+        return tok_ulong;
+    if (identifier_ == "float")
+        return tok_float;
     if (identifier_ == "bool")
         return tok_bool;
+    if (identifier_ == "complex")
+        return tok_complex;
+    if (identifier_ == "record")
+        return tok_record;
+    if (identifier_ == "aos")
+        return tok_aos;
+    if (identifier_ == "soa")
+        return tok_soa;
+    if (identifier_ == "aosoa")
+        return tok_aosoa;
+    if (identifier_ == "array")
+        return tok_array;
+    if (identifier_ == "slice")
+        return tok_slice;
+    if (identifier_ == "strided")
+        return tok_strided;
+    if (identifier_ == "bits")
+        return tok_bits;
+    if (identifier_ == "vec2")
+        return tok_vec2;
+    if (identifier_ == "vec4")
+        return tok_vec4;
+    if (identifier_ == "vec8")
+        return tok_vec8;
     
     if (identifier_ == "true")
         return tok_true;
@@ -59,6 +94,12 @@ int Lexer::check_keyword(std::string candidate_token){
         return tok_for;
     if (identifier_ == "while")
         return tok_while;
+    if (identifier_ == "match")
+        return tok_match;
+    if (identifier_ == "case")
+        return tok_case;
+    if (identifier_ == "to")
+        return tok_to;
 
     if (identifier_ == "not")
         return tok_not;
@@ -70,6 +111,24 @@ int Lexer::check_keyword(std::string candidate_token){
         return tok_xor;
     if (identifier_ == "nor")
         return tok_nor;
+
+    if (identifier_ == "multiversion")
+        return tok_multiversion;
+    if (identifier_ == "export")
+        return tok_export;
+    if (identifier_ == "tailrec")
+        return tok_tailrec;
+    if (identifier_ == "fastmath")
+        return tok_fastmath;
+    if (identifier_ == "contract")
+        return tok_contract;
+    if (identifier_ == "strict")
+        return tok_strict;
+    if (identifier_ == "memo")
+        return tok_memo;
+
+    if (identifier_ == "const")
+        return tok_const;
     return tok_identifier;
 }
 
@@ -88,23 +147,58 @@ int Lexer::nextTok(){
         return check_keyword(identifier_);
     }
 
-    // Numbers [0-9]*.[0-9]*
+    // Numbers [0-9]*.[0-9]*, a '.' not followed by a digit selects a field
     if (isdigit(last_character) || last_character == '.'){
         bool has_decimal = false;
         std::string num_string;
+        if (last_character == '.'){
+            last_character = nextChar();
+            if (!isdigit(last_character))
+                return '.';
+            has_decimal = true;
+            num_string = ".";
+        }
         do {
             has_decimal = has_decimal || last_character == '.';
             num_string += last_character;
             last_character = nextChar();
         } while (isdigit(last_character) || (last_character == '.' && !has_decimal));
+
+        // 0x prefixes hex digits, which are the bits of an integer of the suffix's type
+        int base = 10;
+        if (num_string == "0" && (last_character == 'x' || last_character == 'X')){
+            base = 16;
+            num_string = "";
+            while (isxdigit(last_character = nextChar()))
+                num_string += last_character;
+        }
         
+        // suffixes: 10u is a uint, 10uL a ulong, 10L a long, 0.5f (or 2f) a float
+        if ((last_character == 'u' || last_character == 'U') && !has_decimal){
+            last_character = nextChar();
+            unsigned_val_ = strtoull(num_string.c_str(), nullptr, base);
+            if (last_character == 'L' || last_character == 'l'){
+                last_character = nextChar();
+                return tok_number_ulong;
+            }
+            return tok_number_uint;
+        }
+        if ((last_character == 'L' || last_character == 'l') && !has_decimal){
+            last_character = nextChar();
+            long_val_ = strtoull(num_string.c_str(), nullptr, base);
+            return tok_number_long;
+        }
+        if ((last_character == 'f' || last_character == 'F') && base == 10){
+            last_character = nextChar();
+            float_val_ = strtof(num_string.c_str(), nullptr);
+            return tok_number_float;
+        }
         if (has_decimal){
             double_val_ = strtod(num_string.c_str(),nullptr);
             return tok_number_double;
         }
         else{
-            // can specify base here so can allow 0x or 0b
-            int_val_ = strtol(num_string.c_str(), nullptr, 10);
+            int_val_ = strtoul(num_string.c_str(), nullptr, base);
             return tok_number_int;
         } 
     }
@@ -124,9 +218,13 @@ int Lexer::nextTok(){
     if (last_character == EOF)
         return tok_eof;
 
-    // Otherwise the character's ascii code
+    // Otherwise the character's ascii code, but for the shifts << and >>
     int this_character = last_character;
     last_character = nextChar();
+    if ((this_character == '<' || this_character == '>') && last_character == this_character){
+        last_character = nextChar();
+        return this_character == '<' ? tok_shl : tok_shr;
+    }
     return this_character;
 }
 
@@ -141,6 +239,15 @@ double Lexer::getDouble(){
 int Lexer::getInt(){
     return int_val_;
 }
+int64_t Lexer::getLong(){
+    return long_val_;
+}
+float Lexer::getFloat(){
+    return float_val_;
+}
+uint64_t Lexer::getUnsigned(){
+    return unsigned_val_;
+}
 
 
 SourceLoc Lexer::getLoc(){
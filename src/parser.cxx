@@ -1,14 +1,17 @@
 #include "parser.hxx"
+#include "builtins.hxx"
 #include "lexer.hxx"
 #include "log_error.hxx"
 #include "tokens.hxx"
 #include "exceptions.hxx"
 
+#include <algorithm>
+
 namespace bassoon
 {
 
 int Parser::current_token_ = ' ';
-std::map<char,int> Parser::bin_op_precedence_ = std::map<char,int>({{'|',3}, {'&',4}, {'<', 5}, {'>',6}, {'+', 10}, {'-', 20}, {'/', 30}, {'*', 40}});
+std::map<char,int> Parser::bin_op_precedence_ = std::map<char,int>({{'|',3}, {'^',3}, {'~',3}, {'&',4}, {'<', 5}, {'>',6}, {'l', 8}, {'r', 8}, {'+', 10}, {'-', 20}, {'/', 30}, {'%', 30}, {'*', 40}});
 std::function<int()> Parser::bassoon_nextTok_ = Lexer::nextTok;
 
 
@@ -48,11 +51,12 @@ std::unique_ptr<FunctionAST> LogErrorF(std::string s){
 }
 
 int Parser::getTokPrecedence(){
+    int op_code = tokToOperator(current_token_);
     // some token, not an operator
-    if(!isascii(current_token_))
+    if(!isascii(op_code))
         return -1;
 
-    int tok_prec = Parser::bin_op_precedence_[Parser::current_token_];
+    int tok_prec = Parser::bin_op_precedence_[op_code];
     // set to -1 if not an entry
     if (tok_prec <= 0)
         tok_prec = -1; 
@@ -74,16 +78,17 @@ std::unique_ptr<ExprAST> Parser::parseUnary(){
     logParseAndToken("Unary");
     SourceLoc unary_loc = Lexer::getLoc();
     // !isascii(current_token_) 
-    // means guaranteed to be a keyword and hence some other expression.
-    if (!isascii(current_token_) || current_token_ == '('){
+    // means guaranteed to be a keyword (other than not) and hence some other expression.
+    int op_code = tokToOperator(current_token_);
+    if (!isascii(op_code) || current_token_ == '(' || current_token_ == '['){
         logParseAndToken("unary->primary");
         return parsePrimary();
     }
     // otherwise it must be an operator
-    int op_code = current_token_;
+    bool word = tokIsWordOperator(current_token_);
     getNextToken();
     if (auto operand = parseUnary())
-        return std::make_unique<UnaryExprAST>(unary_loc, op_code, std::move(operand));
+        return std::make_unique<UnaryExprAST>(unary_loc, op_code, std::move(operand), word);
     
     return nullptr;
 }
@@ -104,8 +109,33 @@ std::unique_ptr<ExprAST> Parser::parsePrimary(){
             return parseIntExpr();
         case tok_number_double:
             return parseDoubleExpr();
+        case tok_number_long:
+            return parseLongExpr();
+        case tok_number_float:
+            return parseFloatExpr();
+        case tok_number_uint:
+        case tok_number_ulong:
+            return parseUnsignedExpr();
         case '(':
             return parseParenExpr();
+        case tok_bool:
+        case tok_int:
+        case tok_double:
+        case tok_long:
+        case tok_float:
+        case tok_uint:
+        case tok_ulong:
+            return parseArrayExpr();
+        case tok_vec2:
+        case tok_vec4:
+        case tok_vec8:
+            return parseVectorExpr();
+        case tok_complex:
+            return parseComplexExpr();
+        case tok_bits:
+            return parseBitsExpr();
+        case '[':
+            return parseArrayLiteralExpr();
     }
 }
 
@@ -124,7 +154,8 @@ std::unique_ptr<ExprAST> Parser::parseBinaryOpRHS(int expr_precedence, std::uniq
             return lhs;
         }
         // we are in a binop
-        int bin_op = current_token_;
+        int bin_op = tokToOperator(current_token_);
+        bool word = tokIsWordOperator(current_token_);
         SourceLoc bin_loc = Lexer::getLoc();
         getNextToken(); // consume the operator
         logParseAndToken("bin op");
@@ -140,7 +171,7 @@ std::unique_ptr<ExprAST> Parser::parseBinaryOpRHS(int expr_precedence, std::uniq
             if (!rhs)
                 return nullptr;
         }
-        lhs = std::make_unique<BinaryExprAST> (bin_loc, bin_op, std::move(lhs), std::move(rhs));
+        lhs = std::make_unique<BinaryExprAST> (bin_loc, bin_op, std::move(lhs), std::move(rhs), word);
     }
 }
 
@@ -194,19 +225,219 @@ std::unique_ptr<ExprAST> Parser::parseDoubleExpr(){
     return nullptr;
 }
 
+std::unique_ptr<ExprAST> Parser::parseLongExpr(){
+    logParseAndToken("Long");
+    SourceLoc long_loc = Lexer::getLoc();
+    if (current_token_ == tok_number_long){
+        int64_t long_val = Lexer::getLong();
+        getNextToken(); // consume the number
+        return std::make_unique<LongExprAST>(long_loc, long_val);
+    }
+    return nullptr;
+}
+
+std::unique_ptr<ExprAST> Parser::parseFloatExpr(){
+    logParseAndToken("Float");
+    SourceLoc float_loc = Lexer::getLoc();
+    if (current_token_ == tok_number_float){
+        float float_val = Lexer::getFloat();
+        getNextToken(); // consume the number
+        return std::make_unique<FloatExprAST>(float_loc, float_val);
+    }
+    return nullptr;
+}
+
+std::unique_ptr<ExprAST> Parser::parseUnsignedExpr(){
+    logParseAndToken("Unsigned");
+    SourceLoc unsigned_loc = Lexer::getLoc();
+    BType type = current_token_ == tok_number_ulong? type_ulong : type_uint;
+    uint64_t unsigned_val = Lexer::getUnsigned();
+    getNextToken(); // consume the number
+    return std::make_unique<UnsignedExprAST>(unsigned_loc, type, unsigned_val);
+}
+
+std::unique_ptr<ExprAST> Parser::parseVectorExpr(){
+    // vecN of type(lane, ...), or vecN of type[length] for an array of them
+    logParseAndToken("Vector");
+    SourceLoc vector_loc = Lexer::getLoc();
+    BType vector_type = parseType();
+    if(vector_type == not_a_type)
+        return nullptr;
+    if(current_token_ == '['){
+        auto length = parseIndex();
+        if(!length)
+            return nullptr;
+        return std::make_unique<ArrayExprAST>(vector_loc, vector_type, std::move(length));
+    }
+    if(current_token_ != '(')
+        return LogErrorE("Expected '(' and the lanes of a vector after its type");
+    getNextToken(); // consume '('
+
+    std::vector<std::unique_ptr<ExprAST>> lanes;
+    while(true){
+        auto lane = parseExpression();
+        if(!lane)
+            return nullptr;
+        lanes.push_back(std::move(lane));
+        if(current_token_ == ')')
+            break;
+        if(current_token_ != ',')
+            return LogErrorE("Expected ',' or ')' after a lane of a vector");
+        getNextToken(); // consume ','
+    }
+    getNextToken(); // consume ')'
+    return std::make_unique<VectorExprAST>(vector_loc, vector_type, std::move(lanes));
+}
+
+std::unique_ptr<ExprAST> Parser::parseComplexExpr(){
+    // complex(re, im), a call of the builtin making one, or complex[length] for an array of them
+    logParseAndToken("Complex");
+    SourceLoc complex_loc = Lexer::getLoc();
+    getNextToken(); // consume complex
+    if(current_token_ == '['){
+        auto length = parseIndex();
+        if(!length)
+            return nullptr;
+        return std::make_unique<ArrayExprAST>(complex_loc, type_complex, std::move(length));
+    }
+    if(current_token_ != '(')
+        return LogErrorE("Expected '(' and the parts of a complex number, or '[' and a length, after complex");
+    std::vector<std::unique_ptr<ExprAST>> parts;
+    if(!parseArgs(parts))
+        return nullptr;
+    return std::make_unique<CallExprAST>(complex_loc, complex_builtin, std::move(parts));
+}
+
+std::unique_ptr<ExprAST> Parser::parseBitsExpr(){
+    // bits[length], an array of that many flags
+    logParseAndToken("Bits");
+    SourceLoc bits_loc = Lexer::getLoc();
+    getNextToken(); // consume bits
+    if(current_token_ != '[')
+        return LogErrorE("Expected '[' and a length after bits");
+    auto length = parseIndex();
+    if(!length)
+        return nullptr;
+    return std::make_unique<ArrayExprAST>(bits_loc, type_bit, std::move(length));
+}
+
+std::unique_ptr<ExprAST> Parser::parseArrayExpr(){
+    // type[length]
+    logParseAndToken("Array");
+    SourceLoc array_loc = Lexer::getLoc();
+    BType element_type = tokToType(current_token_);
+    getNextToken(); // consume element type
+
+    if(current_token_ != '[')
+        return LogErrorE("Expected '[' after the element type of a new array");
+    auto length = parseIndex();
+    if(!length)
+        return nullptr;
+    return std::make_unique<ArrayExprAST>(array_loc, element_type, std::move(length));
+}
+
+std::unique_ptr<ExprAST> Parser::parseArrayLiteralExpr(){
+    // [expr, expr, ...], the elements of a lookup table
+    logParseAndToken("ArrayLiteral");
+    SourceLoc literal_loc = Lexer::getLoc();
+    getNextToken(); // consume '['
+    if(current_token_ == ']')
+        return LogErrorE("Expected the elements of an array literal after '['");
+
+    std::vector<std::unique_ptr<ExprAST>> elements;
+    while(true){
+        auto element = parseExpression();
+        if(!element)
+            return nullptr;
+        elements.push_back(std::move(element));
+        if(current_token_ == ']')
+            break;
+        if(current_token_ != ',')
+            return LogErrorE("Expected ',' or ']' after an element of an array literal");
+        getNextToken(); // consume ','
+    }
+    getNextToken(); // consume ']'
+    return std::make_unique<ArrayLiteralExprAST>(literal_loc, std::move(elements));
+}
+
+std::unique_ptr<ExprAST> Parser::parseIndex(){
+    // [expr]
+    logParseAndToken("Index");
+    getNextToken(); // consume '['
+    auto index = parseExpression();
+    if(!index)
+        return nullptr;
+    if(current_token_ != ']')
+        return LogErrorE("Expected ']' to end index");
+    getNextToken(); // consume ']'
+    return index;
+}
+
 std::unique_ptr<ExprAST> Parser::parseIdentifierExpr(){
     logParseAndToken("Identifier");
     SourceLoc identifier_loc = Lexer::getLoc();
     std::string identifier_name = Lexer::getIdentifier();
     getNextToken(); // move onto '(' or next token if not a call
+    if(current_token_ == '['){
+        getNextToken(); // consume '['
+        std::unique_ptr<ExprAST> index;
+        if(current_token_ != ':'){
+            index = parseExpression();
+            if(!index)
+                return nullptr;
+        }
+        if(current_token_ == ':')
+            return parseSlice(identifier_loc, identifier_name, std::move(index));
+        if(current_token_ != ']')
+            return LogErrorE("Expected ']' to end index");
+        getNextToken(); // consume ']'
+        // Record[length] makes an array of them, laid out as its variable's type says
+        BType record = recordNamed(identifier_name);
+        if(record != not_a_type)
+            return std::make_unique<ArrayExprAST>(identifier_loc, record, std::move(index));
+        std::string field;
+        if(!parseField(field))
+            return nullptr;
+        return std::make_unique<IndexExprAST>(identifier_loc, identifier_name, std::move(index), field);
+    }
     if(current_token_ != '('){
         //getNextToken(); // consume the identifier.
         return std::make_unique<VariableExprAST>(identifier_loc, identifier_name);
     }
        
-    getNextToken(); // consume '('
     logParseAndToken("IdIsFun");
     std::vector<std::unique_ptr<ExprAST>> args;
+    if(!parseArgs(args))
+        return nullptr;
+    return std::make_unique<CallExprAST>(identifier_loc, identifier_name, std::move(args));
+}
+
+std::unique_ptr<ExprAST> Parser::parseSlice(SourceLoc slice_loc, const std::string & array, std::unique_ptr<ExprAST> start){
+    // the rest of xs[start:end] or xs[start:end:stride], either bound can be left out
+    logParseAndToken("Slice");
+    getNextToken(); // consume ':'
+    std::unique_ptr<ExprAST> end;
+    if(current_token_ != ']' && current_token_ != ':'){
+        end = parseExpression();
+        if(!end)
+            return nullptr;
+    }
+    std::unique_ptr<ExprAST> stride;
+    if(current_token_ == ':'){
+        getNextToken(); // consume ':'
+        stride = parseExpression();
+        if(!stride)
+            return nullptr;
+    }
+    if(current_token_ != ']')
+        return LogErrorE("Expected ']' to end slice");
+    getNextToken(); // consume ']'
+    return std::make_unique<SliceExprAST>(slice_loc, array, std::move(start), std::move(end), std::move(stride));
+}
+
+bool Parser::parseArgs(std::vector<std::unique_ptr<ExprAST>> & args){
+    // (arg, ...) of a call
+    getNextToken(); // consume '('
     bool expecting_another_arg = false;
     if (current_token_ != ')'){
         logParseAndToken("AnArg");
@@ -217,8 +448,8 @@ std::unique_ptr<ExprAST> Parser::parseIdentifierExpr(){
             }
             else{
                 if (expecting_another_arg)
-                    return LogErrorE("Expected arg after ','");
-                return nullptr;
+                    LogErrorE("Expected arg after ','");
+                return false;
             }
             
             if (current_token_ == ')')
@@ -232,7 +463,128 @@ std::unique_ptr<ExprAST> Parser::parseIdentifierExpr(){
         }
     }
     getNextToken(); // consume ')'
-    return std::make_unique<CallExprAST>(identifier_loc, identifier_name, std::move(args));
+    return true;
+}
+
+bool Parser::parseField(std::string & field){
+    // [.field] after an index
+    if(current_token_ != '.')
+        return true;
+    getNextToken(); // consume '.'
+    if(current_token_ != tok_identifier){
+        LogErrorE("Expected a field name after '.'");
+        return false;
+    }
+    field = Lexer::getIdentifier();
+    getNextToken(); // consume field name
+    return true;
+}
+
+int Parser::parseLayout(){
+    // [aos | soa | aosoa(N)] after the record type of an array, -1 if malformed
+    logParseAndToken("Layout");
+    switch(current_token_){
+    case tok_aos:
+        getNextToken(); // consume aos
+        return 0;
+    case tok_soa:
+        getNextToken(); // consume soa
+        return type_soa;
+    case tok_aosoa:{
+        getNextToken(); // consume aosoa
+        if(current_token_ != '('){
+            spdlog::error("Error: Expected '(' and the records per block after aosoa");
+            return -1;
+        }
+        getNextToken(); // consume '('
+        int records_per_block = Lexer::getInt();
+        if(current_token_ != tok_number_int || records_per_block < 2 || records_per_block > 128
+            || (records_per_block & (records_per_block - 1))){
+            spdlog::error("Error: Expected a power of two from 2 to 128 records per aosoa block");
+            return -1;
+        }
+        getNextToken(); // consume N
+        if(current_token_ != ')'){
+            spdlog::error("Error: Expected ')' after the records per aosoa block");
+            return -1;
+        }
+        getNextToken(); // consume ')'
+        return aosoaLayout(records_per_block);
+    }
+    default:
+        return 0;
+    }
+}
+
+BType Parser::parseType(){
+    // type, vecN of type, bits, or an array or slice of a type or vector, not_a_type if none
+    logParseAndToken("Type");
+    if(current_token_ == tok_array){
+        getNextToken(); // consume array
+        if(current_token_ != tok_of){
+            spdlog::error("Error: Expected 'of' after array");
+            return not_a_type;
+        }
+        getNextToken(); // consume of
+        BType element_type = parseType();
+        if(element_type == not_a_type || isArrayType(element_type)){
+            spdlog::error("Error: Expected the element type of an array");
+            return not_a_type;
+        }
+        if(!isRecordType(element_type))
+            return arrayOf(element_type);
+        int layout = parseLayout();
+        if(layout < 0)
+            return not_a_type;
+        return arrayOf(element_type, layout);
+    }
+    if(current_token_ == tok_slice){
+        getNextToken(); // consume slice
+        if(current_token_ != tok_of){
+            spdlog::error("Error: Expected 'of' after slice");
+            return not_a_type;
+        }
+        getNextToken(); // consume of
+        BType element_type = parseType();
+        if(element_type == not_a_type || isArrayType(element_type) || isRecordType(element_type)){
+            spdlog::error("Error: Expected the element type of a slice, which can't be a record");
+            return not_a_type;
+        }
+        bool strided = current_token_ == tok_strided;
+        if(strided)
+            getNextToken(); // consume strided
+        return sliceOf(element_type, strided);
+    }
+    if(current_token_ == tok_bits){
+        getNextToken(); // consume bits
+        return type_bits;
+    }
+    if(current_token_ == tok_identifier){
+        BType record = recordNamed(Lexer::getIdentifier());
+        if(record != not_a_type)
+            getNextToken(); // consume record name
+        return record;
+    }
+    if(int lanes = tokToLanes(current_token_)){
+        getNextToken(); // consume vecN
+        if(current_token_ != tok_of){
+            spdlog::error("Error: Expected 'of' after vec{0}", lanes);
+            return not_a_type;
+        }
+        getNextToken(); // consume of
+        if(!tokIsType(current_token_) || current_token_ == tok_complex || current_token_ == tok_uint || current_token_ == tok_ulong){
+            spdlog::error("Error: Expected the lane type of a vector, bool, int, long, float or double");
+            return not_a_type;
+        }
+        BType lane_type = tokToType(current_token_);
+        getNextToken(); // consume lane type
+        return vectorOf(lane_type, lanes);
+    }
+    if(!tokIsType(current_token_))
+        return not_a_type;
+    BType type = tokToType(current_token_);
+    getNextToken(); // consume type
+    return type;
 }
 
 // ----------------------
@@ -254,6 +606,10 @@ std::unique_ptr<StatementAST> Parser::parseStatement(){
         return parseForStatement();
     case tok_while:
         return parseWhileStatement();
+    case tok_match:
+        return parseMatchStatement();
+    case tok_const:
+        return parseConstStatement();
     default:
         fprintf(stderr,"location %i", Lexer::getLoc().line);
         return LogErrorS("Unexpected token to start statement.");
@@ -295,6 +651,8 @@ std::unique_ptr<StatementAST> Parser::parseIdentifierStatement(){
         return parseInitStatement(id_loc, id);
     case '=':
         return parseAssignStatement(id_loc, id);
+    case '[':
+        return parseIndexAssignStatement(id_loc, id);
     default:
         return LogErrorS("Statement contains unexpected token after identifier.");
     }
@@ -346,7 +704,22 @@ std::unique_ptr<StatementAST> Parser::parseCallStatement(SourceLoc id_loc, std::
     return std::make_unique<CallStatementAST>(id_loc, std::move(call_expr));
 }
 
-std::unique_ptr<StatementAST> Parser::parseInitStatement(SourceLoc id_loc, std::string id){
+std::unique_ptr<StatementAST> Parser::parseConstStatement(){
+    // const id of type = value;
+    logParseAndToken("Const");
+    if (current_token_ != tok_const)
+        return LogErrorS("Expect current token to be tok_const at start of parseConst");
+    getNextToken(); // consume const
+
+    if (current_token_ != tok_identifier)
+        return LogErrorS("Expected an identifier after const");
+    SourceLoc id_loc = Lexer::getLoc();
+    std::string id = Lexer::getIdentifier();
+    getNextToken(); // consume identifier
+    return parseInitStatement(id_loc, id, true);
+}
+
+std::unique_ptr<StatementAST> Parser::parseInitStatement(SourceLoc id_loc, std::string id, bool is_const){
     // of type = value;
     logParseAndToken("Init");
 
@@ -354,10 +727,9 @@ std::unique_ptr<StatementAST> Parser::parseInitStatement(SourceLoc id_loc, std::
         return LogErrorS("Expect current token to be tok_of at start of parseInit");
     getNextToken(); // consume of
 
-    if(!tokIsType(current_token_))
+    BType type = parseType();
+    if(type == not_a_type)
         return LogErrorS("Expected a type after of in variable initialisation");
-    BType type = tokToType(current_token_);
-    getNextToken(); // consume type
 
     SourceLoc assign_loc = Lexer::getLoc();
     if(current_token_ != '=')
@@ -374,7 +746,7 @@ std::unique_ptr<StatementAST> Parser::parseInitStatement(SourceLoc id_loc, std::
     getNextToken(); // consume ';'
 
     auto assignment = std::make_unique<AssignStatementAST>(assign_loc, id, std::move(value_expr));
-    return std::make_unique<InitStatementAST>(id_loc, id, type, std::move(assignment));
+    return std::make_unique<InitStatementAST>(id_loc, id, type, std::move(assignment), is_const);
 }
 
 std::unique_ptr<StatementAST> Parser::parseAssignStatement(SourceLoc id_loc, std::string id){
@@ -397,6 +769,32 @@ std::unique_ptr<StatementAST> Parser::parseAssignStatement(SourceLoc id_loc, std
     return std::make_unique<AssignStatementAST>(id_loc, id, std::move(value));
 }
 
+std::unique_ptr<StatementAST> Parser::parseIndexAssignStatement(SourceLoc id_loc, std::string id){
+    // [index][.field] = value;
+    logParseAndToken("indexAssign");
+    auto index = parseIndex();
+    if(!index)
+        return LogErrorS("Error with index of element assignment");
+    std::string field;
+    if(!parseField(field))
+        return LogErrorS("Error with field of element assignment");
+    auto element = std::make_unique<IndexExprAST>(id_loc, id, std::move(index), field);
+
+    if(current_token_ != '=')
+        return LogErrorS("Expected '=' after index in element assignment");
+    getNextToken(); // consume '='
+
+    auto value = parseExpression();
+    if(!value)
+        return LogErrorS("Error with value of element assignment");
+
+    if(current_token_ != ';')
+        return LogErrorS("Expected semicolon to end element assignment");
+    getNextToken(); // consume ';'
+
+    return std::make_unique<IndexAssignStatementAST>(id_loc, std::move(element), std::move(value));
+}
+
 std::unique_ptr<StatementAST> Parser::parseIfStatement(){
     logParseAndToken("If");
     SourceLoc if_loc = Lexer::getLoc();
@@ -435,6 +833,89 @@ std::unique_ptr<StatementAST> Parser::parseIfStatement(){
     return std::make_unique<IfStatementAST>(if_loc, std::move(cond), std::move(then), std::move(elsewise), has_else);
 }
 
+bool Parser::parseMatchBound(int64_t & bound){
+    // an int or long literal, which can be negated
+    bool negative = current_token_ == '-';
+    if(negative)
+        getNextToken(); // consume '-'
+    if(current_token_ == tok_number_int){
+        bound = Lexer::getInt();
+    }
+    else if(current_token_ == tok_number_long){
+        bound = Lexer::getLong();
+    }
+    else{
+        LogErrorS("Expected an int literal bounding an arm of a match");
+        return false;
+    }
+    getNextToken(); // consume the literal
+    if(negative)
+        bound = -bound;
+    return true;
+}
+
+std::unique_ptr<StatementAST> Parser::parseMatchStatement(){
+    // match (expr) { case range, ... block ... else block }, a range is a value,
+    // low to high, to high or low to
+    logParseAndToken("Match");
+    SourceLoc match_loc = Lexer::getLoc();
+    getNextToken(); // consume match
+
+    if(current_token_ != '(')
+        return LogErrorS("Expected '(' and the value matched after match");
+    getNextToken(); // consume '('
+    auto subject = parseExpression();
+    if(!subject)
+        return nullptr;
+    if(current_token_ != ')')
+        return LogErrorS("Expected ')' to end the value matched");
+    getNextToken(); // consume ')'
+
+    if(current_token_ != '{')
+        return LogErrorS("Expected '{' to start the arms of a match");
+    getNextToken(); // consume '{'
+    std::vector<std::vector<MatchRange>> arm_ranges;
+    std::vector<std::unique_ptr<StatementAST>> arms;
+    while(current_token_ == tok_case){
+        getNextToken(); // consume case
+        std::vector<MatchRange> ranges;
+        while(true){
+            MatchRange range;
+            bool open_low = current_token_ == tok_to;
+            if(!open_low && !parseMatchBound(range.low))
+                return nullptr;
+            if(open_low || current_token_ == tok_to){
+                getNextToken(); // consume to
+                if(current_token_ != ',' && current_token_ != '{' && !parseMatchBound(range.high))
+                    return nullptr;
+            }
+            else{
+                range.high = range.low;
+            }
+            ranges.push_back(range);
+            if(current_token_ != ',')
+                break;
+            getNextToken(); // consume ','
+        }
+        auto arm = parseBlockStatement();
+        if(!arm)
+            return LogErrorS("Expected statement block after the values of an arm of a match");
+        arm_ranges.push_back(ranges);
+        arms.push_back(std::move(arm));
+    }
+    std::unique_ptr<StatementAST> elsewise;
+    if(current_token_ == tok_else){
+        getNextToken(); // consume else
+        elsewise = parseBlockStatement();
+        if(!elsewise)
+            return LogErrorS("Expected statement block after else");
+    }
+    if(current_token_ != '}')
+        return LogErrorS("Expected case, else or '}' in a match, with else the last arm");
+    getNextToken(); // consume '}'
+    return std::make_unique<MatchStatementAST>(match_loc, std::move(subject), std::move(arm_ranges), std::move(arms), std::move(elsewise));
+}
+
 std::unique_ptr<StatementAST> Parser::parseForStatement(){
     // for (setup identifier statement; comp exp; step identifier statement) block_statement
     logParseAndToken("for");
@@ -589,10 +1070,9 @@ std::unique_ptr<PrototypeAST> Parser::parsePrototype(){
             return LogErrorP("Expect [of type] after identifier");
         getNextToken(); // consume of
 
-        if(!tokIsType(current_token_))
+        arg_type = parseType();
+        if(arg_type == not_a_type)
             return LogErrorP("Expected type for argument");
-        arg_type = tokToType(current_token_);
-        getNextToken(); // consume type
 
         // Have name and type so add to arg list
         args_and_types.push_back(std::pair<std::string,BType>(arg_name, arg_type));
@@ -610,26 +1090,99 @@ std::unique_ptr<PrototypeAST> Parser::parsePrototype(){
     getNextToken(); // consume ')' (guarunteed by loop breaking)
 
     logParseAndToken("prtoListDone");
+    return_type = type_void;
     if(current_token_ == tok_gives){
         getNextToken(); // consume gives
-        if(!tokIsType(current_token_))
+        return_type = parseType();
+        if(return_type == not_a_type)
             return LogErrorP("Expect return type after gives");
-        return_type = tokToType(current_token_);
-        getNextToken(); // consume return type;
     }
-    else if(current_token_ == tok_as){
-        return_type = type_void;
+
+    // any annotations sit between the prototype and as
+    std::set<FuncAnnotation> annotations;
+    while(tokIsAnnotation(current_token_)){
+        logParseAndToken("protoAnnotation");
+        annotations.insert(tokToAnnotation(current_token_));
+        getNextToken(); // consume annotation
     }
-    else{
-        return LogErrorP("Expected [gives type] or as ... after args list");
+
+    if(current_token_ != tok_as){
+        return LogErrorP("Expected [gives type] [annotations] as ... after args list");
     }
 
     BFType func_type(func_arg_types,return_type);
-    return std::make_unique<PrototypeAST>(proto_loc, function_name, args_and_types, func_type);   
+    return std::make_unique<PrototypeAST>(proto_loc, function_name, args_and_types, func_type, annotations);   
 }
 // std::unique_ptr<PrototypeAST> Parser::parseExtern();
 
 
+bool Parser::parseRecord(){
+    // record Name { field of type; ... }
+    logParseAndToken("record");
+    SourceLoc loc = Lexer::getLoc();
+    std::string record_loc = "{ Line:" + std::to_string(loc.line) + " , Col: " + std::to_string(loc.collumn) + "}";
+    getNextToken(); // consume record
+    if(current_token_ != tok_identifier){
+        LogErrorS("Expected the name of a record after record");
+        return false;
+    }
+    Record record;
+    record.name = Lexer::getIdentifier();
+    if(recordNamed(record.name) != not_a_type){
+        spdlog::error("Record {0} at {1} already declared", record.name, record_loc);
+        return false;
+    }
+    getNextToken(); // consume name
+    if(current_token_ != '{'){
+        LogErrorS("Expected '{' and the fields of a record");
+        return false;
+    }
+    getNextToken(); // consume '{'
+    while(current_token_ != '}'){
+        if(current_token_ != tok_identifier){
+            LogErrorS("Expected fields of a record in form [identifier of type;]");
+            return false;
+        }
+        std::string field = Lexer::getIdentifier();
+        getNextToken(); // consume field name
+        if(current_token_ != tok_of){
+            LogErrorS("Expected [of type] after a field name");
+            return false;
+        }
+        getNextToken(); // consume of
+        BType field_type = parseType();
+        if(typeBytes(field_type) == 0){
+            spdlog::error("Field {0} of record {1} at {2} must be a bool, int, long, float, double or complex",
+                field, record.name, record_loc);
+            return false;
+        }
+        if(record.fieldIndex(field) >= 0){
+            spdlog::error("Field {0} of record {1} at {2} already declared", field, record.name, record_loc);
+            return false;
+        }
+        record.fields.push_back({field, field_type});
+        if(current_token_ != ';'){
+            LogErrorS("Expected ';' after a field");
+            return false;
+        }
+        getNextToken(); // consume ';'
+    }
+    getNextToken(); // consume '}'
+    if(record.fields.empty()){
+        spdlog::error("Record {0} at {1} has no fields", record.name, record_loc);
+        return false;
+    }
+    // largest first, then as declared, which leaves no padding between them
+    for(int i = 0; i < (int) record.fields.size(); ++i){
+        record.storage_order.push_back(i);
+    }
+    std::stable_sort(record.storage_order.begin(), record.storage_order.end(), [&record](int a, int b){
+        return typeBytes(record.fields[a].second) > typeBytes(record.fields[b].second);
+    });
+    recordTypes().push_back(record);
+    return true;
+}
+
 std::unique_ptr<BProgram> Parser::parseLoop(){
     logParseAndTokenCols();
     std::vector<std::unique_ptr<StatementAST>> top_level_statements;
@@ -652,6 +1205,13 @@ std::unique_ptr<BProgram> Parser::parseLoop(){
                 spdlog::info("Parsed Definition Successfully");
                 break;
             };
+            case tok_record: {
+                if(!parseRecord()){
+                    spdlog::error("Error parsing record");
+                    throw BError();
+                }
+                break;
+            };
             case tok_eof: {
                 logParseAndToken("EOF");
                 std::unique_ptr<TopLevels> top_levels = std::make_unique<TopLevels>(std::move(top_level_statements));
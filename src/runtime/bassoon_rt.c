@@ -0,0 +1,256 @@
+// Bassoon runtime library: buffered input and output for the builtins in
+// include/builtins.hxx. Programs call these once per character or number, so
+// each call only touches a buffer and the system call happens once per block.
+// Also the storage and bounds check failures of arrays, called by codegen.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BSN_BUFFER_SIZE (1 << 16)
+
+typedef struct {
+    char data[BSN_BUFFER_SIZE];
+    size_t length;
+} bsn_out_buffer;
+
+typedef struct {
+    char data[BSN_BUFFER_SIZE];
+    size_t position;
+    size_t length;
+} bsn_in_buffer;
+
+// per thread, so writers never contend for a lock
+static _Thread_local bsn_out_buffer out_buffer;
+static _Thread_local bsn_in_buffer in_buffer;
+
+void bsn_flush(void){
+    size_t written = 0;
+    while(written < out_buffer.length){
+        ssize_t result = write(STDOUT_FILENO, out_buffer.data + written, out_buffer.length - written);
+        if(result <= 0){
+            break;
+        }
+        written += (size_t) result;
+    }
+    out_buffer.length = 0;
+}
+
+// output is lost if the program is killed, but not if main returns or exit is called
+__attribute__((destructor)) static void bsn_flush_at_exit(void){
+    bsn_flush();
+}
+
+static inline void bsn_write(const char * data, size_t length){
+    if(out_buffer.length + length > BSN_BUFFER_SIZE){
+        bsn_flush();
+    }
+    memcpy(out_buffer.data + out_buffer.length, data, length);
+    out_buffer.length += length;
+}
+
+int bsn_putchar(int c){
+    if(out_buffer.length == BSN_BUFFER_SIZE){
+        bsn_flush();
+    }
+    out_buffer.data[out_buffer.length++] = (char) c;
+    return c;
+}
+
+// writes the digits of value to the end of buffer, returning where they start
+static char * bsn_format_unsigned(uint64_t value, char * end){
+    do{
+        *--end = (char) ('0' + value % 10);
+        value /= 10;
+    } while(value);
+    return end;
+}
+
+void bsn_print_int(int value){
+    char buffer[16];
+    char * end = buffer + sizeof(buffer);
+    uint64_t magnitude = value < 0 ? -(int64_t) value : value;
+    char * start = bsn_format_unsigned(magnitude, end);
+    if(value < 0){
+        *--start = '-';
+    }
+    bsn_write(start, end - start);
+}
+
+void bsn_print_long(int64_t value){
+    char buffer[24];
+    char * end = buffer + sizeof(buffer);
+    // negated unsigned, so INT64_MIN has a magnitude too
+    uint64_t magnitude = value < 0 ? -(uint64_t) value : (uint64_t) value;
+    char * start = bsn_format_unsigned(magnitude, end);
+    if(value < 0){
+        *--start = '-';
+    }
+    bsn_write(start, end - start);
+}
+
+void bsn_print_uint(uint32_t value){
+    char buffer[16];
+    char * end = buffer + sizeof(buffer);
+    char * start = bsn_format_unsigned(value, end);
+    bsn_write(start, end - start);
+}
+
+void bsn_print_ulong(uint64_t value){
+    char buffer[24];
+    char * end = buffer + sizeof(buffer);
+    char * start = bsn_format_unsigned(value, end);
+    bsn_write(start, end - start);
+}
+
+// Six decimal places as printf's %f, without the locale and format parsing.
+// Magnitudes too large for the integer part to fit 64 bits use exponent form.
+void bsn_print_double(double value){
+    char buffer[32];
+    char * end = buffer + sizeof(buffer);
+    if(isnan(value)){
+        bsn_write("nan", 3);
+        return;
+    }
+    int negative = signbit(value);
+    double magnitude = negative ? -value : value;
+    if(isinf(magnitude)){
+        bsn_write(negative ? "-inf" : "inf", negative ? 4 : 3);
+        return;
+    }
+    if(magnitude >= 1e18){
+        // rare, so libc's formatting is fine
+        int length = snprintf(buffer, sizeof(buffer), "%.17g", value);
+        bsn_write(buffer, (size_t) length);
+        return;
+    }
+    uint64_t whole = (uint64_t) magnitude;
+    uint64_t fraction = (uint64_t) ((magnitude - (double) whole) * 1e6 + 0.5);
+    if(fraction == 1000000){
+        whole += 1;
+        fraction = 0;
+    }
+    char * start = end;
+    for(int i = 0; i < 6; i++){
+        *--start = (char) ('0' + fraction % 10);
+        fraction /= 10;
+    }
+    *--start = '.';
+    start = bsn_format_unsigned(whole, start);
+    if(negative){
+        *--start = '-';
+    }
+    bsn_write(start, end - start);
+}
+
+// returns 0 at the end of input
+static int bsn_refill(void){
+    // prompts written before reading should be seen
+    bsn_flush();
+    ssize_t result = read(STDIN_FILENO, in_buffer.data, BSN_BUFFER_SIZE);
+    in_buffer.position = 0;
+    in_buffer.length = result > 0 ? (size_t) result : 0;
+    return in_buffer.length != 0;
+}
+
+int bsn_getchar(void){
+    if(in_buffer.position == in_buffer.length && !bsn_refill()){
+        return -1;
+    }
+    return (unsigned char) in_buffer.data[in_buffer.position++];
+}
+
+static int bsn_peekchar(void){
+    if(in_buffer.position == in_buffer.length && !bsn_refill()){
+        return -1;
+    }
+    return (unsigned char) in_buffer.data[in_buffer.position];
+}
+
+static void bsn_skip_space(void){
+    int c = bsn_peekchar();
+    while(c == ' ' || c == '\n' || c == '\t' || c == '\r'){
+        in_buffer.position++;
+        c = bsn_peekchar();
+    }
+}
+
+// 0 if there is no number
+int bsn_read_int(void){
+    bsn_skip_space();
+    int negative = 0;
+    int c = bsn_peekchar();
+    if(c == '-' || c == '+'){
+        negative = c == '-';
+        in_buffer.position++;
+        c = bsn_peekchar();
+    }
+    unsigned value = 0;
+    while(c >= '0' && c <= '9'){
+        value = value * 10 + (unsigned) (c - '0');
+        in_buffer.position++;
+        c = bsn_peekchar();
+    }
+    return negative ? (int) -value : (int) value;
+}
+
+// 0.0 if there is no number
+double bsn_read_double(void){
+    char token[64];
+    size_t length = 0;
+    bsn_skip_space();
+    int c = bsn_peekchar();
+    while(c != -1 && c != ' ' && c != '\n' && c != '\t' && c != '\r'){
+        if(length < sizeof(token) - 1){
+            token[length++] = (char) c;
+        }
+        in_buffer.position++;
+        c = bsn_peekchar();
+    }
+    token[length] = '\0';
+    return strtod(token, NULL);
+}
+
+// Arrays too large for the stack, aligned to a cache line so vector loads of
+// them never split one. Their length is padded to a whole number of lines.
+void * bsn_array_alloc(int length, int64_t element_size){
+    if(length < 0){
+        bsn_flush();
+        fprintf(stderr, "array length %d is negative\n", length);
+        exit(1);
+    }
+    size_t size = ((size_t) length * (size_t) element_size + 63) & ~(size_t) 63;
+    void * elements = aligned_alloc(64, size ? size : 64);
+    if(!elements){
+        bsn_flush();
+        fprintf(stderr, "out of memory for an array of %d elements\n", length);
+        exit(1);
+    }
+    memset(elements, 0, size);
+    return elements;
+}
+
+void bsn_array_free(void * elements){
+    free(elements);
+}
+
+void bsn_index_error(int index, int length){
+    bsn_flush();
+    fprintf(stderr, "index %d out of bounds for length %d\n", index, length);
+    exit(1);
+}
+
+void bsn_slice_error(int start, int end, int stride, int length){
+    bsn_flush();
+    fprintf(stderr, "slice [%d:%d:%d] out of bounds for length %d\n", start, end, stride, length);
+    exit(1);
+}
+
+void bsn_bits_error(int length, int other_length){
+    bsn_flush();
+    fprintf(stderr, "bits of length %d combined with bits of length %d\n", length, other_length);
+    exit(1);
+}
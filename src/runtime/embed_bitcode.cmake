@@ -0,0 +1,22 @@
+# Writes OUTPUT, a C++ source defining the bytes of the file BITCODE as
+# bassoon::runtime_bitcode (see include/runtime_bitcode.hxx). With no BITCODE
+# the array is empty.
+set(bytes "0")
+set(size 0)
+if(BITCODE)
+    file(READ ${BITCODE} hex HEX)
+    string(LENGTH "${hex}" hex_length)
+    math(EXPR size "${hex_length} / 2")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${hex}")
+endif()
+file(WRITE ${OUTPUT}
+"#include <cstddef>
+
+namespace bassoon
+{
+
+extern const unsigned char runtime_bitcode[] = {${bytes}};
+extern const std::size_t runtime_bitcode_size = ${size};
+
+} // namespace bassoon
+")
@@ -0,0 +1,364 @@
+#!/usr/bin/env bash
+# Compile time and run time benchmarks for Bassoon programs.
+#
+# Run from the build's bin directory (where Bassoon lives):
+#   ../../src/test/bench/bench.sh <suite> [repeats]
+#
+# Environment:
+#   BASSOON  compiler to benchmark (default ./Bassoon)
+#   CC       linker driver for output.o (default clang)
+#   RUNTIME  runtime library linked into each program (default ../lib/libbassoon_rt.a)
+#   LDLIBS   other libraries programs are linked with (default -lm)
+#   FUNCS    functions generated for the partitions suite (default 10000)
+#
+# Each case prints its compile time, the size of output.o's text and the best
+# run time of [repeats] runs.
+
+set -euo pipefail
+
+BENCH_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BASSOON="${BASSOON:-$(pwd)/Bassoon}"
+CC="${CC:-clang}"
+RUNTIME="${RUNTIME:-$(pwd)/../lib/libbassoon_rt.a}"
+LDLIBS="${LDLIBS:--lm}"
+SUITE="${1:-all}"
+REPEATS="${2:-3}"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+now(){
+    date +%s.%N
+}
+
+elapsed(){
+    awk -v start="$1" -v end="$2" 'BEGIN{printf "%.3f", end - start}'
+}
+
+# bench_case <label> <script> [bassoon flags...]
+bench_case(){
+    local label="$1" script="$2"
+    shift 2
+    local start end compile_time text_size best="" run_time i
+
+    start=$(now)
+    if ! (cd "$WORK_DIR" && "$BASSOON" -log-level=off "$@" < "$script") > /dev/null 2>&1; then
+        printf "%-40s %10s\n" "$label" "compile failed"
+        return
+    fi
+    end=$(now)
+    compile_time=$(elapsed "$start" "$end")
+    text_size=$(size "$WORK_DIR/output.o" | awk 'NR == 2 {print $1}')
+    (cd "$WORK_DIR" && "$CC" output.o "$RUNTIME" $LDLIBS -o bench.out)
+
+    for ((i = 0; i < REPEATS; i++)); do
+        start=$(now)
+        # exit status is whatever the program's main returned
+        "$WORK_DIR/bench.out" > /dev/null || true
+        end=$(now)
+        run_time=$(elapsed "$start" "$end")
+        if [[ -z "$best" ]] || awk -v a="$run_time" -v b="$best" 'BEGIN{exit !(a < b)}'; then
+            best="$run_time"
+        fi
+    done
+    printf "%-40s %10s %10s %10s\n" "$label" "$compile_time" "$text_size" "$best"
+}
+
+header(){
+    printf "\n== %s\n%-40s %10s %10s %10s\n" "$1" "case" "compile s" "text B" "run s"
+}
+
+# brot_large.bs tuned for each cpu selection
+suite_target(){
+    header "target selection (brot_large.bs)"
+    for cpu in generic x86-64 x86-64-v2 x86-64-v3 x86-64-v4 native; do
+        bench_case "-mcpu=$cpu" "$BENCH_DIR/brot_large.bs" -mcpu="$cpu"
+    done
+}
+
+# brot_large.bs with its inner loop multiversioned, against a single generic body
+suite_multiversion(){
+    header "multiversion (brot_large.bs, iter)"
+    sed 's/^define iter(\(.*\)) gives int as/define iter(\1) gives int multiversion as/' \
+        "$BENCH_DIR/brot_large.bs" > "$WORK_DIR/brot_mv.bs"
+    bench_case "single body" "$BENCH_DIR/brot_large.bs"
+    bench_case "mv baseline" "$WORK_DIR/brot_mv.bs" -mv-levels=baseline
+    bench_case "mv baseline,avx2" "$WORK_DIR/brot_mv.bs" -mv-levels=avx2
+    bench_case "mv baseline,avx2,avx512" "$WORK_DIR/brot_mv.bs" -mv-levels=avx2,avx512
+}
+
+# compile time against run time for each optimisation level
+suite_levels(){
+    local script level
+    for script in "$BENCH_DIR"/../test_scripts/*.bs "$BENCH_DIR"/../brot.bs "$BENCH_DIR"/brot_large.bs; do
+        header "optimisation levels ($(basename "$script"))"
+        for level in 0 1 2 3 s z jit; do
+            bench_case "-O$level" "$script" -O"$level"
+        done
+    done
+}
+
+# scaling of -partitions on a generated program with many functions
+suite_partitions(){
+    local count="${FUNCS:-10000}" jobs
+    "$BENCH_DIR/gen_many_funcs.sh" "$count" > "$WORK_DIR/many_funcs.bs"
+    header "partitions ($count generated functions)"
+    for jobs in 1 2 4 8 16; do
+        bench_case "-partitions=$jobs" "$WORK_DIR/many_funcs.bs" -partitions="$jobs"
+    done
+    # ifuncs can't be split, so a multiversion program is compiled as one partition
+    header "partitions (brot_large.bs, iter multiversion)"
+    sed 's/^define iter(\(.*\)) gives int as/define iter(\1) gives int multiversion as/' \
+        "$BENCH_DIR/brot_large.bs" > "$WORK_DIR/brot_mv.bs"
+    for jobs in 1 4; do
+        bench_case "-partitions=$jobs" "$WORK_DIR/brot_mv.bs" -partitions="$jobs"
+    done
+}
+
+# direct SSA construction against allocas + mem2reg
+suite_ssa(){
+    local script level
+    for script in "$BENCH_DIR"/../brot.bs "$BENCH_DIR"/brot_large.bs; do
+        header "direct ssa ($(basename "$script"))"
+        for level in 0 jit 2; do
+            bench_case "-O$level" "$script" -O"$level"
+            bench_case "-O$level -ssa" "$script" -O"$level" -ssa
+        done
+    done
+}
+
+# module-internal fastcc functions against every function exported
+suite_linkage(){
+    local script level
+    for script in "$BENCH_DIR"/../brot.bs "$BENCH_DIR"/brot_large.bs; do
+        sed 's/^\(define .*\) as *{/\1 export as{/' "$script" > "$WORK_DIR/exported.bs"
+        header "linkage ($(basename "$script"))"
+        for level in 0 2 s; do
+            bench_case "-O$level internal" "$script" -O"$level"
+            bench_case "-O$level export" "$WORK_DIR/exported.bs" -O"$level"
+        done
+    done
+}
+
+# recursion depth (tail calls as loops and musttail) and call overhead
+suite_calls(){
+    local level
+    sed 's/^\(define .*\) as *{/\1 export as{/' "$BENCH_DIR/calls.bs" > "$WORK_DIR/calls_exported.bs"
+    header "tail calls (recursion.bs, 100M deep)"
+    for level in 0 jit 2; do
+        bench_case "-O$level" "$BENCH_DIR/recursion.bs" -O"$level"
+        bench_case "-O$level -ssa" "$BENCH_DIR/recursion.bs" -O"$level" -ssa
+    done
+    header "call overhead (calls.bs, 100M calls)"
+    for level in 0 jit 2; do
+        bench_case "-O$level internal" "$BENCH_DIR/calls.bs" -O"$level"
+        bench_case "-O$level export" "$WORK_DIR/calls_exported.bs" -O"$level"
+    done
+}
+
+# floating point heavy programs under each numeric mode
+suite_numeric(){
+    local script mode
+    for script in "$BENCH_DIR"/../brot.bs "$BENCH_DIR"/brot_large.bs "$BENCH_DIR"/reduce.bs; do
+        header "numeric modes ($(basename "$script"))"
+        for mode in strict contract fast; do
+            bench_case "-numeric-mode=$mode" "$script" -numeric-mode="$mode"
+            bench_case "-numeric-mode=$mode -mcpu=native" "$script" -numeric-mode="$mode" -mcpu=native
+        done
+    done
+}
+
+# buffered runtime output against a libc putchar per character, on canvases
+# that are mostly output (few iterations per point) and mostly compute
+suite_io(){
+    local runtime="$RUNTIME"
+    printf '#include <stdio.h>\nint bsn_putchar(int c){ return putchar(c); }\n' > "$WORK_DIR/libc_putchar.c"
+    "$CC" -O2 -c "$WORK_DIR/libc_putchar.c" -o "$WORK_DIR/libc_putchar.o"
+    sed -e 's/= 1200;/= 4000;/' -e 's/iterations > 100/iterations > 4/' \
+        "$BENCH_DIR/brot_large.bs" > "$WORK_DIR/brot_canvas.bs"
+    for script in "$WORK_DIR/brot_canvas.bs" "$BENCH_DIR/brot_large.bs"; do
+        header "output ($(basename "$script"))"
+        RUNTIME="$runtime"
+        bench_case "runtime bitcode inlined" "$script"
+        bench_case "buffered runtime" "$script" -link-runtime=false
+        RUNTIME="$WORK_DIR/libc_putchar.o"
+        bench_case "libc putchar" "$script" -link-runtime=false
+    done
+    RUNTIME="$runtime"
+}
+
+# maths builtins in loops with and without a vector library to vectorise them with
+suite_maths(){
+    local cpu
+    header "maths builtins (maths.bs, -numeric-mode=fast)"
+    for cpu in generic native; do
+        bench_case "-mcpu=$cpu scalar" "$BENCH_DIR/maths.bs" -numeric-mode=fast -mcpu="$cpu"
+        LDLIBS="-lmvec -lm" bench_case "-mcpu=$cpu -veclib=libmvec" "$BENCH_DIR/maths.bs" \
+            -numeric-mode=fast -mcpu="$cpu" -veclib=libmvec
+    done
+}
+
+# naive recursive fib(40) with and without its results cached
+suite_memo(){
+    local level
+    sed 's/gives int as/gives int memo as/' "$BENCH_DIR/fib.bs" > "$WORK_DIR/fib_memo.bs"
+    header "memo (fib.bs, fib(40) at run time)"
+    for level in 0 2; do
+        bench_case "-O$level" "$BENCH_DIR/fib.bs" -O"$level" -ctfe-steps=0
+        bench_case "-O$level memo" "$WORK_DIR/fib_memo.bs" -O"$level" -ctfe-steps=0
+        bench_case "-O$level memo, 16 entries" "$WORK_DIR/fib_memo.bs" -O"$level" -ctfe-steps=0 -memo-size=16
+    done
+}
+
+# the same vectorised kernel on double and float elements, streaming through memory
+# and within L1, where a vector holds twice as many floats
+suite_precision(){
+    local type cpu
+    for type in double float; do
+        sed "s/double/$type/g" "$BENCH_DIR/affine.bs" > "$WORK_DIR/affine_$type.bs"
+        sed -e "s/= $type\[8000000\]/= $type[4000]/" -e 's/r < 100;/r < 200000;/' \
+            "$WORK_DIR/affine_$type.bs" > "$WORK_DIR/affine_l1_$type.bs"
+    done
+    header "precision (affine.bs, 8M elements)"
+    for cpu in generic native; do
+        for type in double float; do
+            bench_case "$type -mcpu=$cpu" "$WORK_DIR/affine_$type.bs" -mcpu="$cpu"
+        done
+    done
+    header "precision (affine.bs, 4000 elements)"
+    for cpu in generic native; do
+        for type in double float; do
+            bench_case "$type -mcpu=$cpu" "$WORK_DIR/affine_l1_$type.bs" -mcpu="$cpu"
+        done
+    done
+}
+
+# the mandelbrot on pairs of doubles against the complex type, which should compile to the same loop
+suite_complex(){
+    local mode
+    sed 's/= 80;/= 1200;/' "$BENCH_DIR/../brot_complex.bs" > "$WORK_DIR/brot_large_complex.bs"
+    header "complex (brot_large.bs, brot_complex.bs at 1200x1200)"
+    for mode in strict contract; do
+        bench_case "doubles -numeric-mode=$mode" "$BENCH_DIR/brot_large.bs" -numeric-mode="$mode"
+        bench_case "complex -numeric-mode=$mode" "$WORK_DIR/brot_large_complex.bs" -numeric-mode="$mode"
+    done
+}
+
+# the same field sum over an array of records in each layout: strided through whole
+# records (aos), contiguous (soa) and contiguous within blocks (aosoa)
+suite_records(){
+    local layout cpu
+    header "records (records.bs, sum of one field of 1M records)"
+    for layout in aos soa "aosoa(4)" "aosoa(16)"; do
+        sed "s/Body aos/Body $layout/g" "$BENCH_DIR/records.bs" > "$WORK_DIR/records.bs"
+        for cpu in generic native; do
+            bench_case "$layout -mcpu=$cpu" "$WORK_DIR/records.bs" -mcpu="$cpu"
+        done
+    done
+}
+
+# a kernel applied to blocks of arrays through slices, copies of the blocks, or the
+# whole arrays and the block's bounds
+suite_slices(){
+    local step cpu
+    header "slices (slices.bs, axpy over 1024 element blocks of 64K doubles)"
+    for step in Views Copies Bounds; do
+        sed "s/stepViews(ys, xs/step$step(ys, xs/" "$BENCH_DIR/slices.bs" > "$WORK_DIR/slices.bs"
+        for cpu in generic native; do
+            bench_case "$step -mcpu=$cpu" "$WORK_DIR/slices.bs" -mcpu="$cpu"
+        done
+    done
+}
+
+# a sieve of Eratosthenes on bits, 64 flags to a word, or an array of bools
+suite_sieve(){
+    local flags cpu
+    header "sieve (sieve.bs, primes below 50M)"
+    for flags in Bits Bools; do
+        sed "s/count = sieveBits(/count = sieve$flags(/" "$BENCH_DIR/sieve.bs" > "$WORK_DIR/sieve.bs"
+        for cpu in generic native; do
+            bench_case "$flags -mcpu=$cpu" "$WORK_DIR/sieve.bs" -mcpu="$cpu"
+        done
+    done
+}
+
+# hash throughput with rotates, with rotates written as shifts and with long arithmetic
+suite_hash(){
+    local hash cpu
+    header "hash (hash.bs, 1M ulong keys 200 times)"
+    for hash in Rotl Shifts Arith; do
+        sed "s/h ^ hashRotl(keys/h ^ hash$hash(keys/" "$BENCH_DIR/hash.bs" > "$WORK_DIR/hash.bs"
+        for cpu in generic native; do
+            bench_case "$hash -mcpu=$cpu" "$WORK_DIR/hash.bs" -mcpu="$cpu"
+        done
+    done
+}
+
+# brot.bs's character() as a lookup table in read-only data, or its chain of comparisons
+suite_tables(){
+    local character cpu
+    header "tables (glyphs.bs, glyphs of 400x400 escape counts 2000 times)"
+    for character in Table Ifs; do
+        sed "s/characterTable(counts/character$character(counts/" "$BENCH_DIR/glyphs.bs" > "$WORK_DIR/glyphs.bs"
+        for cpu in generic native; do
+            bench_case "$character -mcpu=$cpu" "$WORK_DIR/glyphs.bs" -mcpu="$cpu"
+        done
+    done
+}
+
+suite_match(){
+    local lowering cpu
+    header "match (glyphs.bs, characterMatch under each lowering of its match)"
+    sed "s/characterTable(counts/characterMatch(counts/" "$BENCH_DIR/glyphs.bs" > "$WORK_DIR/glyphs.bs"
+    for lowering in table switch search; do
+        for cpu in generic native; do
+            bench_case "$lowering -mcpu=$cpu" "$WORK_DIR/glyphs.bs" -match-lowering="$lowering" -mcpu="$cpu"
+        done
+    done
+}
+
+case "$SUITE" in
+    target) suite_target ;;
+    multiversion) suite_multiversion ;;
+    levels) suite_levels ;;
+    partitions) suite_partitions ;;
+    ssa) suite_ssa ;;
+    linkage) suite_linkage ;;
+    calls) suite_calls ;;
+    numeric) suite_numeric ;;
+    io) suite_io ;;
+    maths) suite_maths ;;
+    memo) suite_memo ;;
+    precision) suite_precision ;;
+    complex) suite_complex ;;
+    records) suite_records ;;
+    slices) suite_slices ;;
+    sieve) suite_sieve ;;
+    hash) suite_hash ;;
+    tables) suite_tables ;;
+    match) suite_match ;;
+    all)
+        suite_target
+        suite_multiversion
+        suite_levels
+        suite_partitions
+        suite_ssa
+        suite_linkage
+        suite_calls
+        suite_numeric
+        suite_io
+        suite_maths
+        suite_memo
+        suite_precision
+        suite_complex
+        suite_records
+        suite_slices
+        suite_sieve
+        suite_hash
+        suite_tables
+        suite_match
+        ;;
+    *)
+        echo "unknown suite $SUITE" >&2
+        exit 1
+        ;;
+esac
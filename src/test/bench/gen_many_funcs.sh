@@ -0,0 +1,30 @@
+#!/usr/bin/env bash
+# Writes a Bassoon program with [count] small functions to stdout, for
+# benchmarking compile time on large modules:
+#   gen_many_funcs.sh 10000 > many_funcs.bs
+# Each function calls the previous one once, so none are dead.
+
+set -euo pipefail
+
+COUNT="${1:-10000}"
+
+echo "# ${COUNT} generated functions"
+echo
+for ((i = 0; i < COUNT; i++)); do
+    echo "define f${i}(n of int) gives int as{"
+    if ((i == 0)); then
+        echo "    acc of int = n;"
+    else
+        echo "    acc of int = f$((i - 1))(n + ${i});"
+    fi
+    echo "    for(i of int = 0; i < $((i % 7 + 4)); i = i + 1;){"
+    echo "        acc = acc * 3 + i;"
+    echo "        if(acc > 100000){"
+    echo "            acc = acc - 99991;"
+    echo "        }"
+    echo "    }"
+    echo "    return acc;"
+    echo "}"
+    echo
+done
+echo "result of int = f$((COUNT - 1))(1);"
@@ -95,6 +95,32 @@ int test_immediate_int(){
     return countFailedCases(int_examples, expected_tokens);
 }
 
+int test_immediate_suffixed(){
+    fprintf(stderr, "test_immediate_suffixed\n");
+    std::vector<std::string> suffixed_examples = {
+        "3000000000L",
+        "7l",
+        "0.5f",
+        "2F",
+        "1.5L",
+        "10u",
+        "0xffUL",
+        "0x1f"
+    };
+    std::vector<std::vector<int>> expected_tokens_list = {
+        {tok_number_long},
+        {tok_number_long},
+        {tok_number_float},
+        {tok_number_float},
+        // only whole numbers are longs
+        {tok_number_double, tok_identifier},
+        {tok_number_uint},
+        {tok_number_ulong},
+        {tok_number_int}
+    };
+    return countFailedCases(suffixed_examples, expected_tokens_list);
+}
+
 int test_immediate_bool(){
     fprintf(stderr, "test_immediate_bool\n");
     std::vector<std::string> int_examples = {
@@ -110,12 +136,20 @@ int test_typed_variables(){
     std::vector<std::string> typed = {
         "a of int",
         "longerName of double",
-        "AnotherLongName of bool"
+        "AnotherLongName of bool",
+        "count of long",
+        "ratio of float",
+        "lanes of vec8 of int",
+        "z of complex"
     };
     std::vector<std::vector<int>> expected_tokens_list = {
         {tok_identifier, tok_of, tok_int},
         {tok_identifier, tok_of, tok_double},
-        {tok_identifier, tok_of, tok_bool}
+        {tok_identifier, tok_of, tok_bool},
+        {tok_identifier, tok_of, tok_long},
+        {tok_identifier, tok_of, tok_float},
+        {tok_identifier, tok_of, tok_vec8, tok_of, tok_int},
+        {tok_identifier, tok_of, tok_complex}
     };
     return countFailedCases(typed, expected_tokens_list);
 }
@@ -150,15 +184,86 @@ int test_while_loop(){
     return countFailedCases(equivalent_loops, expected_tokens);
 }
     
+int test_records(){
+    fprintf(stderr, "test_records\n");
+    std::vector<std::string> records = {
+        "record Body { x of double; }",
+        "bodies of array of Body aosoa(8)",
+        "bodies[i].x = .5"
+    };
+    std::vector<std::vector<int>> expected_tokens_list = {
+        {tok_record, tok_identifier, '{', tok_identifier, tok_of, tok_double, ';', '}'},
+        {tok_identifier, tok_of, tok_array, tok_of, tok_identifier, tok_aosoa, '(', tok_number_int, ')'},
+        {tok_identifier, '[', tok_identifier, ']', '.', tok_identifier, '=', tok_number_double}
+    };
+    return countFailedCases(records, expected_tokens_list);
+}
+
+int test_slices(){
+    fprintf(stderr, "test_slices\n");
+    std::vector<std::string> slices = {
+        "xs of slice of double strided",
+        "xs[1:n:2]"
+    };
+    std::vector<std::vector<int>> expected_tokens_list = {
+        {tok_identifier, tok_of, tok_slice, tok_of, tok_double, tok_strided},
+        {tok_identifier, '[', tok_number_int, ':', tok_identifier, ':', tok_number_int, ']'}
+    };
+    return countFailedCases(slices, expected_tokens_list);
+}
+
+int test_bits(){
+    fprintf(stderr, "test_bits\n");
+    std::vector<std::string> bits = {
+        "flags of bits = bits[n]",
+        "odd = flags and not even"
+    };
+    std::vector<std::vector<int>> expected_tokens_list = {
+        {tok_identifier, tok_of, tok_bits, '=', tok_bits, '[', tok_identifier, ']'},
+        {tok_identifier, '=', tok_identifier, tok_and, tok_not, tok_identifier}
+    };
+    return countFailedCases(bits, expected_tokens_list);
+}
+    
+int test_bit_operators(){
+    fprintf(stderr, "test_bit_operators\n");
+    std::vector<std::string> equivalent_operators = {
+        "h of ulong = (h << 5) ^ x >> 3 % n",
+        "h of ulong=(h<<5)^x>>3%n"
+    };
+    std::vector<int> expected_tokens = {tok_identifier, tok_of, tok_ulong, '=', '(', tok_identifier, tok_shl, tok_number_int, ')',
+        '^', tok_identifier, tok_shr, tok_number_int, '%', tok_identifier};
+    return countFailedCases(equivalent_operators, expected_tokens);
+}
+    
+int test_match(){
+    fprintf(stderr, "test_match\n");
+    std::vector<std::string> equivalent_matches = {
+        "match ( its ) { case to 1, 5 { } case 2 to 4 { } else { } }",
+        "match(its){case to 1,5{}case 2 to 4{}else{}}"
+    };
+    std::vector<int> expected_tokens = {tok_match, '(', tok_identifier, ')', '{',
+        tok_case, tok_to, tok_number_int, ',', tok_number_int, '{', '}',
+        tok_case, tok_number_int, tok_to, tok_number_int, '{', '}',
+        tok_else, '{', '}', '}'};
+    return countFailedCases(equivalent_matches, expected_tokens);
+}
+    
 int test_lexer(){
     utils::setupLexerSource(); // gives mocking getchar to lexer
     test_immediate_int();
     test_immediate_double();
+    test_immediate_suffixed();
     test_immediate_bool();
     test_typed_variables();
     test_function_def();
     test_for_loop();
     test_while_loop();
+    test_records();
+    test_slices();
+    test_bits();
+    test_bit_operators();
+    test_match();
     return 0;
 }
 
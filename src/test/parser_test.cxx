@@ -70,6 +70,20 @@ int test_double_expr(){
     return countParserExprTestFails(source_tokens);
 }
 
+int test_long_float_expr(){
+    fprintf(stderr,"test_long_float_expr\n");
+    int failures = 0;
+    std::vector<int> source_tokens = {tok_number_long,'*',tok_number_int, tok_eof};
+    failures += countParserExprTestFails(source_tokens);
+
+    source_tokens = {tok_number_float,'+',tok_float,'[',tok_number_int,']', tok_eof};
+    failures += countParserExprTestFails(source_tokens);
+
+    source_tokens = {tok_number_ulong,'*',tok_uint,'[',tok_number_uint,']', tok_eof};
+    failures += countParserExprTestFails(source_tokens);
+    return failures;
+}
+
 int test_binop_expr(){
     fprintf(stderr,"test_binop_expr\n");
     int failures = 0;
@@ -79,6 +93,18 @@ int test_binop_expr(){
 
     source_tokens = {tok_number_int,'+',tok_number_int,'+',tok_number_int, tok_eof};
 
+    failures += countParserExprTestFails(source_tokens);
+
+    source_tokens = {tok_true,tok_and,tok_false,tok_or,tok_true, tok_eof};
+
+    failures += countParserExprTestFails(source_tokens);
+
+    source_tokens = {tok_not,tok_true,tok_xor,tok_false,tok_nor,tok_true, tok_eof};
+
+    failures += countParserExprTestFails(source_tokens);
+
+    source_tokens = {'~',tok_identifier,tok_shl,tok_number_int,'&',tok_identifier,tok_shr,tok_identifier,'%',tok_number_uint,'|',tok_number_int, tok_eof};
+
     failures += countParserExprTestFails(source_tokens);
     return failures;
 }
@@ -167,6 +193,27 @@ int test_init_st(){
     fprintf(stderr,"test_init_st\n");
     std::vector<int> source_tokens = {tok_identifier,tok_of,tok_bool,'=',tok_true,';', tok_eof};
     int failures = countParserStatementTestFails(source_tokens); 
+    source_tokens = {tok_const,tok_identifier,tok_of,tok_int,'=',tok_identifier,'(',tok_number_int,')',';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
+    source_tokens = {tok_identifier,tok_of,tok_array,tok_of,tok_double,'=',tok_double,'[',tok_identifier,']',';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
+    source_tokens = {tok_identifier,tok_of,tok_vec4,tok_of,tok_float,'=',
+        tok_vec4,tok_of,tok_float,'(',tok_number_float,',',tok_identifier,',',tok_number_int,',',tok_number_float,')',';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
+    source_tokens = {tok_identifier,tok_of,tok_array,tok_of,tok_vec2,tok_of,tok_double,'=',tok_vec2,tok_of,tok_double,'[',tok_number_int,']',';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
+    source_tokens = {tok_identifier,tok_of,tok_complex,'=',tok_complex,'(',tok_number_double,',',tok_identifier,')','*',tok_identifier,';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
+    source_tokens = {tok_identifier,tok_of,tok_array,tok_of,tok_complex,'=',tok_complex,'[',tok_number_int,']',';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
+    source_tokens = {tok_identifier,tok_of,tok_slice,tok_of,tok_double,'=',tok_identifier,'[',tok_number_int,':',']',';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
+    source_tokens = {tok_identifier,tok_of,tok_slice,tok_of,tok_int,tok_strided,'=',tok_identifier,'[',':',tok_identifier,':',tok_number_int,']',';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
+    source_tokens = {tok_identifier,tok_of,tok_bits,'=',tok_bits,'[',tok_identifier,'+',tok_number_int,']',';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
+    source_tokens = {tok_const,tok_identifier,tok_of,tok_array,tok_of,tok_int,'=','[',tok_number_int,',',tok_identifier,'(',tok_number_int,')',',','-',tok_number_int,']',';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
     return failures;
 }
 
@@ -174,6 +221,12 @@ int test_assign_st(){
     fprintf(stderr,"test_assign_st\n");
     std::vector<int> source_tokens = {tok_identifier,'=',tok_true,';', tok_eof};
     int failures = countParserStatementTestFails(source_tokens); 
+    source_tokens = {tok_identifier,'[',tok_identifier,']','=',tok_identifier,'[',tok_number_int,']','+',tok_number_int,';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
+    source_tokens = {tok_identifier,'[',tok_identifier,']','.',tok_identifier,'=',tok_identifier,'[',tok_number_int,']','.',tok_identifier,';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
+    source_tokens = {tok_identifier,'=',tok_identifier,tok_and,tok_not,'(',tok_identifier,tok_xor,tok_identifier,')',';', tok_eof};
+    failures += countParserStatementTestFails(source_tokens);
     return failures;
 }
 
@@ -226,6 +279,20 @@ int test_while_st(){
     return failures;
 }
 
+int test_match_st(){
+    fprintf(stderr,"test_match_st\n");
+    std::vector<int> source_tokens = {
+        tok_match,'(',tok_identifier,')','{',
+            tok_case,tok_to,'-',tok_number_int,',',tok_number_int,'{',tok_return,tok_number_int,';','}',
+            tok_case,tok_number_int,tok_to,tok_number_long,'{',tok_identifier,'=',tok_identifier,';','}',
+            tok_case,tok_number_int,tok_to,'{','}',
+            tok_else,'{',tok_return,tok_number_int,';','}',
+        '}',
+        tok_eof};
+    int failures = countParserStatementTestFails(source_tokens);
+    return failures;
+}
+
 int test_return_st(){
     fprintf(stderr,"test_return_st\n");
     std::vector<int> source_tokens = {tok_return, tok_identifier,';', tok_eof};
@@ -262,6 +329,48 @@ int test_definition(){
     tok_eof};
     failures += countParserStatementTestFails(source_tokens); 
 
+    source_tokens = {
+    tok_define, tok_identifier,'(',')',tok_gives,tok_bool,tok_multiversion,tok_as,
+        '{',tok_return, tok_false,';','}',
+    tok_eof};
+    failures += countParserStatementTestFails(source_tokens); 
+
+    source_tokens = {
+    tok_define, tok_identifier,'(',')',tok_multiversion,tok_as,
+        '{',tok_identifier,'=',tok_identifier,';','}',
+    tok_eof};
+    failures += countParserStatementTestFails(source_tokens); 
+
+    source_tokens = {
+    tok_define, tok_identifier,'(',tok_identifier,tok_of,tok_int,')',tok_gives,tok_int,tok_export,tok_multiversion,tok_as,
+        '{',tok_return, tok_identifier,';','}',
+    tok_eof};
+    failures += countParserStatementTestFails(source_tokens); 
+
+    source_tokens = {
+    tok_define, tok_identifier,'(',tok_identifier,tok_of,tok_double,')',tok_gives,tok_double,tok_fastmath,tok_as,
+        '{',tok_return, tok_identifier,'*',tok_identifier,';','}',
+    tok_eof};
+    failures += countParserStatementTestFails(source_tokens); 
+
+    source_tokens = {
+    tok_define, tok_identifier,'(',tok_identifier,tok_of,tok_int,')',tok_gives,tok_int,tok_tailrec,tok_as,
+        '{',tok_return, tok_identifier,'(',tok_identifier,')',';','}',
+    tok_eof};
+    failures += countParserStatementTestFails(source_tokens); 
+
+    source_tokens = {
+    tok_define, tok_identifier,'(',tok_identifier,tok_of,tok_array,tok_of,tok_int,')',tok_gives,tok_int,tok_as,
+        '{',tok_return, tok_identifier,'(',tok_identifier,')','+',tok_identifier,'[',tok_number_int,']',';','}',
+    tok_eof};
+    failures += countParserStatementTestFails(source_tokens); 
+
+    source_tokens = {
+    tok_define, tok_identifier,'(',tok_identifier,tok_of,tok_int,')',tok_gives,tok_int,tok_memo,tok_as,
+        '{',tok_return, tok_identifier,'(',tok_identifier,')',';','}',
+    tok_eof};
+    failures += countParserStatementTestFails(source_tokens); 
+
     return failures;
 }
 
@@ -270,6 +379,7 @@ int test_expressions(){
     test_bool_expr();
     test_int_expr();
     test_double_expr();
+    test_long_float_expr();
     test_binop_expr();
     test_paren_expr();
     test_call_expr();
@@ -284,6 +394,7 @@ int test_statements(){
     test_if_st();
     test_for_st();
     test_while_st();
+    test_match_st();
     test_return_st();
     return 0;
 }
@@ -1,8 +1,11 @@
 #include "type_visitor.hxx"
 #include "types.hxx"
 #include "inbuilt_operators.hxx"
+#include "builtins.hxx"
 #include "exceptions.hxx"
+#include "tokens.hxx"
 
+#include <algorithm>
 #include <set>
 
 namespace bassoon
@@ -44,7 +47,15 @@ TypeVisitor::TypeVisitor(){
     // push an initially empty top level scope
     scope_definitions_stack_.push_back(std::vector<std::string>());
     // push language functions
-    addFuncContext("putchar",BFType({type_int},type_int));
+    for(Builtin builtin : builtin_functions){
+        addFuncContext(builtin.name, builtin.type);
+        if(!builtin.pure){
+            impure_functions_.insert(builtin.name);
+        }
+    }
+    for(Builtin builtin : complex_builtins){
+        addFuncContext(builtin.name, builtin.type);
+    }
 }
 
 //------------------------------
@@ -98,11 +109,317 @@ void TypeVisitor::addVarDefinition(std::string identifier, BType type){
     printVarScopes();
 }
 
+void TypeVisitor::checkVariableType(const std::string & identifier, BType type, const std::string & loc_str){
+    if(isRecordType(type)){
+        spdlog::error("{0} at {1} is a {2}, records can only be the elements of arrays", identifier, loc_str, typeToStr(type));
+        throw BError();
+    }
+    if(recordNamed(identifier) != not_a_type){
+        spdlog::error("{0} at {1} has the name of a record", identifier, loc_str);
+        throw BError();
+    }
+}
+
 bool TypeVisitor::funcIsDefined(std::string func_name){
     BFType func_type = func_types_[func_name];
     return func_type.isValid();
 }
 
+// a global that isn't shadowed by a local
+bool TypeVisitor::isGlobal(std::string identifier){
+    auto stack = identifier_stacks_.find(identifier);
+    return globals_.count(identifier) && stack != identifier_stacks_.end() && stack->second.size() == 1;
+}
+
+//--------------------------
+// Purity
+//--------------------------
+
+void TypeVisitor::markPureFunctions(){
+    // a caller of an impure function is impure, repeat until no more change
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(auto & [caller, callees] : callees_){
+            if(impure_functions_.count(caller)){
+                continue;
+            }
+            for(auto & callee : callees){
+                if(impure_functions_.count(callee)){
+                    impure_functions_.insert(caller);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    for(auto & [func_name, func_node] : functions_){
+        bool pure = !impure_functions_.count(func_name);
+        spdlog::debug("Function {0} is {1}", func_name, pure? "pure" : "impure");
+        if(!pure && func_node->getProto().hasAnnotation(annot_memo)){
+            // a cached result must be the same as calling again
+            spdlog::error("memo function {0} at {1} is not pure: it mustn't do input or output, use non-const globals "
+                "or arrays, or call functions that do", func_name, func_node->getLocStr());
+            throw BError();
+        }
+        func_node->setPure(pure);
+    }
+}
+
+//--------------------------
+// Views
+//--------------------------
+
+std::string TypeVisitor::viewNode(const std::string & identifier){
+    return (isGlobal(identifier)? "" : current_function_) + "/" + identifier;
+}
+
+// the variable an array or slice expression views, "" for a new array
+std::string TypeVisitor::viewNodeOf(const ExprAST & expr){
+    if(auto variable = dynamic_cast<const VariableExprAST *>(&expr)){
+        return viewNode(variable->getName());
+    }
+    if(auto slice = dynamic_cast<const SliceExprAST *>(&expr)){
+        return viewNode(slice->getArrayName());
+    }
+    return "";
+}
+
+void TypeVisitor::addView(const std::string & viewed, const std::string & viewer){
+    viewers_[viewed].insert(viewer);
+    viewed_[viewer].insert(viewed);
+}
+
+void TypeVisitor::checkSliceLifetime(const std::string & slice, const ExprAST & value, const std::string & loc_str){
+    // the array a slice is assigned must outlive it: a global only views globals,
+    // a local only variables of its own scope or an enclosing one
+    std::string viewed;
+    if(auto variable = dynamic_cast<const VariableExprAST *>(&value)){
+        viewed = variable->getName();
+    }
+    else if(auto view = dynamic_cast<const SliceExprAST *>(&value)){
+        viewed = view->getArrayName();
+    }
+    else{
+        return;
+    }
+    bool outlives = isGlobal(slice)? isGlobal(viewed) : scopeDepth(viewed) <= scopeDepth(slice);
+    if(!outlives){
+        spdlog::error("Slice {0} assigned at {1} views {2}, which could be freed before {0} is", slice, loc_str, viewed);
+        throw BError();
+    }
+}
+
+void TypeVisitor::referenceVariable(const std::string & identifier){
+    if(isGlobal(identifier)){
+        referenced_globals_[current_function_].insert(identifier);
+    }
+}
+
+bool TypeVisitor::viewRoots(const std::string & caller, const std::string & node, std::set<std::string> & roots){
+    // the arguments of caller and arrays made by it or the top level whose elements node
+    // can view, false if it can view another function's, through a global
+    std::set<std::string> seen = {node};
+    std::vector<std::string> unvisited = {node};
+    const std::vector<std::string> & caller_args = arg_names_[caller];
+    while(!unvisited.empty()){
+        std::string next = unvisited.back();
+        unvisited.pop_back();
+        bool global = next[0] == '/';
+        if(!global && next.compare(0, caller.size() + 1, caller + "/") != 0){
+            return false;
+        }
+        std::string name = next.substr(next.find('/') + 1);
+        if(!global && std::find(caller_args.begin(), caller_args.end(), name) != caller_args.end()){
+            roots.insert(next);
+            continue;
+        }
+        if(allocated_views_.count(next)){
+            roots.insert(next);
+        }
+        for(auto & viewed : viewed_[next]){
+            if(seen.insert(viewed).second){
+                unvisited.push_back(viewed);
+            }
+        }
+    }
+    return true;
+}
+
+void TypeVisitor::markSliceArguments(){
+    // readonly: nothing viewing the argument is written. nocapture: no global views it.
+    std::map<std::pair<std::string, int>, SliceAccess> access;
+    std::set<std::pair<std::string, int>> unaliased;
+    for(auto & [func_name, arg_names] : arg_names_){
+        for(int i = 0; i < (int) arg_names.size(); ++i){
+            std::string arg = func_name + "/" + arg_names[i];
+            std::set<std::string> seen = {arg};
+            std::vector<std::string> unvisited = {arg};
+            SliceAccess & arg_access = access[{func_name, i}];
+            arg_access.readonly = true;
+            arg_access.nocapture = true;
+            while(!unvisited.empty()){
+                std::string next = unvisited.back();
+                unvisited.pop_back();
+                arg_access.readonly = arg_access.readonly && !written_views_.count(next);
+                arg_access.nocapture = arg_access.nocapture && next[0] != '/';
+                for(auto & viewer : viewers_[next]){
+                    if(seen.insert(viewer).second){
+                        unvisited.push_back(viewer);
+                    }
+                }
+            }
+            if(arg_access.nocapture && functions_.count(func_name) && !functions_[func_name]->getProto().hasAnnotation(annot_export)){
+                unaliased.insert({func_name, i});
+            }
+        }
+    }
+
+    // the arrays made at the top level that each function, or one it calls, uses as globals
+    std::map<std::string, std::set<std::string>> global_roots;
+    for(auto & [func_name, func_node] : functions_){
+        std::set<std::string> reached = {func_name};
+        std::vector<std::string> unvisited = {func_name};
+        bool known = true;
+        while(!unvisited.empty()){
+            std::string next = unvisited.back();
+            unvisited.pop_back();
+            for(auto & global : referenced_globals_[next]){
+                known = known && viewRoots("", "/" + global, global_roots[func_name]);
+            }
+            for(auto & callee : callees_[next]){
+                if(reached.insert(callee).second){
+                    unvisited.push_back(callee);
+                }
+            }
+        }
+        if(!known){
+            for(int i = 0; i < (int) arg_names_[func_name].size(); ++i){
+                unaliased.erase({func_name, i});
+            }
+        }
+    }
+
+    // noalias: at every call the argument views only arrays the callee doesn't use as globals,
+    // arguments of the caller that are noalias themselves or arrays the caller made, and none
+    // another array or slice argument views, unless neither is written. Repeat until no change.
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(auto & call : view_calls_){
+            for(int i = 0; i < (int) call.args.size(); ++i){
+                if(call.args[i].empty() || !unaliased.count({call.callee, i})){
+                    continue;
+                }
+                std::set<std::string> roots;
+                bool noalias = viewRoots(call.caller, call.args[i], roots);
+                for(auto & root : roots){
+                    if(root[0] == '/'){
+                        noalias = noalias && !global_roots[call.callee].count(root);
+                        continue;
+                    }
+                    auto & caller_args = arg_names_[call.caller];
+                    int caller_arg = std::find(caller_args.begin(), caller_args.end(), root.substr(call.caller.size() + 1)) - caller_args.begin();
+                    noalias = noalias && (caller_arg == (int) caller_args.size() || unaliased.count({call.caller, caller_arg}));
+                }
+                for(int j = 0; noalias && j < (int) call.args.size(); ++j){
+                    if(j == i || call.args[j].empty()){
+                        continue;
+                    }
+                    if(access[{call.callee, i}].readonly && access[{call.callee, j}].readonly){
+                        continue;
+                    }
+                    std::set<std::string> other_roots;
+                    noalias = viewRoots(call.caller, call.args[j], other_roots);
+                    for(auto & root : other_roots){
+                        noalias = noalias && !roots.count(root);
+                    }
+                }
+                if(!noalias){
+                    unaliased.erase({call.callee, i});
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for(auto & [func_name, func_node] : functions_){
+        auto & args = func_node->getProto().getArgs();
+        for(int i = 0; i < (int) args.size(); ++i){
+            if(!isSliceType(args[i].second)){
+                continue;
+            }
+            SliceAccess arg_access = access[{func_name, i}];
+            arg_access.noalias = unaliased.count({func_name, i});
+            spdlog::debug("Slice {0} of {1} is{2}{3}{4}", args[i].first, func_name, arg_access.readonly? " readonly" : "",
+                arg_access.nocapture? " nocapture" : "", arg_access.noalias? " noalias" : "");
+            func_node->setSliceAccess(i, arg_access);
+        }
+    }
+}
+
+//--------------------------
+// Bounds checks
+//--------------------------
+
+bool TypeVisitor::isInBoundsLoop(ForStatementAST * for_node, InBoundsLoop & loop){
+    // for (i of int = c; i < len(xs); i = i + 1;) with c >= 0: i is in [0, len(xs)) in the
+    // body, and i + 1 can't overflow. The start defines i, so calls can't assign it.
+    auto start = dynamic_cast<const InitStatementAST *>(&for_node->getStart());
+    if(!start || start->getType() != type_int){
+        return false;
+    }
+    auto start_value = dynamic_cast<const IntExprAST *>(&start->getAssignment().getValue());
+    if(!start_value || start_value->getValue() < 0){
+        return false;
+    }
+    std::string index = start->getIdentifier();
+
+    auto end = dynamic_cast<const BinaryExprAST *>(&for_node->getEnd());
+    if(!end || end->getOpCode() != '<'){
+        return false;
+    }
+    auto end_index = dynamic_cast<const VariableExprAST *>(&end->getLHS());
+    auto length = dynamic_cast<const CallExprAST *>(&end->getRHS());
+    if(!end_index || end_index->getName() != index || !length || length->getName() != array_length_builtin){
+        return false;
+    }
+    auto array = dynamic_cast<const VariableExprAST *>(&length->getArg(0));
+    if(!array){
+        return false;
+    }
+
+    auto step = dynamic_cast<const AssignStatementAST *>(&for_node->getStep());
+    if(!step || step->getIdentifier() != index){
+        return false;
+    }
+    auto increment = dynamic_cast<const BinaryExprAST *>(&step->getValue());
+    if(!increment || increment->getOpCode() != '+'){
+        return false;
+    }
+    auto step_index = dynamic_cast<const VariableExprAST *>(&increment->getLHS());
+    auto step_size = dynamic_cast<const IntExprAST *>(&increment->getRHS());
+    if(!step_index || step_index->getName() != index || !step_size || step_size->getValue() != 1){
+        return false;
+    }
+    loop.index = index;
+    loop.array = array->getName();
+    return true;
+}
+
+void TypeVisitor::invalidateInBounds(std::string identifier){
+    for(InBoundsLoop & loop : in_bounds_loops_){
+        if(loop.valid && (loop.index == identifier || loop.array == identifier)){
+            spdlog::debug("{0} changes in the loop over {1}, keeping its bounds checks", identifier, loop.array);
+            for(IndexExprAST * access : loop.accesses){
+                access->setChecked(true);
+            }
+            loop.accesses.clear();
+            loop.valid = false;
+        }
+    }
+}
+
 //--------------------------
 // Scope helpers
 //--------------------------
@@ -144,6 +461,17 @@ void TypeVisitor::pushToCurrentScope(std::string new_definition){
     scope_definitions_stack_[scope_definitions_stack_.size()-1].push_back(new_definition);
 }
 
+int TypeVisitor::scopeDepth(const std::string & identifier){
+    // the innermost scope defining identifier, counted from the outermost
+    for(int depth = scope_definitions_stack_.size() - 1; depth >= 0; --depth){
+        auto & scope = scope_definitions_stack_[depth];
+        if(std::find(scope.begin(), scope.end(), identifier) != scope.end()){
+            return depth;
+        }
+    }
+    return -1;
+}
+
 bool TypeVisitor::isInCurrentScope(std::string candidate_id){
     auto current_scope = getCurrentScope();
     for(auto id_str : current_scope){
@@ -267,6 +595,22 @@ void TypeVisitor::doubleExprAction(DoubleExprAST * double_node) {
         spdlog::warn("double expression without known type {0}", double_node->getLocStr());
     } 
 }
+void TypeVisitor::longExprAction(LongExprAST * long_node) {
+    if (long_node->getType() == type_unknown){
+        spdlog::warn("long expression without known type {0}", long_node->getLocStr());
+    } 
+}
+void TypeVisitor::floatExprAction(FloatExprAST * float_node) {
+    if (float_node->getType() == type_unknown){
+        spdlog::warn("float expression without known type {0}", float_node->getLocStr());
+    } 
+}
+
+void TypeVisitor::unsignedExprAction(UnsignedExprAST * unsigned_node) {
+    if (unsigned_node->getType() == type_unknown){
+        spdlog::warn("unsigned expression without known type {0}", unsigned_node->getLocStr());
+    } 
+}
 
 void TypeVisitor::variableExprAction(VariableExprAST * variable_node) {
     // Variables should only appear when they are defined
@@ -279,10 +623,40 @@ void TypeVisitor::variableExprAction(VariableExprAST * variable_node) {
         // add src location
         throw InvalidReferenceError(variable_name,loc_str);
     }
+    referenceVariable(variable_name);
+    // a const global's value never changes, any other global's can between calls
+    if(!current_function_.empty() && isGlobal(variable_name) && !globals_[variable_name]->isConst()){
+        impure_functions_.insert(current_function_);
+    }
 }
 
 void TypeVisitor::callExprAction(CallExprAST * call_node) {
     std::string func_name = call_node->getName();
+    if(func_name == array_length_builtin){
+        if(call_node->countArgs() != 1){
+            spdlog::error("{0} at {1} takes one array", func_name, call_node->getLocStr());
+            throw BError();
+        }
+        call_node->argAcceptAt(this, 0);
+        if(!isArrayType(call_node->getArg(0).getType())){
+            spdlog::error("{0} at {1} takes an array, not {2}", func_name, call_node->getLocStr(), typeToStr(call_node->getArg(0).getType()));
+            throw BError();
+        }
+        call_node->setType(type_int);
+        return;
+    }
+    if(isVectorBuiltin(func_name, call_node->countArgs())){
+        typeVectorBuiltin(call_node);
+        return;
+    }
+    if(isBitsBuiltin(func_name)){
+        typeBitsBuiltin(call_node);
+        return;
+    }
+    if(isRotateBuiltin(func_name)){
+        typeRotateBuiltin(call_node);
+        return;
+    }
     if(!funcIsDefined(func_name)){
         std::string loc_str = call_node->getLocStr();
         spdlog::error("Function {0} not defined before use at {1}", func_name, loc_str);
@@ -290,7 +664,34 @@ void TypeVisitor::callExprAction(CallExprAST * call_node) {
     }
     
     BFType func_type = funcContext(func_name);
+    if(call_node->countArgs() != func_type.getArgCount()){
+        spdlog::error("{0} at {1} takes {2:d} arguments, not {3:d}", func_name, call_node->getLocStr(),
+            func_type.getArgCount(), call_node->countArgs());
+        throw BError();
+    }
     call_node->setCalleeType(func_type);
+    if(!current_function_.empty()){
+        callees_[current_function_].insert(func_name);
+    }
+    // the call could assign a global slice a loop runs over, changing its length
+    bool builtin = std::any_of(builtin_functions.begin(), builtin_functions.end(),
+        [&func_name](const Builtin & b){return b.name == func_name;});
+    if(!builtin){
+        std::vector<std::string> global_slices;
+        for(InBoundsLoop & loop : in_bounds_loops_){
+            if(loop.valid && isGlobal(loop.array) && isSliceType(typeContext(loop.array))){
+                global_slices.push_back(loop.array);
+            }
+        }
+        for(auto & global_slice : global_slices){
+            invalidateInBounds(global_slice);
+        }
+    }
+
+    if(current_tailrec_ && func_name == current_function_ && call_node != tail_position_call_){
+        spdlog::error("Recursive call of tailrec function {0} at {1} is not a tail call", func_name, call_node->getLocStr());
+        throw BError();
+    }
 
     // Try to type all the args
     call_node->resetArgIndex();
@@ -331,15 +732,133 @@ void TypeVisitor::callExprAction(CallExprAST * call_node) {
             }
         }
     }
+    // the arrays and slices given to the callee's arguments, which then view them
+    ViewCall view_call{current_function_, func_name, std::vector<std::string>(expected_arg_types.size())};
+    bool views = false;
+    for(int arg_i = 0; arg_i < (int) expected_arg_types.size(); ++arg_i){
+        if(isArrayType(expected_arg_types[arg_i])){
+            view_call.args[arg_i] = viewNodeOf(call_node->getArg(arg_i));
+            addView(view_call.args[arg_i], func_name + "/" + arg_names_[func_name][arg_i]);
+            views = true;
+        }
+    }
+    if(views){
+        view_calls_.push_back(view_call);
+    }
     call_node->setType(func_type.getReturnType());
 }
 
+void TypeVisitor::typeVectorBuiltin(CallExprAST * call_node){
+    std::string func_name = call_node->getName();
+    int arg_count = func_name == select_builtin? 3 : 1;
+    if(call_node->countArgs() != arg_count){
+        spdlog::error("{0} at {1} takes {2:d} arguments", func_name, call_node->getLocStr(), arg_count);
+        throw BError();
+    }
+    std::vector<BType> arg_types;
+    for(int i = 0; i < arg_count; ++i){
+        call_node->argAcceptAt(this, i);
+        if(!hasType(call_node->getArg(i))){
+            spdlog::error("Argument {0:d} of {1} at {2} has unknown type", i, func_name, call_node->getLocStr());
+            throw BError();
+        }
+        arg_types.push_back(call_node->getArg(i).getType());
+    }
+
+    if(func_name == select_builtin){
+        // a mask chooses between vectors with as many lanes, a bool between scalars
+        BType mask = arg_types[0], chosen = arg_types[1];
+        bool lanes_match = isVectorType(mask)
+            ? laneType(mask) == type_bool && isVectorType(chosen) && laneCount(chosen) == laneCount(mask)
+            : mask == type_bool && !isVectorType(chosen) && !isArrayType(chosen);
+        if(!lanes_match || arg_types[2] != chosen){
+            spdlog::error("{0} at {1} takes a mask and two vectors of its lanes, or a bool and two scalars, not {2}, {3}, {4}",
+                func_name, call_node->getLocStr(), typeToStr(mask), typeToStr(chosen), typeToStr(arg_types[2]));
+            throw BError();
+        }
+        call_node->setType(chosen);
+        return;
+    }
+
+    BType vector = arg_types[0];
+    bool of_mask = func_name == vector_any_builtin || func_name == vector_all_builtin;
+    if(!isVectorType(vector) || (laneType(vector) == type_bool) != of_mask){
+        spdlog::error("{0} at {1} takes a vector of {2}, not {3}", func_name, call_node->getLocStr(),
+            of_mask? "bools" : "numbers", typeToStr(vector));
+        throw BError();
+    }
+    call_node->setType(of_mask? type_bool : laneType(vector));
+}
+
+void TypeVisitor::typeBitsBuiltin(CallExprAST * call_node){
+    std::string func_name = call_node->getName();
+    int arg_count = func_name == bits_next_builtin? 2 : 1;
+    if(call_node->countArgs() != arg_count){
+        spdlog::error("{0} at {1} takes {2}", func_name, call_node->getLocStr(), arg_count == 1? "bits" : "bits and an int");
+        throw BError();
+    }
+    for(int i = 0; i < arg_count; ++i){
+        call_node->argAcceptAt(this, i);
+        BType arg_type = call_node->getArg(i).getType();
+        BType expected_type = i == 0? type_bits : type_int;
+        if(arg_type != expected_type){
+            spdlog::error("Argument {0:d} of {1} at {2} is {3}, not {4}", i, func_name, call_node->getLocStr(),
+                typeToStr(arg_type), typeToStr(expected_type));
+            throw BError();
+        }
+    }
+    // the flags can change between calls
+    if(!current_function_.empty()){
+        impure_functions_.insert(current_function_);
+    }
+    call_node->setType(type_int);
+}
+
+void TypeVisitor::typeRotateBuiltin(CallExprAST * call_node){
+    std::string func_name = call_node->getName();
+    if(call_node->countArgs() != 2){
+        spdlog::error("{0} at {1} takes an int and the number of bits to rotate it by", func_name, call_node->getLocStr());
+        throw BError();
+    }
+    for(int i = 0; i < 2; ++i){
+        call_node->argAcceptAt(this, i);
+        BType arg_type = call_node->getArg(i).getType();
+        if(!isIntegerType(arg_type)){
+            spdlog::error("Argument {0:d} of {1} at {2} is {3}, not an int, long, uint or ulong", i, func_name, call_node->getLocStr(),
+                typeToStr(arg_type));
+            throw BError();
+        }
+    }
+    call_node->setType(call_node->getArg(0).getType());
+}
+
+void TypeVisitor::checkBitsOperation(const ExprAST & operation, BType result_type, std::vector<const ExprAST *> operands){
+    bool bits_operand = bits_operands_.erase(&operation);
+    for(const ExprAST * operand : operands){
+        bits_operands_.erase(operand);
+    }
+    if(result_type != type_bits){
+        return;
+    }
+    if(!bits_operand){
+        spdlog::error("Operation on bits at {0} must be the value assigned to a bits variable", operation.getLocStr());
+        throw BError();
+    }
+    // reading every word of the bits it combines
+    if(!current_function_.empty()){
+        impure_functions_.insert(current_function_);
+    }
+}
+
 void TypeVisitor::unaryExprAction(UnaryExprAST * unary_node) {
     // lookup possibilities for the unary opcode
     // ensure that the expression has a type, and that it matches.
     char opcode = unary_node->getOpCode();
     // lookup
 
+    if(bits_operands_.count(unary_node)){
+        bits_operands_.insert(&unary_node->getOperand());
+    }
     unary_node->operandAccept(this);
     auto operand = unary_node->getOperand();
     if(!hasType(operand)){
@@ -359,10 +878,11 @@ void TypeVisitor::unaryExprAction(UnaryExprAST * unary_node) {
         }
     }
 
-    if (result_type == type_unknown){
-        spdlog::error("Unary operator {0} at {1} not defined for operand type {2}",opcode, unary_node->getLocStr(), typeToStr(operand_type));
+    if (result_type == type_unknown || (unary_node->isWordOperator() && isIntegerType(laneType(result_type)))){
+        spdlog::error("Unary operator {0} at {1} not defined for operand type {2}",opcodeToStr(opcode), unary_node->getLocStr(), typeToStr(operand_type));
         throw BError();
     }
+    checkBitsOperation(*unary_node, result_type, {&unary_node->getOperand()});
     unary_node->setType(result_type);
 }
 
@@ -374,6 +894,10 @@ void TypeVisitor::binaryExprAction(BinaryExprAST * binary_node) {
     char opcode = binary_node->getOpCode();
     // lookup
 
+    if(bits_operands_.count(binary_node)){
+        bits_operands_.insert(&binary_node->getLHS());
+        bits_operands_.insert(&binary_node->getRHS());
+    }
     binary_node->lhsAccept(this);
     auto lhs = binary_node->getLHS();
     if(!hasType(lhs)){
@@ -405,12 +929,235 @@ void TypeVisitor::binaryExprAction(BinaryExprAST * binary_node) {
     }
 
     if (result_type == type_unknown){
-        spdlog::error("Binary operator {0} at {1} not defined for operand types {2}, {3}", opcode, binary_node->getLocStr(), typeToStr(lhs_type), typeToStr(rhs_type));
+        spdlog::error("Binary operator {0} at {1} not defined for operand types {2}, {3}", opcodeToStr(opcode), binary_node->getLocStr(), typeToStr(lhs_type), typeToStr(rhs_type));
+        throw BError();
+    }
+    // and, or and xor are logical, the bitwise operators of ints are the symbols
+    if (binary_node->isWordOperator() && isIntegerType(laneType(result_type))){
+        spdlog::error("Logical operator at {0} has operands {1}, {2}: use {3} for the bits of ints", binary_node->getLocStr(),
+            typeToStr(lhs_type), typeToStr(rhs_type), opcodeToStr(opcode));
         throw BError();
     }
+    checkBitsOperation(*binary_node, result_type, {&binary_node->getLHS(), &binary_node->getRHS()});
     binary_node->setType(result_type);
 }
 
+void TypeVisitor::vectorExprAction(VectorExprAST * vector_node) {
+    BType vector_type = vector_node->getVectorType();
+    BType lane_type = laneType(vector_type);
+    int lanes = vector_node->countLanes();
+    // one value is splat across the lanes
+    if(lanes != 1 && lanes != laneCount(vector_type)){
+        spdlog::error("{0} at {1} has {2:d} lanes, not {3:d}", typeToStr(vector_type), vector_node->getLocStr(),
+            laneCount(vector_type), lanes);
+        throw BError();
+    }
+    for(int i = 0; i < lanes; ++i){
+        vector_node->laneAcceptAt(this, i);
+        BType value_type = vector_node->getLane(i).getType();
+        if(value_type != lane_type && !isCastable(value_type, lane_type)){
+            spdlog::error("Lane {0:d} of {1} at {2} is {3}, not {4}", i, typeToStr(vector_type), vector_node->getLocStr(),
+                typeToStr(value_type), typeToStr(lane_type));
+            throw BError();
+        }
+    }
+    vector_node->setType(vector_type);
+}
+
+void TypeVisitor::arrayExprAction(ArrayExprAST * array_node) {
+    if(array_node != initialised_array_){
+        spdlog::error("New array at {0} must be the initialisation of an array variable", array_node->getLocStr());
+        throw BError();
+    }
+    array_node->lengthAccept(this);
+    BType length_type = array_node->getLength().getType();
+    if(length_type != type_int){
+        spdlog::error("Array length at {0} is {1}, not int", array_node->getLocStr(), typeToStr(length_type));
+        throw BError();
+    }
+    BType element_type = array_node->getElementType();
+    if(isRecordType(element_type) && isArrayType(initialised_type_) && elementType(initialised_type_) == element_type){
+        // laid out as the variable's type says
+        array_node->setType(initialised_type_);
+        return;
+    }
+    array_node->setType(arrayOf(element_type));
+}
+
+void TypeVisitor::arrayLiteralExprAction(ArrayLiteralExprAST * literal_node) {
+    if(literal_node != initialised_array_){
+        spdlog::error("Array literal at {0} must be the initialisation of a const array", literal_node->getLocStr());
+        throw BError();
+    }
+    BType table_type = initialised_type_;
+    BType element_type = elementType(table_type);
+    bool scalar = isNumericType(element_type) || element_type == type_bool;
+    if(!isArrayType(table_type) || isSliceType(table_type) || isBitsType(table_type) || !scalar){
+        spdlog::error("Array literal at {0} initialises {1}, not an array of bools or numbers", literal_node->getLocStr(), typeToStr(table_type));
+        throw BError();
+    }
+    for(int i = 0; i < literal_node->countElements(); ++i){
+        literal_node->elementAcceptAt(this, i);
+        BType value_type = literal_node->getElement(i).getType();
+        if(value_type != element_type && !isCastable(value_type, element_type)){
+            spdlog::error("Element {0:d} of array literal at {1} is {2}, not {3}", i, literal_node->getLocStr(),
+                typeToStr(value_type), typeToStr(element_type));
+            throw BError();
+        }
+    }
+    literal_node->setType(table_type);
+}
+
+void TypeVisitor::checkConstTables(){
+    // nothing viewing a const array's elements, in any function it's passed to, writes them
+    for(auto & [name, global] : globals_){
+        if(!global->isConst() || !isArrayType(global->getType())){
+            continue;
+        }
+        std::set<std::string> seen = {"/" + name};
+        std::vector<std::string> unvisited = {"/" + name};
+        while(!unvisited.empty()){
+            std::string next = unvisited.back();
+            unvisited.pop_back();
+            if(written_views_.count(next)){
+                std::string function = next.substr(0, next.find('/'));
+                spdlog::error("Elements of const {0} at {1} are written through {2}{3}", name, global->getLocStr(),
+                    next.substr(next.find('/') + 1), function.empty()? "" : " in " + function);
+                throw BError();
+            }
+            for(auto & viewer : viewers_[next]){
+                if(seen.insert(viewer).second){
+                    unvisited.push_back(viewer);
+                }
+            }
+        }
+    }
+}
+
+void TypeVisitor::indexExprAction(IndexExprAST * index_node) {
+    std::string array_name = index_node->getArrayName();
+    BType array_type;
+    try{
+        array_type = typeContext(array_name);
+    }catch(TypeContextError e){
+        throw InvalidReferenceError(array_name, index_node->getLocStr());
+    }
+    if(!isArrayType(array_type) && !isVectorType(array_type)){
+        spdlog::error("{0} indexed at {1} is {2}, not an array or vector", array_name, index_node->getLocStr(), typeToStr(array_type));
+        throw BError();
+    }
+    referenceVariable(array_name);
+    index_node->indexAccept(this);
+    BType index_type = index_node->getIndex().getType();
+    if(index_type != type_int){
+        spdlog::error("Index of {0} at {1} is {2}, not int", array_name, index_node->getLocStr(), typeToStr(index_type));
+        throw BError();
+    }
+    if(isVectorType(array_type)){
+        if(!index_node->getField().empty()){
+            spdlog::error("{0} indexed at {1} is {2}, which has no fields", array_name, index_node->getLocStr(), typeToStr(array_type));
+            throw BError();
+        }
+        // a lane is part of the vector's value, and a literal one is checked here
+        index_node->setLane();
+        auto lane = dynamic_cast<const IntExprAST *>(&index_node->getIndex());
+        if(lane){
+            if(lane->getValue() < 0 || lane->getValue() >= laneCount(array_type)){
+                spdlog::error("Lane {0:d} of {1} at {2} is outside its {3:d} lanes", lane->getValue(), array_name,
+                    index_node->getLocStr(), laneCount(array_type));
+                throw BError();
+            }
+            index_node->setChecked(false);
+        }
+        if(!current_function_.empty() && isGlobal(array_name) && !globals_[array_name]->isConst()){
+            impure_functions_.insert(current_function_);
+        }
+        index_node->setType(laneType(array_type));
+        return;
+    }
+    // elements can change between calls, but for a const array's
+    if(!current_function_.empty() && !(isGlobal(array_name) && globals_[array_name]->isConst())){
+        impure_functions_.insert(current_function_);
+    }
+
+    auto index_var = dynamic_cast<const VariableExprAST *>(&index_node->getIndex());
+    for(InBoundsLoop & loop : in_bounds_loops_){
+        if(loop.valid && index_var && index_var->getName() == loop.index && array_name == loop.array){
+            index_node->setChecked(false);
+            loop.accesses.push_back(index_node);
+            break;
+        }
+    }
+    // a flag of bits is a bool
+    BType element_type = isBitsType(array_type)? type_bool : elementType(array_type);
+    const std::string & field = index_node->getField();
+    if(isRecordType(element_type) && field.empty()){
+        spdlog::error("{0} indexed at {1} is an array of records, select a field of the element", array_name, index_node->getLocStr());
+        throw BError();
+    }
+    if(!isRecordType(element_type) && !field.empty()){
+        spdlog::error("{0} indexed at {1} is {2}, which has no fields", array_name, index_node->getLocStr(), typeToStr(array_type));
+        throw BError();
+    }
+    if(!field.empty()){
+        const Record & record = recordOf(element_type);
+        int field_index = record.fieldIndex(field);
+        if(field_index < 0){
+            spdlog::error("Record {0} has no field {1}, selected at {2}", record.name, field, index_node->getLocStr());
+            throw BError();
+        }
+        element_type = record.fields[field_index].second;
+    }
+    index_node->setType(element_type);
+}
+
+void TypeVisitor::sliceExprAction(SliceExprAST * slice_node) {
+    std::string array_name = slice_node->getArrayName();
+    BType array_type;
+    try{
+        array_type = typeContext(array_name);
+    }catch(TypeContextError e){
+        throw InvalidReferenceError(array_name, slice_node->getLocStr());
+    }
+    if(!isArrayType(array_type) || isRecordType(elementType(array_type)) || isBitsType(array_type)){
+        spdlog::error("{0} sliced at {1} is {2}, not an array or slice of bools, numbers or vectors", array_name,
+            slice_node->getLocStr(), typeToStr(array_type));
+        throw BError();
+    }
+    referenceVariable(array_name);
+    if(!current_function_.empty() && isGlobal(array_name) && !globals_[array_name]->isConst()){
+        impure_functions_.insert(current_function_);
+    }
+    std::vector<std::pair<const char *, const ExprAST *>> bounds;
+    if(slice_node->hasStart()){
+        slice_node->startAccept(this);
+        bounds.push_back({"start", &slice_node->getStart()});
+    }
+    if(slice_node->hasEnd()){
+        slice_node->endAccept(this);
+        bounds.push_back({"end", &slice_node->getEnd()});
+    }
+    if(slice_node->hasStride()){
+        slice_node->strideAccept(this);
+        bounds.push_back({"stride", &slice_node->getStride()});
+    }
+    for(auto & [bound, bound_expr] : bounds){
+        if(bound_expr->getType() != type_int){
+            spdlog::error("Slice {0} of {1} at {2} is {3}, not int", bound, array_name, slice_node->getLocStr(),
+                typeToStr(bound_expr->getType()));
+            throw BError();
+        }
+    }
+    auto stride = slice_node->hasStride()? dynamic_cast<const IntExprAST *>(&slice_node->getStride()) : nullptr;
+    if(stride && stride->getValue() < 1){
+        spdlog::error("Slice stride of {0} at {1} is {2:d}, not positive", array_name, slice_node->getLocStr(), stride->getValue());
+        throw BError();
+    }
+    // a stride of one views the elements one after another, as an array holds them
+    bool strided = isStridedType(array_type) || (slice_node->hasStride() && !(stride && stride->getValue() == 1));
+    slice_node->setType(sliceOf(elementType(array_type), strided));
+}
+
 // -------------------------
 // Statement typing actions.
 //--------------------------
@@ -470,6 +1217,111 @@ void TypeVisitor::ifStAction(IfStatementAST * if_node){
     throw BError();
 }
 
+void TypeVisitor::matchStAction(MatchStatementAST * match_node){
+    // The subject must be an int or long, and every value of its type must take exactly one arm.
+    // Arms must agree on their return types, as the arms of an if do.
+    int original_ret_size = return_type_stack_.size();
+
+    match_node->subjectAccept(this);
+    auto & subject_node = match_node->getSubject();
+    if(!hasType(subject_node)){
+        spdlog::error("Match subject at {0} failed to type", subject_node.getLocStr());
+        throw BError();
+    }
+    BType subject_type = subject_node.getType();
+    if(subject_type != type_int && subject_type != type_long){
+        spdlog::error("Match at {0} is over {1}, not int or long", match_node->getLocStr(), typeToStr(subject_type));
+        throw BError();
+    }
+    int64_t least = subject_type == type_int? INT32_MIN : INT64_MIN;
+    int64_t greatest = subject_type == type_int? INT32_MAX : INT64_MAX;
+
+    // the ranges of every arm, an open bound running to the end of the subject's type
+    std::vector<std::pair<MatchRange, int>> ranges;
+    for(int i = 0; i < match_node->countArms(); ++i){
+        for(MatchRange range : match_node->getArmRanges(i)){
+            range.low = range.low == INT64_MIN? least : range.low;
+            range.high = range.high == INT64_MAX? greatest : range.high;
+            if(range.low < least || range.high > greatest){
+                spdlog::error("Arm at {0} of match at {1} has a value outside of {2}", match_node->getArm(i).getLocStr(),
+                    match_node->getLocStr(), typeToStr(subject_type));
+                throw BError();
+            }
+            if(range.low > range.high){
+                spdlog::error("Arm at {0} of match at {1} has the empty range {2:d} to {3:d}", match_node->getArm(i).getLocStr(),
+                    match_node->getLocStr(), range.low, range.high);
+                throw BError();
+            }
+            ranges.push_back({range, i});
+        }
+    }
+    std::stable_sort(ranges.begin(), ranges.end(), [](const std::pair<MatchRange, int> & a, const std::pair<MatchRange, int> & b){
+        return a.first.low < b.first.low;
+    });
+
+    // split the subject's type into segments, the gaps between ranges taking the else arm
+    int else_arm = match_node->countArms();
+    std::vector<std::pair<int64_t, int>> segments;
+    auto addSegment = [&segments](int64_t start, int arm){
+        if(segments.empty() || segments.back().second != arm){
+            segments.push_back({start, arm});
+        }
+    };
+    auto fillGap = [&](int64_t start){
+        if(!match_node->hasElse()){
+            spdlog::error("Match at {0} has no arm for {1:d}", match_node->getLocStr(), start);
+            throw BError();
+        }
+        addSegment(start, else_arm);
+    };
+    int64_t next = least; // the least value without an arm yet
+    bool covered = false; // every value up to greatest has an arm
+    int previous_arm = -1;
+    for(auto & [range, arm] : ranges){
+        if(covered || range.low < next){
+            spdlog::error("Arms at {0} and {1} of match at {2} overlap at {3:d}", match_node->getArm(previous_arm).getLocStr(),
+                match_node->getArm(arm).getLocStr(), match_node->getLocStr(), range.low);
+            throw BError();
+        }
+        if(range.low > next){
+            fillGap(next);
+        }
+        addSegment(range.low, arm);
+        covered = range.high == greatest;
+        next = covered? greatest : range.high + 1;
+        previous_arm = arm;
+    }
+    if(!covered){
+        fillGap(next);
+    }
+    bool else_taken = std::any_of(segments.begin(), segments.end(), [else_arm](const std::pair<int64_t, int> & segment){
+        return segment.second == else_arm;
+    });
+    if(match_node->hasElse() && !else_taken){
+        spdlog::warn("Else of match at {0} is never taken", match_node->getLocStr());
+    }
+    match_node->setSegments(segments);
+
+    // the arms, including else, must agree on any type they return
+    BType ret_type = type_void;
+    for(int i = 0; i < match_node->countArms() + match_node->hasElse(); ++i){
+        match_node->armAcceptAt(this, i);
+        BType arm_ret_type = popReturnType();
+        if(arm_ret_type == type_void){
+            continue;
+        }
+        if(ret_type != type_void && ret_type != arm_ret_type){
+            spdlog::error("Arms of match at {0} have different return types, {1}, {2}", match_node->getLocStr(),
+                typeToStr(ret_type), typeToStr(arm_ret_type));
+            throw BError();
+        }
+        ret_type = arm_ret_type;
+    }
+
+    checkRetStackSize(original_ret_size);
+    return_type_stack_.push_back(ret_type);
+}
+
 void TypeVisitor::forStAction(ForStatementAST * for_node){
     int original_ret_size = return_type_stack_.size();
 
@@ -499,7 +1351,17 @@ void TypeVisitor::forStAction(ForStatementAST * for_node){
     popReturnType();
     popReturnType();
 
+    InBoundsLoop loop;
+    bool in_bounds = isInBoundsLoop(for_node, loop);
+    if(in_bounds){
+        in_bounds_loops_.push_back(loop);
+    }
     for_node->bodyAccept(this);
+    if(in_bounds){
+        spdlog::debug("{0:d} bounds checks of {1} removed in the loop at {2}", in_bounds_loops_.back().accesses.size(),
+            loop.array, for_node->getLocStr());
+        in_bounds_loops_.pop_back();
+    }
     checkRetStackSize(original_ret_size+1);
     // Leave the body's return type as the for statement's return type.
 
@@ -528,12 +1390,18 @@ void TypeVisitor::whileStAction(WhileStatementAST * while_node){
 }
 
 void TypeVisitor::returnStAction(ReturnStatementAST * return_node){
+    tail_position_call_ = return_node->getCallExpr();
     return_node->returnExprAccept(this);
+    tail_position_call_ = nullptr;
     auto expr_node = return_node->getReturnExpr();
     if (!hasType(expr_node)){
         spdlog::error("Return expression at {0} failed to type", expr_node.getLocStr());
         throw BError();
     }
+    // A returned call is a tail call if its value needs no cast to be returned
+    if(return_node->getCallExpr() && !current_function_.empty() && expr_node.getType() == current_return_type_){
+        return_node->setTailCall(true);
+    }
     spdlog::debug("Adding return type {0} to stack from return at {1}",typeToStr(expr_node.getType()), return_node->getLocStr());
     return_type_stack_.push_back(expr_node.getType());
 }
@@ -627,6 +1495,35 @@ void TypeVisitor::assignStAction(AssignStatementAST * assign_node){
     }catch(TypeContextError e){
         throw InvalidReferenceError(assigned_var,assign_node->getLocStr());
     }
+    if(!initialising_){
+        if(isArrayType(defined_type) && !isSliceType(defined_type) && !isBitsType(defined_type)){
+            spdlog::error("Array {0} assigned at {1}, only its elements can be", assigned_var, assign_node->getLocStr());
+            throw BError();
+        }
+        invalidateInBounds(assigned_var);
+    }
+    // bits are made by bits[length], and assigning them sets all their flags
+    bool made_bits = initialising_ && dynamic_cast<const ArrayExprAST *>(&assign_node->getValue());
+    if(isBitsType(defined_type) && initialising_ && !made_bits){
+        spdlog::error("bits {0} at {1} must be made with bits[length]", assigned_var, assign_node->getLocStr());
+        throw BError();
+    }
+    if(isBitsType(defined_type) && !made_bits){
+        bits_operands_.insert(&assign_node->getValue());
+    }
+    referenceVariable(assigned_var);
+    // assigning a global (not shadowed by a local) after it's initialised
+    if(!initialising_ && isGlobal(assigned_var)){
+        InitStatementAST * global = globals_[assigned_var];
+        if(global->isConst()){
+            spdlog::error("Assignment to const {0} at {1}", assigned_var, assign_node->getLocStr());
+            throw BError();
+        }
+        global->setReassigned();
+        if(!current_function_.empty()){
+            impure_functions_.insert(current_function_);
+        }
+    }
     
 
     // 2. expr types 
@@ -637,6 +1534,7 @@ void TypeVisitor::assignStAction(AssignStatementAST * assign_node){
         throw BError();
     }
     BType val_expr_type = value_expr.getType();
+    bits_operands_.erase(&assign_node->getValue());
 
     // 3. expr type matches uppermost var definition;
     if (val_expr_type != defined_type){ 
@@ -651,6 +1549,21 @@ void TypeVisitor::assignStAction(AssignStatementAST * assign_node){
             throw BError();
         }
     }
+    if(isBitsType(defined_type) && !made_bits){
+        written_views_.insert(viewNode(assigned_var));
+    }
+    else if(isArrayType(defined_type)){
+        std::string viewed = viewNodeOf(assign_node->getValue());
+        if(viewed.empty()){
+            allocated_views_.insert(viewNode(assigned_var));
+        }
+        else{
+            addView(viewed, viewNode(assigned_var));
+        }
+    }
+    if(isSliceType(defined_type) && !initialising_){
+        checkSliceLifetime(assigned_var, assign_node->getValue(), assign_node->getLocStr());
+    }
     return_type_stack_.push_back(type_void);
 }
 
@@ -658,22 +1571,97 @@ void TypeVisitor::initStAction(InitStatementAST * init_node){
     // a of type = expr;
     // 1. a not in current scope definitions
     std::string init_id_str = init_node->getIdentifier();
-    if (isInCurrentScope(init_id_str)){
-        spdlog::error("Identifier {0} previously defined in this scope", init_node->getIdentifier());
+    BType type = init_node->getType();
+    checkVariableType(init_id_str, type, init_node->getLocStr());
+    if(typecheck_phase_ == tp_user_glob){
+        // only declare the global, its initialisation is checked with the top levels
+        if (globals_.count(init_id_str)){
+            spdlog::error("Global {0} at {1} previously defined", init_id_str, init_node->getLocStr());
+            throw BError();
+        }
+        addVarDefinition(init_id_str, type);
+        globals_[init_id_str] = init_node;
+        init_node->setGlobal();
+        return;
+    }
+    if(init_node->isConst() && !init_node->isGlobal()){
+        spdlog::error("const {0} at {1} is not at the top level", init_id_str, init_node->getLocStr());
         throw BError();
     }
-    BType type = init_node->getType();
-    // Can safely define for this scope, so add
-    addVarDefinition(init_id_str, type);
+    // a const array is a lookup table, its elements given by a literal and never written
+    bool table = dynamic_cast<const ArrayLiteralExprAST *>(&init_node->getAssignment().getValue());
+    if(init_node->isConst() && isArrayType(type) && !table){
+        spdlog::error("const {0} at {1} is an array, which must be initialised with its elements [a, b, ...]", init_id_str, init_node->getLocStr());
+        throw BError();
+    }
+    if(table && !init_node->isConst()){
+        spdlog::error("Array literal at {0} must be the initialisation of a const array", init_node->getLocStr());
+        throw BError();
+    }
+    // globals are already defined
+    if(!init_node->isGlobal()){
+        if (isInCurrentScope(init_id_str)){
+            spdlog::error("Identifier {0} previously defined in this scope", init_node->getIdentifier());
+            throw BError();
+        }
+        // Can safely define for this scope, so add
+        addVarDefinition(init_id_str, type);
+        invalidateInBounds(init_id_str);
+    }
 
     // 2. expr of type type
     //std::shared_ptr<AssignStatementAST> assign_node = init_node->getAssignment();
     // assign node action either types well or throws
+    initialising_ = true;
+    initialised_array_ = &init_node->getAssignment().getValue();
+    initialised_type_ = type;
     init_node->assignmentAccept(this);
+    initialised_array_ = nullptr;
+    initialised_type_ = type_unknown;
+    initialising_ = false;
     popReturnType(); // pop the void from assignment
     return_type_stack_.push_back(type_void); // add a void for the initialisation
 }
 
+void TypeVisitor::indexAssignStAction(IndexAssignStatementAST * index_assign_node){
+    // xs[i] = expr
+    index_assign_node->elementAccept(this);
+    BType element_type = index_assign_node->getElementExpr()->getType();
+    std::string name = index_assign_node->getElementExpr()->getArrayName();
+    if(index_assign_node->getElementExpr()->isLane()){
+        // setting a lane assigns the vector
+        invalidateInBounds(name);
+        if(isGlobal(name)){
+            InitStatementAST * global = globals_[name];
+            if(global->isConst()){
+                spdlog::error("Assignment to a lane of const {0} at {1}", name, index_assign_node->getLocStr());
+                throw BError();
+            }
+            global->setReassigned();
+            if(!current_function_.empty()){
+                impure_functions_.insert(current_function_);
+            }
+        }
+    }
+    else{
+        written_views_.insert(viewNode(name));
+    }
+
+    index_assign_node->valueAccept(this);
+    auto value_expr = index_assign_node->getValue();
+    if(!hasType(value_expr)){
+        spdlog::error("Element assignment value at {0} not well typed", value_expr.getLocStr());
+        throw BError();
+    }
+    BType value_type = value_expr.getType();
+    if(value_type != element_type && !isCastable(value_type, element_type)){
+        spdlog::error("Element type {0} and expression type {1} do not match at {2}", typeToStr(element_type),
+            typeToStr(value_type), index_assign_node->getLocStr());
+        throw BError();
+    }
+    return_type_stack_.push_back(type_void);
+}
+
 void TypeVisitor::prototypeAction(PrototypeAST * proto_node){
     switch(typecheck_phase_){
     case(tp_func_proto):{
@@ -684,7 +1672,50 @@ void TypeVisitor::prototypeAction(PrototypeAST * proto_node){
             spdlog::error("Function {0} at {1} already defined",f_name, proto_node->getLocStr());
             throw BError();
         }
+        int numeric_modes = proto_node->hasAnnotation(annot_fastmath) + proto_node->hasAnnotation(annot_contract)
+            + proto_node->hasAnnotation(annot_strict);
+        if(numeric_modes > 1){
+            spdlog::error("Function {0} at {1} has more than one of fastmath, contract and strict", f_name, proto_node->getLocStr());
+            throw BError();
+        }
+        if(f_name == array_length_builtin || isVectorBuiltin(f_name, 0) || isBitsBuiltin(f_name) || isRotateBuiltin(f_name)){
+            spdlog::error("Function {0} at {1} has the name of the builtin {0}", f_name, proto_node->getLocStr());
+            throw BError();
+        }
         BFType f_type = proto_node->getType();
+        for(auto & [arg_name, arg_type] : proto_node->getArgs()){
+            checkVariableType(arg_name, arg_type, proto_node->getLocStr());
+            arg_names_[f_name].push_back(arg_name);
+        }
+        if(isRecordType(f_type.getReturnType())){
+            spdlog::error("Function {0} at {1} returns a record, records can only be the elements of arrays", f_name, proto_node->getLocStr());
+            throw BError();
+        }
+        if(isSliceType(f_type.getReturnType())){
+            spdlog::error("Function {0} at {1} returns a slice, which could outlive the array it views", f_name, proto_node->getLocStr());
+            throw BError();
+        }
+        if(isArrayType(f_type.getReturnType())){
+            // the array would be freed as the function's scope ends
+            spdlog::error("Function {0} at {1} returns an array, which it should take as an argument instead", f_name, proto_node->getLocStr());
+            throw BError();
+        }
+        if(proto_node->hasAnnotation(annot_memo) && (f_type.getReturnType() == type_void || f_type.getArgCount() == 0)){
+            spdlog::error("memo function {0} at {1} needs arguments and a return value to cache", f_name, proto_node->getLocStr());
+            throw BError();
+        }
+        if(proto_node->hasAnnotation(annot_memo)){
+            // the cache keys and holds scalars
+            std::vector<BType> cached_types = f_type.getArgumentTypes();
+            cached_types.push_back(f_type.getReturnType());
+            for(BType cached_type : cached_types){
+                if(isVectorType(cached_type) || cached_type == type_complex){
+                    spdlog::error("memo function {0} at {1} takes or gives a vector or complex number, it can only cache "
+                        "bools and real numbers", f_name, proto_node->getLocStr());
+                    throw BError();
+                }
+            }
+        }
         addFuncContext(f_name, f_type);
         break;
     }
@@ -714,6 +1745,16 @@ void TypeVisitor::functionAction(FunctionAST * func_node){
         spdlog::debug("Accepting function in func typecheck phase");
         int original_ret_size = return_type_stack_.size();
         BType return_type = func_node->getType().getReturnType();
+        current_function_ = func_node->getProto().getName();
+        functions_[current_function_] = func_node;
+        current_return_type_ = return_type;
+        current_tailrec_ = func_node->getProto().hasAnnotation(annot_tailrec);
+        // the elements of an array argument can change between calls
+        for(auto & [arg_name, arg_type] : func_node->getProto().getArgs()){
+            if(isArrayType(arg_type)){
+                impure_functions_.insert(current_function_);
+            }
+        }
         // Push new scope for argument definitions
         pushNewScope();
 
@@ -723,6 +1764,8 @@ void TypeVisitor::functionAction(FunctionAST * func_node){
         // validate that body is well typed
         func_node->bodyAccept(this);
         popCurrentScope();
+        current_function_ = "";
+        current_tailrec_ = false;
 
         // validate that return type matches prototype
         BType body_return_type = popReturnType();
@@ -744,7 +1787,9 @@ void TypeVisitor::functionAction(FunctionAST * func_node){
 void TypeVisitor::topLevelsAction(TopLevels * top_levels_node){
     switch(typecheck_phase_){
     case tp_user_glob:{
-        spdlog::warn("Add top level globals to context phase, not yet in language");
+        // add the top level initialisations to the global context, so functions can use them
+        spdlog::debug("accepting top level initialisations in globals phase");
+        top_levels_node->globalsAllAccept(this);
         break;
     }
     case tp_top_lvl_check:{
@@ -783,7 +1828,7 @@ void TypeVisitor::programAction(BProgram * program_node){
     // 1  - add language globals/constants to variable context
     // 2  - add language functions to function context
     // 3  - add all the function def prototypes to the function context
-    // 4  - currently no globals, but would need to add them to variable context here
+    // 4  - add the globals (top level initialisations) to the variable context
     // 5 - typecheck all the function definitions
     // 6 - typecheck all the top level statements (even if some functions didn't typecheck)
     
@@ -804,7 +1849,7 @@ void TypeVisitor::programAction(BProgram * program_node){
     spdlog::info("Phase 3 {0}",tPhaseToStr(typecheck_phase_));
     program_node->funcDefsAccept(this);
 
-    // Phase 4 - user globals (currently not in language)
+    // Phase 4 - user globals
     typecheck_phase_ = tp_user_glob;
     spdlog::info("Phase 4 {0}",tPhaseToStr(typecheck_phase_));
     program_node->topLevelsAccept(this);
@@ -814,11 +1859,14 @@ void TypeVisitor::programAction(BProgram * program_node){
     typecheck_phase_ = tp_func_check;
     spdlog::info("Phase 5 {0}",tPhaseToStr(typecheck_phase_));
     program_node->funcDefsAccept(this);
+    markPureFunctions();
 
     // Phase 6 - top level statement typecheck
     typecheck_phase_ = tp_top_lvl_check;
     spdlog::info("Phase 6 {0}",tPhaseToStr(typecheck_phase_));
     program_node->topLevelsAccept(this);
+    checkConstTables();
+    markSliceArguments();
 }
 
 } // namespace typecheck
@@ -1,6 +1,7 @@
 #include "viz_visitor.hxx"
 #include "types.hxx"
 #include "exceptions.hxx"
+#include "tokens.hxx"
 
 namespace bassoon
 {
@@ -11,7 +12,7 @@ VizVisitor::VizVisitor(std::string phase){
     phase_ = phase;
     output_filename_ = "../out/AST_Trees" + phase_ + ".dot";
     output_ = std::ofstream(output_filename_, std::ofstream::out);
-    node_base_names_ = std::set<std::string>({"Init","Bool","Int","Double","intType","boolType","doubleType","Var","Assign","CallSt", "If","For","While","Return","Func","Proto","ProtoArg","ProtoRet","Block","CallExpr", "Binary", "FuncDefs","TopLevels"});
+    node_base_names_ = std::set<std::string>({"Init","Bool","Int","Double","Long","Float","intType","boolType","doubleType","longType","floatType","Var","Assign","CallSt", "If","For","While","Return","Func","Proto","ProtoArg","ProtoRet","Block","CallExpr", "Binary", "FuncDefs","TopLevels","Array","Index","IndexAssign","arrayType","Vector","vectorType"});
 }
 
 VizVisitor::~VizVisitor(){
@@ -173,6 +174,27 @@ void VizVisitor::doubleExprAction(DoubleExprAST * double_node) {
     addNodeLabel(double_name, value_string);
 }
 
+void VizVisitor::longExprAction(LongExprAST * long_node) {
+    std::string long_name = getAndAdvanceName("Long");
+    pushName(long_name);
+    std::string value_string = std::to_string(long_node->getValue());
+    addNodeLabel(long_name, value_string);
+}
+
+void VizVisitor::floatExprAction(FloatExprAST * float_node) {
+    std::string float_name = getAndAdvanceName("Float");
+    pushName(float_name);
+    std::string value_string = std::to_string(float_node->getValue());
+    addNodeLabel(float_name, value_string);
+}
+
+void VizVisitor::unsignedExprAction(UnsignedExprAST * unsigned_node) {
+    std::string unsigned_name = getAndAdvanceName("Unsigned");
+    pushName(unsigned_name);
+    std::string value_string = std::to_string(unsigned_node->getValue()) + "u";
+    addNodeLabel(unsigned_name, value_string);
+}
+
 void VizVisitor::variableExprAction(VariableExprAST * variable_node){
     std::string var_name = getAndAdvanceName("Var");
     pushName(var_name);
@@ -199,7 +221,7 @@ void VizVisitor::callExprAction(CallExprAST * call_node) {
 void VizVisitor::unaryExprAction(UnaryExprAST * unary_node) {
     std::string unary_name = getAndAdvanceName("Unary");
     pushName(unary_name);
-    std::string op_char = std::string(1, unary_node->getOpCode());
+    std::string op_char = opcodeToStr(unary_node->getOpCode());
     addNodeLabel(unary_name, op_char);
 
     unary_node->operandAccept(this);
@@ -211,7 +233,7 @@ void VizVisitor::unaryExprAction(UnaryExprAST * unary_node) {
 void VizVisitor::binaryExprAction(BinaryExprAST * binary_node) {
     std::string binary_name = getAndAdvanceName("Binary");
     pushName(binary_name);
-    std::string op_char = std::string(1, binary_node->getOpCode());
+    std::string op_char = opcodeToStr(binary_node->getOpCode());
     addNodeLabel(binary_name, op_char);
 
     binary_node->lhsAccept(this);
@@ -223,6 +245,70 @@ void VizVisitor::binaryExprAction(BinaryExprAST * binary_node) {
     addNodeChild(binary_name, rhs_name);
 }
 
+void VizVisitor::arrayExprAction(ArrayExprAST * array_node) {
+    std::string array_name = getAndAdvanceName("Array");
+    pushName(array_name);
+    addNodeLabel(array_name, typeToStr(array_node->getElementType())+"[]");
+
+    array_node->lengthAccept(this);
+    std::string length_name = popName();
+    addNodeChild(array_name, length_name);
+}
+
+void VizVisitor::indexExprAction(IndexExprAST * index_node) {
+    std::string index_name = getAndAdvanceName("Index");
+    pushName(index_name);
+    std::string field = index_node->getField().empty()? "" : "." + index_node->getField();
+    addNodeLabel(index_name, index_node->getArrayName()+"[]"+field);
+
+    index_node->indexAccept(this);
+    std::string index_expr_name = popName();
+    addNodeChild(index_name, index_expr_name);
+}
+
+void VizVisitor::sliceExprAction(SliceExprAST * slice_node) {
+    std::string slice_name = getAndAdvanceName("Slice");
+    pushName(slice_name);
+    addNodeLabel(slice_name, slice_node->getArrayName()+"[:]");
+
+    if(slice_node->hasStart()){
+        slice_node->startAccept(this);
+        addNodeChild(slice_name, popName());
+    }
+    if(slice_node->hasEnd()){
+        slice_node->endAccept(this);
+        addNodeChild(slice_name, popName());
+    }
+    if(slice_node->hasStride()){
+        slice_node->strideAccept(this);
+        addNodeChild(slice_name, popName());
+    }
+}
+
+void VizVisitor::vectorExprAction(VectorExprAST * vector_node) {
+    std::string vector_name = getAndAdvanceName("Vector");
+    pushName(vector_name);
+    addNodeLabel(vector_name, typeToStr(vector_node->getVectorType()));
+
+    for(int i = 0; i < vector_node->countLanes(); ++i){
+        vector_node->laneAcceptAt(this, i);
+        std::string lane_name = popName();
+        addNodeChild(vector_name, lane_name);
+    }
+}
+
+void VizVisitor::arrayLiteralExprAction(ArrayLiteralExprAST * literal_node) {
+    std::string literal_name = getAndAdvanceName("ArrayLiteral");
+    pushName(literal_name);
+    addNodeLabel(literal_name, "[...]");
+
+    for(int i = 0; i < literal_node->countElements(); ++i){
+        literal_node->elementAcceptAt(this, i);
+        std::string element_name = popName();
+        addNodeChild(literal_name, element_name);
+    }
+}
+
 // ------------------
 // Statement Actions
 // ------------------
@@ -284,6 +370,23 @@ void VizVisitor::whileStAction(WhileStatementAST * while_node) {
     addNodeChild(while_name, body_name);
 }
 
+void VizVisitor::matchStAction(MatchStatementAST * match_node) {
+    std::string match_name = getAndAdvanceName("Match");
+    pushName(match_name);
+    addNodeLabel(match_name, "match(){case...}");
+
+    match_node->subjectAccept(this);
+    std::string subject_name = popName();
+    addNodeChild(match_name, subject_name);
+
+    int arms = match_node->countArms() + (match_node->hasElse()? 1 : 0);
+    for(int i = 0; i < arms; ++i){
+        match_node->armAcceptAt(this, i);
+        std::string arm_name = popName();
+        addNodeChild(match_name, arm_name);
+    }
+}
+
 void VizVisitor::returnStAction(ReturnStatementAST * return_node) {
     std::string return_name = getAndAdvanceName("Return");
     addNodeLabel(return_name,"return");
@@ -346,7 +449,7 @@ void VizVisitor::initStAction(InitStatementAST * init_node) {
     BType var_type = init_node->getType();
     // typeToStr returns "bool", "int", "double"...
     std::string type_str = typeToStr(var_type);
-    std::string type_node_name = getAndAdvanceName(type_str+"Type");
+    std::string type_node_name = getAndAdvanceName(isArrayType(var_type)? "arrayType" : isVectorType(var_type)? "vectorType" : type_str+"Type");
     addNodeLabel(type_node_name, type_str);
     addNodeChild(init_name, type_node_name);
 
@@ -361,11 +464,28 @@ void VizVisitor::initStAction(InitStatementAST * init_node) {
 // Miscellaneous Actions
 //-----------------
 
+void VizVisitor::indexAssignStAction(IndexAssignStatementAST * index_assign_node) {
+    std::string assign_name = getAndAdvanceName("IndexAssign");
+    pushName(assign_name);
+    addNodeLabel(assign_name, "[]=");
+
+    index_assign_node->elementAccept(this);
+    std::string element_name = popName();
+    addNodeChild(assign_name, element_name);
+
+    index_assign_node->valueAccept(this);
+    std::string val_expr_name = popName();
+    addNodeChild(assign_name, val_expr_name);
+}
+
 void VizVisitor::prototypeAction(PrototypeAST * proto_node) {
     std::string proto_name = getAndAdvanceName("Proto");
     pushName(proto_name);
     std::string func_name = proto_node->getName();
     std::vector<std::pair<std::string, BType>> proto_args = proto_node->getArgs();
+    for(FuncAnnotation annotation : proto_node->getAnnotations()){
+        func_name += " " + annotationToStr(annotation);
+    }
     addNodeLabel(proto_name, func_name);
 
     std::string arg_name, arg_str;